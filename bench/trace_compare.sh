@@ -0,0 +1,77 @@
+#!/bin/sh
+# Compare the routing benchmark of a default build with a build configured
+# with --disable-trace. Both are configured out of tree from the source
+# directory and benchmarked in turns, so that a slow period of the machine
+# does not favour either build.
+#
+# Usage: trace_compare.sh [whiteboardd-bench options]
+#
+#   SRCDIR    source tree (default: the parent of this script's directory)
+#   BUILDDIR  where the two builds go (default: ./trace-compare)
+#   RUNS      benchmark runs per build (default: 3)
+#
+# The benchmark output of each run is kept as BUILDDIR/<build>/bench-<n>.txt,
+# the daemon's log as bench-<n>.log. The default build logs its trace there
+# too, as it would in the field.
+
+test "$SRCDIR" || SRCDIR=`cd \`dirname $0\`/.. && pwd`
+test "$BUILDDIR" || BUILDDIR=`pwd`/trace-compare
+test "$RUNS" || RUNS=3
+
+BUILDS="default notrace"
+
+configure_flags()
+{
+    case $1 in
+	default) echo "--with-benchmark" ;;
+	notrace) echo "--with-benchmark --disable-trace" ;;
+    esac
+}
+
+if test ! -x "$SRCDIR/configure"; then
+    (cd "$SRCDIR" && NOCONFIGURE=1 ./autogen.sh) || exit 1
+fi
+
+for build in $BUILDS; do
+    echo "Building $build in $BUILDDIR/$build"
+    mkdir -p "$BUILDDIR/$build" || exit 1
+    (cd "$BUILDDIR/$build" &&
+	"$SRCDIR/configure" `configure_flags $build` > build.log 2>&1 &&
+	make >> build.log 2>&1) ||
+    {
+	echo "Build $build failed, see $BUILDDIR/$build/build.log"
+	exit 1
+    }
+done
+
+# The daemon also needs a session bus
+if test -z "$DBUS_SESSION_BUS_ADDRESS"; then
+    eval `dbus-launch --sh-syntax` || exit 1
+    trap 'kill $DBUS_SESSION_BUS_PID' 0
+fi
+
+run=1
+while test $run -le $RUNS; do
+    for build in $BUILDS; do
+	"$BUILDDIR/$build/bench/whiteboardd-bench" \
+	    --daemon "$BUILDDIR/$build/src/whiteboardd" "$@" \
+	    > "$BUILDDIR/$build/bench-$run.txt" \
+	    2> "$BUILDDIR/$build/bench-$run.log" ||
+	{
+	    echo "Benchmark of $build failed, see $BUILDDIR/$build/bench-$run.log"
+	    exit 1
+	}
+    done
+    run=`expr $run + 1`
+done
+
+for build in $BUILDS; do
+    echo
+    echo "== $build (`configure_flags $build`)"
+    run=1
+    while test $run -le $RUNS; do
+	echo "-- run $run"
+	cat "$BUILDDIR/$build/bench-$run.txt"
+	run=`expr $run + 1`
+    done
+done
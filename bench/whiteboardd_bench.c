@@ -0,0 +1,868 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard daemon.
+ *
+ * whiteboardd_bench.c
+ *
+ * Routing benchmark. Starts whiteboardd on a private unix socket and
+ * drives it with an in-process stub SIB access and stub node that speak
+ * the daemon protocol (register, join, insert, update, remove, query,
+ * subscribe and subscription indications). Throughput and p50/p99/p999
+ * latencies are printed per operation type.
+ *
+ * With --shm-ring-size the stub SIB access sends its join completions,
+ * results and indications through the shared memory ring the daemon
+ * offers, the way a local SIB access process would.
+ *
+ * The daemon also needs a session bus, run e.g.:
+ *   dbus-launch ./whiteboardd-bench --daemon ../src/whiteboardd -n 20000
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define DBUS_API_SUBJECT_TO_CHANGE
+#include <dbus/dbus.h>
+
+#include <whiteboard_dbus_ifaces.h>
+
+#include "whiteboard_daemon_ifaces.h"
+#include "shm_ring.h"
+
+#define BENCH_SIB_UUID "whiteboardd-bench-sib"
+#define BENCH_NODE_UUID "whiteboardd-bench-node"
+#define BENCH_REQUEST "<triple_list><triple><subject>a</subject>" \
+  "<predicate>b</predicate><object>c</object></triple></triple_list>"
+
+/* Latency samples of one operation type, in microseconds */
+typedef struct _BenchSamples
+{
+  const gchar *name;
+  gint64 *values;
+  guint count;
+  guint size;
+  gint64 first;
+  gint64 last;
+} BenchSamples;
+
+/* Stub SIB access process, runs in its own thread */
+typedef struct _BenchSIB
+{
+  DBusConnection *connection;
+  volatile gint running;
+  volatile gint subscription_id; // access id of the last subscribe, 0 if none
+  ShmRing *ring; // to the daemon, NULL if not offered
+  dbus_uint32_t ring_serial;
+} BenchSIB;
+
+static gchar *bench_daemon = "whiteboardd";
+static gchar *bench_socket = NULL;
+static gint bench_count = 10000;
+static gint bench_joins = 100;
+static gint bench_shm_ring_size = 0;
+
+static GOptionEntry bench_options[] =
+  {
+    { "daemon", 'd', 0, G_OPTION_ARG_FILENAME, &bench_daemon,
+      "whiteboardd executable to start (default whiteboardd)", "PATH" },
+    { "socket", 's', 0, G_OPTION_ARG_FILENAME, &bench_socket,
+      "Unix socket path for the daemon (default /tmp/whiteboardd-bench-PID)",
+      "PATH" },
+    { "count", 'n', 0, G_OPTION_ARG_INT, &bench_count,
+      "Operations per type (default 10000)", "N" },
+    { "joins", 'j', 0, G_OPTION_ARG_INT, &bench_joins,
+      "Join operations (default 100)", "N" },
+    { "shm-ring-size", 'r', 0, G_OPTION_ARG_INT, &bench_shm_ring_size,
+      "Send SIB access results through a shared memory ring of this size "
+      "(default 0, the connection)", "BYTES" },
+    { NULL }
+  };
+
+/*****************************************************************************
+ * Timing and statistics
+ *****************************************************************************/
+
+static gint64 bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (gint64) ts.tv_sec * G_GINT64_CONSTANT(1000000) + ts.tv_nsec / 1000;
+}
+
+static BenchSamples *bench_samples_new(const gchar *name, guint size)
+{
+  BenchSamples *samples = g_new0(BenchSamples, 1);
+
+  samples->name = name;
+  samples->size = size;
+  samples->values = g_new0(gint64, size);
+
+  return samples;
+}
+
+static void bench_samples_free(BenchSamples *samples)
+{
+  g_free(samples->values);
+  g_free(samples);
+}
+
+static void bench_samples_add(BenchSamples *samples, gint64 start, gint64 end)
+{
+  if (samples->count == 0)
+    samples->first = start;
+  samples->last = end;
+
+  if (samples->count < samples->size)
+    samples->values[samples->count++] = end - start;
+}
+
+static int bench_compare_gint64(const void *a, const void *b)
+{
+  gint64 x = *(const gint64 *) a;
+  gint64 y = *(const gint64 *) b;
+
+  return (x > y) - (x < y);
+}
+
+static gint64 bench_percentile(BenchSamples *samples, gdouble p)
+{
+  guint idx;
+
+  if (samples->count == 0)
+    return 0;
+
+  idx = (guint) (p * samples->count);
+  if (idx >= samples->count)
+    idx = samples->count - 1;
+
+  return samples->values[idx];
+}
+
+static void bench_samples_report(BenchSamples *samples)
+{
+  gdouble elapsed;
+
+  qsort(samples->values, samples->count, sizeof(gint64),
+	bench_compare_gint64);
+
+  elapsed = (samples->last - samples->first) / 1000000.0;
+
+  printf("%-14s %8u %12.0f %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT
+	 " %10" G_GINT64_FORMAT "\n",
+	 samples->name, samples->count,
+	 elapsed > 0 ? samples->count / elapsed : 0.0,
+	 bench_percentile(samples, 0.50),
+	 bench_percentile(samples, 0.99),
+	 bench_percentile(samples, 0.999));
+}
+
+/*****************************************************************************
+ * Connection helpers
+ *****************************************************************************/
+
+static DBusConnection *bench_connect(const gchar *address)
+{
+  DBusConnection *conn = NULL;
+  DBusError err;
+  gint i;
+
+  /* Wait for the daemon to start listening */
+  for (i = 0; i < 100 && conn == NULL; i++)
+    {
+      dbus_error_init(&err);
+      conn = dbus_connection_open_private(address, &err);
+      if (conn == NULL)
+	{
+	  dbus_error_free(&err);
+	  g_usleep(50000);
+	}
+    }
+
+  if (conn != NULL)
+    dbus_connection_set_exit_on_disconnect(conn, FALSE);
+
+  return conn;
+}
+
+static DBusMessage *bench_call(DBusConnection *conn, const gchar *interface,
+			       const gchar *member, int first_arg_type, ...)
+{
+  DBusMessage *msg = NULL;
+  DBusMessage *reply = NULL;
+  DBusError err;
+  va_list args;
+
+  msg = dbus_message_new_method_call(WHITEBOARD_DBUS_SERVICE,
+				     WHITEBOARD_DBUS_OBJECT,
+				     interface, member);
+  va_start(args, first_arg_type);
+  dbus_message_append_args_valist(msg, first_arg_type, args);
+  va_end(args);
+
+  dbus_error_init(&err);
+  reply = dbus_connection_send_with_reply_and_block(conn, msg, -1, &err);
+  if (reply == NULL)
+    {
+      fprintf(stderr, "%s failed: %s\n", member, err.message);
+      dbus_error_free(&err);
+    }
+  dbus_message_unref(msg);
+
+  return reply;
+}
+
+static dbus_int32_t bench_reply_int(DBusMessage *reply)
+{
+  DBusMessageIter iter;
+  dbus_int32_t value = -1;
+
+  if (reply != NULL &&
+      dbus_message_iter_init(reply, &iter) &&
+      dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_INT32)
+    dbus_message_iter_get_basic(&iter, &value);
+
+  return value;
+}
+
+/**
+ * Block until a signal with the given member and leading access id
+ * arrives on the node interface. Other messages are dropped.
+ *
+ * @return the signal, to be unreffed by the caller, or NULL on disconnect
+ */
+static DBusMessage *bench_wait_signal(DBusConnection *conn,
+				      const gchar *member,
+				      dbus_int32_t access_id)
+{
+  DBusMessage *msg = NULL;
+
+  while (dbus_connection_read_write(conn, -1))
+    {
+      while ((msg = dbus_connection_pop_message(conn)) != NULL)
+	{
+	  if (dbus_message_is_signal(msg, WHITEBOARD_DBUS_NODE_INTERFACE,
+				     member) &&
+	      (access_id < 0 || bench_reply_int(msg) == access_id))
+	    return msg;
+
+	  dbus_message_unref(msg);
+	}
+    }
+
+  return NULL;
+}
+
+/*****************************************************************************
+ * Stub SIB access
+ *****************************************************************************/
+
+/* Messages that expect no reply go through the ring if there is one */
+static void bench_sib_send(BenchSIB *sib, DBusMessage *msg)
+{
+#ifdef SHM_RING_SUPPORTED
+  char *buf = NULL;
+  int len = 0;
+
+  if (sib->ring != NULL)
+    {
+      /* The daemon refuses messages without a serial */
+      dbus_message_set_serial(msg, ++sib->ring_serial);
+      if (!dbus_message_marshal(msg, &buf, &len))
+	return;
+
+      /* Full, wait for the daemon to catch up */
+      while (!shm_ring_write(sib->ring, buf, len))
+	g_thread_yield();
+      dbus_free(buf);
+      return;
+    }
+#endif
+
+  dbus_connection_send(sib->connection, msg, NULL);
+}
+
+static void bench_sib_reply(BenchSIB *sib, DBusMessage *call,
+			    int first_arg_type, ...)
+{
+  DBusMessage *reply = NULL;
+  va_list args;
+
+  reply = dbus_message_new_method_return(call);
+  va_start(args, first_arg_type);
+  dbus_message_append_args_valist(reply, first_arg_type, args);
+  va_end(args);
+  dbus_connection_send(sib->connection, reply, NULL);
+  dbus_message_unref(reply);
+}
+
+/* Query and subscribe results go back as method returns that carry the
+ * request member, the way the SIB access processes send them. */
+static void bench_sib_result(BenchSIB *sib, DBusMessage *call,
+			     int first_arg_type, ...)
+{
+  DBusMessage *result = NULL;
+  va_list args;
+
+  result = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+  dbus_message_set_no_reply(result, TRUE);
+  dbus_message_set_reply_serial(result, dbus_message_get_serial(call));
+  dbus_message_set_interface(result, WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE);
+  dbus_message_set_member(result, dbus_message_get_member(call));
+  va_start(args, first_arg_type);
+  dbus_message_append_args_valist(result, first_arg_type, args);
+  va_end(args);
+  bench_sib_send(sib, result);
+  dbus_message_unref(result);
+}
+
+static DBusHandlerResult bench_sib_filter(DBusConnection *conn,
+					  DBusMessage *msg,
+					  void *user_data)
+{
+  BenchSIB *sib = (BenchSIB *) user_data;
+  const gchar *subscription = "bench-subscription";
+  const gchar *results = "<results/>";
+  const gchar *ok = "Success";
+  dbus_int32_t access_id = -1;
+  dbus_int32_t status = 0;
+  DBusMessage *signal = NULL;
+
+  if (dbus_message_is_signal(msg, WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+			     WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_JOIN))
+    {
+      access_id = bench_reply_int(msg);
+      signal = dbus_message_new_signal(WHITEBOARD_DBUS_OBJECT,
+				       WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+				       WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_JOIN_COMPLETE);
+      dbus_message_append_args(signal,
+			       DBUS_TYPE_INT32, &access_id,
+			       DBUS_TYPE_INT32, &status,
+			       DBUS_TYPE_INVALID);
+      bench_sib_send(sib, signal);
+      dbus_message_unref(signal);
+    }
+  else if (dbus_message_is_method_call(msg, WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+				       WHITEBOARD_DBUS_SIB_ACCESS_METHOD_INSERT) ||
+	   dbus_message_is_method_call(msg, WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+				       WHITEBOARD_DBUS_SIB_ACCESS_METHOD_UPDATE) ||
+	   dbus_message_is_method_call(msg, WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+				       WHITEBOARD_DBUS_SIB_ACCESS_METHOD_REMOVE))
+    {
+      bench_sib_reply(sib, msg,
+		      DBUS_TYPE_INT32, &status,
+		      DBUS_TYPE_STRING, &ok,
+		      DBUS_TYPE_INVALID);
+    }
+  else if (dbus_message_is_method_call(msg, WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+				       WHITEBOARD_DBUS_SIB_ACCESS_METHOD_QUERY))
+    {
+      access_id = bench_reply_int(msg);
+      bench_sib_result(sib, msg,
+		       DBUS_TYPE_INT32, &access_id,
+		       DBUS_TYPE_INT32, &status,
+		       DBUS_TYPE_STRING, &results,
+		       DBUS_TYPE_INVALID);
+    }
+  else if (dbus_message_is_method_call(msg, WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+				       WHITEBOARD_DBUS_SIB_ACCESS_METHOD_SUBSCRIBE))
+    {
+      access_id = bench_reply_int(msg);
+      bench_sib_result(sib, msg,
+		       DBUS_TYPE_INT32, &access_id,
+		       DBUS_TYPE_INT32, &status,
+		       DBUS_TYPE_STRING, &subscription,
+		       DBUS_TYPE_STRING, &results,
+		       DBUS_TYPE_INVALID);
+      g_atomic_int_set(&sib->subscription_id, access_id);
+    }
+  else
+    {
+      return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static void bench_sib_send_indications(BenchSIB *sib, dbus_int32_t access_id,
+				       gint count)
+{
+  const gchar *subscription = "bench-subscription";
+  const gchar *added = BENCH_REQUEST;
+  const gchar *removed = "";
+  DBusMessage *signal = NULL;
+  dbus_int64_t timestamp;
+  gint i;
+
+  for (i = 0; i < count; i++)
+    {
+      /* The send time travels as the last argument, the daemon only
+       * looks at the leading access id */
+      timestamp = bench_now();
+      signal = dbus_message_new_signal(WHITEBOARD_DBUS_OBJECT,
+				       WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+				       WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_SUBSCRIPTION_IND);
+      dbus_message_append_args(signal,
+			       DBUS_TYPE_INT32, &access_id,
+			       DBUS_TYPE_STRING, &subscription,
+			       DBUS_TYPE_STRING, &added,
+			       DBUS_TYPE_STRING, &removed,
+			       DBUS_TYPE_INT64, &timestamp,
+			       DBUS_TYPE_INVALID);
+      bench_sib_send(sib, signal);
+      dbus_message_unref(signal);
+
+      /* Keep the outgoing queue bounded */
+      if ((i & 63) == 63)
+	dbus_connection_flush(sib->connection);
+    }
+  dbus_connection_flush(sib->connection);
+}
+
+static gpointer bench_sib_thread(gpointer data)
+{
+  BenchSIB *sib = (BenchSIB *) data;
+  dbus_int32_t access_id;
+
+  while (g_atomic_int_get(&sib->running) &&
+	 dbus_connection_read_write_dispatch(sib->connection, 100))
+    {
+      access_id = g_atomic_int_get(&sib->subscription_id);
+      if (access_id > 0)
+	{
+	  g_atomic_int_set(&sib->subscription_id, 0);
+	  bench_sib_send_indications(sib, access_id, bench_count);
+	}
+    }
+
+  return NULL;
+}
+
+static gboolean bench_sib_register(BenchSIB *sib)
+{
+  const gchar *uuid = BENCH_SIB_UUID;
+  const gchar *name = "Benchmark SIB";
+  const gchar *mimetypes = "";
+  dbus_bool_t local = TRUE;
+  dbus_uint32_t capabilities = WHITEBOARD_SIB_CAPABILITY_NONE;
+  DBusMessage *reply = NULL;
+  gboolean retval;
+#ifdef SHM_RING_SUPPORTED
+  dbus_int32_t status = -1;
+  int fd = -1;
+  int event_fd = -1;
+
+  if (bench_shm_ring_size > 0)
+    capabilities |= WHITEBOARD_SIB_CAPABILITY_SHM_RING;
+#endif
+
+  reply = bench_call(sib->connection, WHITEBOARD_DBUS_REGISTER_INTERFACE,
+		     WHITEBOARD_DBUS_REGISTER_METHOD_SIB,
+		     DBUS_TYPE_STRING, &uuid,
+		     DBUS_TYPE_STRING, &name,
+		     DBUS_TYPE_STRING, &mimetypes,
+		     DBUS_TYPE_BOOLEAN, &local,
+		     DBUS_TYPE_UINT32, &capabilities,
+		     DBUS_TYPE_INVALID);
+  retval = (bench_reply_int(reply) == 0);
+
+#ifdef SHM_RING_SUPPORTED
+  /* The ring offered in the reply, see WHITEBOARD_SIB_CAPABILITY_SHM_RING */
+  if (retval && bench_shm_ring_size > 0 &&
+      dbus_message_get_args(reply, NULL,
+			    DBUS_TYPE_INT32, &status,
+			    DBUS_TYPE_UNIX_FD, &fd,
+			    DBUS_TYPE_UNIX_FD, &event_fd,
+			    DBUS_TYPE_INVALID))
+    sib->ring = shm_ring_open(fd, event_fd);
+
+  if (bench_shm_ring_size > 0 && sib->ring == NULL)
+    {
+      fprintf(stderr, "The daemon offered no shared memory ring\n");
+      retval = FALSE;
+    }
+#endif
+
+  if (reply != NULL)
+    dbus_message_unref(reply);
+
+  return retval;
+}
+
+/*****************************************************************************
+ * Stub node
+ *****************************************************************************/
+
+static void bench_node_join(DBusConnection *conn, BenchSamples *samples,
+			    gint count)
+{
+  const gchar *sib = BENCH_SIB_UUID;
+  DBusMessage *reply = NULL;
+  DBusMessage *signal = NULL;
+  dbus_int32_t msgnum = 0;
+  dbus_int32_t join_id;
+  gchar *nodeid = NULL;
+  gint64 start;
+  gint i;
+
+  for (i = 0; i < count; i++)
+    {
+      /* Node 0 stays joined for the later phases */
+      nodeid = g_strdup_printf(BENCH_NODE_UUID "-%d", i);
+      start = bench_now();
+      reply = bench_call(conn, WHITEBOARD_DBUS_NODE_INTERFACE,
+			 WHITEBOARD_DBUS_NODE_METHOD_JOIN,
+			 DBUS_TYPE_STRING, &nodeid,
+			 DBUS_TYPE_STRING, &sib,
+			 DBUS_TYPE_INT32, &msgnum,
+			 DBUS_TYPE_INVALID);
+      join_id = bench_reply_int(reply);
+      if (reply != NULL)
+	dbus_message_unref(reply);
+      g_free(nodeid);
+
+      if (join_id < 0)
+	continue;
+
+      signal = bench_wait_signal(conn,
+				 WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_JOIN_COMPLETE,
+				 join_id);
+      if (signal == NULL)
+	return;
+      bench_samples_add(samples, start, bench_now());
+      dbus_message_unref(signal);
+    }
+}
+
+static void bench_node_write(DBusConnection *conn, const gchar *member,
+			     BenchSamples *samples, gint count)
+{
+  const gchar *nodeid = BENCH_NODE_UUID "-0";
+  const gchar *sib = BENCH_SIB_UUID;
+  const gchar *request = BENCH_REQUEST;
+  DBusMessage *reply = NULL;
+  dbus_int32_t msgnum = 0;
+  dbus_int32_t encoding = 0;
+  gint64 start;
+  gint i;
+
+  for (i = 0; i < count; i++)
+    {
+      msgnum = i;
+      start = bench_now();
+      reply = bench_call(conn, WHITEBOARD_DBUS_NODE_INTERFACE, member,
+			 DBUS_TYPE_STRING, &nodeid,
+			 DBUS_TYPE_STRING, &sib,
+			 DBUS_TYPE_INT32, &msgnum,
+			 DBUS_TYPE_INT32, &encoding,
+			 DBUS_TYPE_STRING, &request,
+			 DBUS_TYPE_INVALID);
+      if (reply == NULL)
+	return;
+      bench_samples_add(samples, start, bench_now());
+      dbus_message_unref(reply);
+    }
+}
+
+static dbus_int32_t bench_node_request(DBusConnection *conn,
+				       const gchar *member,
+				       dbus_int32_t msgnum)
+{
+  const gchar *nodeid = BENCH_NODE_UUID "-0";
+  const gchar *sib = BENCH_SIB_UUID;
+  const gchar *request = BENCH_REQUEST;
+  DBusMessage *reply = NULL;
+  dbus_int32_t type = 1;
+  dbus_int32_t access_id;
+
+  reply = bench_call(conn, WHITEBOARD_DBUS_NODE_INTERFACE, member,
+		     DBUS_TYPE_STRING, &nodeid,
+		     DBUS_TYPE_STRING, &sib,
+		     DBUS_TYPE_INT32, &msgnum,
+		     DBUS_TYPE_INT32, &type,
+		     DBUS_TYPE_STRING, &request,
+		     DBUS_TYPE_INVALID);
+  access_id = bench_reply_int(reply);
+  if (reply != NULL)
+    dbus_message_unref(reply);
+
+  return access_id;
+}
+
+static void bench_node_query(DBusConnection *conn, BenchSamples *samples,
+			     gint count)
+{
+  DBusMessage *signal = NULL;
+  dbus_int32_t access_id;
+  gint64 start;
+  gint i;
+
+  for (i = 0; i < count; i++)
+    {
+      start = bench_now();
+      access_id = bench_node_request(conn, WHITEBOARD_DBUS_NODE_METHOD_QUERY, i);
+      if (access_id < 0)
+	continue;
+
+      signal = bench_wait_signal(conn, WHITEBOARD_DBUS_NODE_METHOD_QUERY,
+				 access_id);
+      if (signal == NULL)
+	return;
+      bench_samples_add(samples, start, bench_now());
+      dbus_message_unref(signal);
+    }
+}
+
+static void bench_node_subscribe(DBusConnection *conn,
+				 BenchSamples *subscribe,
+				 BenchSamples *indications,
+				 gint count)
+{
+  DBusMessage *signal = NULL;
+  DBusMessageIter iter;
+  dbus_int32_t access_id;
+  dbus_int64_t timestamp;
+  gint64 start;
+  gint i;
+
+  start = bench_now();
+  access_id = bench_node_request(conn, WHITEBOARD_DBUS_NODE_METHOD_SUBSCRIBE, 0);
+  if (access_id < 0)
+    return;
+
+  signal = bench_wait_signal(conn, WHITEBOARD_DBUS_NODE_METHOD_SUBSCRIBE,
+			     access_id);
+  if (signal == NULL)
+    return;
+  bench_samples_add(subscribe, start, bench_now());
+  dbus_message_unref(signal);
+
+  for (i = 0; i < count; i++)
+    {
+      signal = bench_wait_signal(conn,
+				 WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_SUBSCRIPTION_IND,
+				 access_id);
+      if (signal == NULL)
+	return;
+
+      /* Skip to the trailing send time */
+      timestamp = 0;
+      if (dbus_message_iter_init(signal, &iter))
+	{
+	  while (dbus_message_iter_has_next(&iter))
+	    dbus_message_iter_next(&iter);
+	  if (dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_INT64)
+	    dbus_message_iter_get_basic(&iter, &timestamp);
+	}
+      bench_samples_add(indications, timestamp, bench_now());
+      dbus_message_unref(signal);
+    }
+}
+
+static gboolean bench_node_register(DBusConnection *conn)
+{
+  const gchar *uuid = BENCH_NODE_UUID;
+  DBusMessage *reply = NULL;
+  gboolean retval;
+
+  reply = bench_call(conn, WHITEBOARD_DBUS_REGISTER_INTERFACE,
+		     WHITEBOARD_DBUS_REGISTER_METHOD_NODE,
+		     DBUS_TYPE_STRING, &uuid,
+		     DBUS_TYPE_INVALID);
+  retval = (bench_reply_int(reply) == 0);
+  if (reply != NULL)
+    dbus_message_unref(reply);
+
+  return retval;
+}
+
+/*****************************************************************************
+ * Main
+ *****************************************************************************/
+
+int main(int argc, char **argv)
+{
+  GOptionContext *option_context = NULL;
+  GError *error = NULL;
+  gchar *address = NULL;
+  gchar *daemon_argv[6];
+  gchar *ring_size = NULL;
+  GPid daemon_pid = 0;
+  GThread *sib_thread = NULL;
+  BenchSIB sib;
+  DBusConnection *node = NULL;
+  BenchSamples *samples[7];
+  gint i;
+  int retval = 1;
+
+  option_context = g_option_context_new("- whiteboardd routing benchmark");
+  g_option_context_add_main_entries(option_context, bench_options, NULL);
+  if (!g_option_context_parse(option_context, &argc, &argv, &error))
+    {
+      fprintf(stderr, "%s\n", error->message);
+      g_error_free(error);
+      g_option_context_free(option_context);
+      return 1;
+    }
+  g_option_context_free(option_context);
+
+  bench_count = MAX(bench_count, 1);
+  bench_joins = MAX(bench_joins, 1);
+
+  g_thread_init(NULL);
+  dbus_threads_init_default();
+
+  if (bench_socket == NULL)
+    bench_socket = g_strdup_printf("/tmp/whiteboardd-bench-%d", (gint) getpid());
+  address = g_strdup_printf("unix:path=%s", bench_socket);
+
+  /* Start the daemon on a private socket */
+  daemon_argv[0] = bench_daemon;
+  daemon_argv[1] = "--socket";
+  daemon_argv[2] = bench_socket;
+  daemon_argv[3] = NULL;
+  if (bench_shm_ring_size > 0)
+    {
+#ifdef SHM_RING_SUPPORTED
+      ring_size = g_strdup_printf("%d", bench_shm_ring_size);
+      daemon_argv[3] = "--shm-ring-size";
+      daemon_argv[4] = ring_size;
+      daemon_argv[5] = NULL;
+#else
+      fprintf(stderr, "Shared memory rings are not supported in this build\n");
+      g_free(address);
+      return 1;
+#endif
+    }
+  if (!g_spawn_async(NULL, daemon_argv, NULL,
+		     G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+		     NULL, NULL, &daemon_pid, &error))
+    {
+      fprintf(stderr, "Could not start %s: %s\n", bench_daemon, error->message);
+      g_error_free(error);
+      g_free(ring_size);
+      g_free(address);
+      return 1;
+    }
+
+  memset(&sib, 0, sizeof(sib));
+  sib.connection = bench_connect(address);
+  node = bench_connect(address);
+  if (sib.connection == NULL || node == NULL)
+    {
+      fprintf(stderr, "Could not connect to %s\n", address);
+      goto out;
+    }
+
+  if (!bench_sib_register(&sib) || !bench_node_register(node))
+    {
+      fprintf(stderr, "Registration failed\n");
+      goto out;
+    }
+
+  dbus_connection_add_filter(sib.connection, bench_sib_filter, &sib, NULL);
+  sib.running = 1;
+  sib_thread = g_thread_create(bench_sib_thread, &sib, TRUE, NULL);
+
+  samples[0] = bench_samples_new("join", bench_joins);
+  samples[1] = bench_samples_new("insert", bench_count);
+  samples[2] = bench_samples_new("update", bench_count);
+  samples[3] = bench_samples_new("remove", bench_count);
+  samples[4] = bench_samples_new("query", bench_count);
+  samples[5] = bench_samples_new("subscribe", 1);
+  samples[6] = bench_samples_new("indication", bench_count);
+
+  bench_node_join(node, samples[0], bench_joins);
+  bench_node_write(node, WHITEBOARD_DBUS_NODE_METHOD_INSERT, samples[1],
+		   bench_count);
+  bench_node_write(node, WHITEBOARD_DBUS_NODE_METHOD_UPDATE, samples[2],
+		   bench_count);
+  bench_node_write(node, WHITEBOARD_DBUS_NODE_METHOD_REMOVE, samples[3],
+		   bench_count);
+  bench_node_query(node, samples[4], bench_count);
+  bench_node_subscribe(node, samples[5], samples[6], bench_count);
+
+  printf("%-14s %8s %12s %10s %10s %10s\n",
+	 "operation", "count", "ops/s", "p50 us", "p99 us", "p999 us");
+  for (i = 0; i < 7; i++)
+    {
+      bench_samples_report(samples[i]);
+      bench_samples_free(samples[i]);
+    }
+  retval = 0;
+
+ out:
+  if (sib_thread != NULL)
+    {
+      g_atomic_int_set(&sib.running, 0);
+      g_thread_join(sib_thread);
+    }
+  if (node != NULL)
+    {
+      dbus_connection_close(node);
+      dbus_connection_unref(node);
+    }
+  if (sib.connection != NULL)
+    {
+      dbus_connection_close(sib.connection);
+      dbus_connection_unref(sib.connection);
+    }
+#ifdef SHM_RING_SUPPORTED
+  if (sib.ring != NULL)
+    shm_ring_unref(sib.ring);
+#endif
+
+  kill(daemon_pid, SIGTERM);
+  waitpid(daemon_pid, NULL, 0);
+  g_spawn_close_pid(daemon_pid);
+  unlink(bench_socket);
+  g_free(ring_size);
+  g_free(address);
+
+  return retval;
+}
@@ -0,0 +1,188 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard daemon.
+ *
+ * access_route.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef ACCESS_ROUTE_H
+#define ACCESS_ROUTE_H
+
+#include <glib.h>
+
+#define DBUS_API_SUBJECT_TO_CHANGE
+
+#include <dbus/dbus.h>
+
+/* Default number of slots in the access id routing table */
+#define ACCESS_ROUTE_TABLE_DEFAULT_SIZE 4096
+
+/* Resolution of access id deadlines, access_route_table_expire is
+   expected to be called at this interval */
+#define ACCESS_ROUTE_TICK_MS 1000
+
+/**
+ * Operation an access id was allocated for
+ */
+typedef enum
+{
+  ACCESS_ROUTE_OP_NONE = 0,
+  ACCESS_ROUTE_OP_JOIN,
+  ACCESS_ROUTE_OP_WRITE,
+  ACCESS_ROUTE_OP_QUERY,
+  ACCESS_ROUTE_OP_SUBSCRIBE
+} AccessRouteOp;
+
+/**
+ * Route of an access id, as copied out of the table by a lookup. The
+ * node connection owns the id.
+ */
+typedef struct _AccessRoute
+{
+  DBusConnection *node_connection;
+  DBusConnection *sib_connection;
+  AccessRouteOp op;
+  gint64 created; // microseconds since the epoch
+  gint64 deadline; // microseconds since the epoch, 0 for none
+} AccessRoute;
+
+/**
+ * Called for each access id removed by access_route_table_expire
+ */
+typedef void (*AccessRouteFunc) (gint id,
+				 AccessRoute *route,
+				 gpointer user_data);
+
+struct _AccessRouteTable;
+
+typedef struct _AccessRouteTable AccessRouteTable;
+
+/**
+ * Create a new routing table
+ *
+ * @param size Number of slots, rounded up to a power of two
+ * @return AccessRouteTable instance
+ */
+AccessRouteTable *access_route_table_new(guint size);
+
+/**
+ * Destroy a routing table
+ *
+ * @param self AccessRouteTable instance
+ */
+void access_route_table_destroy(AccessRouteTable *self);
+
+/**
+ * Publish the route of an access id. Ids must be positive and not
+ * already in the table.
+ *
+ * @param self AccessRouteTable instance
+ * @param id Access id
+ * @param node_conn Connection of the node
+ * @param sib_conn Connection of the SIB access process
+ * @param op Operation the id was allocated for
+ * @param timeout_ms Time after which the id expires, 0 for never
+ */
+void access_route_table_insert(AccessRouteTable *self,
+			       gint id,
+			       DBusConnection *node_conn,
+			       DBusConnection *sib_conn,
+			       AccessRouteOp op,
+			       guint timeout_ms);
+
+/**
+ * Change the deadline of an access id, e.g. when a subscription is
+ * established and the id becomes long lived.
+ *
+ * @param self AccessRouteTable instance
+ * @param id Access id
+ * @param timeout_ms Time from now after which the id expires, 0 for never
+ * @return TRUE if the id was found
+ */
+gboolean access_route_table_set_timeout(AccessRouteTable *self,
+					gint id,
+					guint timeout_ms);
+
+/**
+ * Find the route of an access id. Does not take locks unless the id
+ * spilled out of its slot. Connections are not referenced.
+ *
+ * @param self AccessRouteTable instance
+ * @param id Access id
+ * @param route Where the route is copied, may be NULL
+ * @return TRUE if the id was found
+ */
+gboolean access_route_table_lookup(AccessRouteTable *self,
+				   gint id,
+				   AccessRoute *route);
+
+/**
+ * Remove the route of an access id
+ *
+ * @param self AccessRouteTable instance
+ * @param id Access id
+ * @return TRUE if the id was found
+ */
+gboolean access_route_table_remove(AccessRouteTable *self, gint id);
+
+/**
+ * Remove the access ids whose deadline has passed. The callback is
+ * called for each removed id after the table is unlocked.
+ *
+ * @param self AccessRouteTable instance
+ * @param func Callback for each expired id
+ * @param user_data User data pointer
+ * @return number of expired ids
+ */
+guint access_route_table_expire(AccessRouteTable *self,
+				AccessRouteFunc func,
+				gpointer user_data);
+
+/**
+ * Get the counters of a routing table. Any of the pointers may be NULL.
+ *
+ * @param self AccessRouteTable instance
+ * @param size Number of routed ids
+ * @param overflow Number of ids in the overflow table
+ * @param expired Number of ids removed by access_route_table_expire
+ */
+void access_route_table_get_statistics(AccessRouteTable *self,
+				       guint *size,
+				       guint *overflow,
+				       guint *expired);
+
+#endif
@@ -43,8 +43,12 @@
 #define ACCESS_SIB_H
 
 #include <glib.h>
+
+#define DBUS_API_SUBJECT_TO_CHANGE
+
+#include <dbus/dbus.h>
 #include <whiteboard_util.h>
-#include <whiteboard_log.h>
+#include "whiteboard_daemon_log.h"
 
 struct _AccessSIB;
 
@@ -107,6 +111,24 @@ gboolean access_sib_get_uuid(AccessSIB* source, gchar** uuid);
  */
 gboolean access_sib_get_name(AccessSIB* source, gchar** name);
 
+/**
+ * Set the DBus connection of the SIB access process serving this SIB.
+ * A reference to the connection is held until it is replaced or cleared.
+ *
+ * @param source A AccessSIB instance
+ * @param conn DBusConnection of the SIB access process, NULL to clear
+ */
+void access_sib_set_connection(AccessSIB* source, DBusConnection* conn);
+
+/**
+ * Get the DBus connection of the SIB access process serving this SIB.
+ * The returned connection is referenced, unref it when done.
+ *
+ * @param source A AccessSIB instance
+ * @return DBusConnection or NULL if the SIB access process is not connected
+ */
+DBusConnection* access_sib_get_connection(AccessSIB* source);
+
 /**
  * Compare a AccessSIB with a access_sib id
  *
@@ -115,12 +137,38 @@ gboolean access_sib_get_name(AccessSIB* source, gchar** name);
  */
 gint access_sib_compare_id(gconstpointer a, gconstpointer b);
 
+/**
+ * Hash function for SIB and node UUIDs. UUIDs are compared
+ * case-insensitively, so the hash is computed over the lowercased string.
+ *
+ * @param key A UUID string
+ * @return hash value
+ */
+guint access_sib_uuid_hash(gconstpointer key);
+
+/**
+ * Case-insensitive equality for SIB and node UUIDs
+ *
+ * @param a A UUID string
+ * @param b A UUID string
+ * @return TRUE if the UUIDs are equal
+ */
+gboolean access_sib_uuid_equal(gconstpointer a, gconstpointer b);
+
 gboolean access_sib_is_node_joined( AccessSIB *node, const gchar *nodeid);
 
 void access_sib_add_to_joined_nodes(  AccessSIB *node, gchar *nodeid);
 
 void access_sib_remove_from_joined_nodes(  AccessSIB *node, gchar *nodeid);
 
+/**
+ * Get the ids of the nodes joined to this SIB. The returned list and the
+ * ids in it are copies, free the ids with g_free and the list with
+ * g_list_free.
+ *
+ * @param self A AccessSIB instance
+ * @return newly allocated list of node ids
+ */
 GList *access_sib_get_joined_nodes(AccessSIB *self);
 
 #endif
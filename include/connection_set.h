@@ -0,0 +1,147 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard daemon.
+ *
+ * connection_set.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef CONNECTION_SET_H
+#define CONNECTION_SET_H
+
+#include <glib.h>
+
+#define DBUS_API_SUBJECT_TO_CHANGE
+
+#include <dbus/dbus.h>
+
+struct _ConnectionSet;
+
+typedef struct _ConnectionSet ConnectionSet;
+
+struct _ConnectionSnapshot;
+
+typedef struct _ConnectionSnapshot ConnectionSnapshot;
+
+/*****************************************************************************
+ * Creation/destruction
+ *****************************************************************************/
+
+/**
+ * Create a new, empty connection set
+ *
+ * @return ConnectionSet instance
+ */
+ConnectionSet *connection_set_new(void);
+
+/**
+ * Destroy a connection set. Snapshots taken from it stay valid.
+ *
+ * @param self ConnectionSet instance
+ */
+void connection_set_destroy(ConnectionSet *self);
+
+/*****************************************************************************
+ * Membership
+ *****************************************************************************/
+
+/**
+ * Add a connection to the set. The set does not reference connections,
+ * remove them before they are freed.
+ *
+ * @param self ConnectionSet instance
+ * @param conn DBusConnection
+ * @return TRUE if the connection was added, FALSE if already a member
+ */
+gboolean connection_set_add(ConnectionSet *self, DBusConnection *conn);
+
+/**
+ * Remove a connection from the set
+ *
+ * @param self ConnectionSet instance
+ * @param conn DBusConnection
+ * @return TRUE if the connection was a member
+ */
+gboolean connection_set_remove(ConnectionSet *self, DBusConnection *conn);
+
+/**
+ * Check if a connection is a member of the set
+ *
+ * @param self ConnectionSet instance
+ * @param conn DBusConnection
+ * @return TRUE if the connection is a member
+ */
+gboolean connection_set_contains(ConnectionSet *self, DBusConnection *conn);
+
+/**
+ * Get the number of connections in the set
+ *
+ * @param self ConnectionSet instance
+ * @return number of connections
+ */
+guint connection_set_size(ConnectionSet *self);
+
+/*****************************************************************************
+ * Snapshots
+ *****************************************************************************/
+
+/**
+ * Get the connected members of the set for iteration, e.g. to broadcast
+ * a signal. The snapshot is shared by all callers until the set changes
+ * and holds a reference to each connection in it.
+ *
+ * @param self ConnectionSet instance
+ * @return ConnectionSnapshot, release it with connection_snapshot_unref
+ */
+ConnectionSnapshot *connection_set_snapshot(ConnectionSet *self);
+
+/**
+ * Get the connections of a snapshot. The list belongs to the snapshot,
+ * do not modify or free it.
+ *
+ * @param snapshot ConnectionSnapshot instance
+ * @return list of DBusConnections
+ */
+GList *connection_snapshot_get_list(ConnectionSnapshot *snapshot);
+
+/**
+ * Release a snapshot
+ *
+ * @param snapshot ConnectionSnapshot instance, may be NULL
+ */
+void connection_snapshot_unref(ConnectionSnapshot *snapshot);
+
+#endif
@@ -105,6 +105,25 @@
 
 #include <dbus/dbus.h>
 #include <dbus/dbus-glib.h>
+#include "access_route.h"
+#include "connection_set.h"
+#include "dispatch_scheduler.h"
+#include "shm_ring.h"
+
+/* Default time a node waits for a join, query or subscribe before the
+   access id expires and the node gets a failure */
+#define DBUSHANDLER_DEFAULT_ACCESS_TIMEOUT 60000
+
+/* Bytes a connection may have queued before broadcasts skip it */
+#define DBUSHANDLER_BROADCAST_MAX_OUTGOING (1024 * 1024)
+
+/* Default caps of the outbound queue of a SIB access connection */
+#define DBUSHANDLER_DEFAULT_SIB_QUEUE_BYTES (4 * 1024 * 1024)
+#define DBUSHANDLER_DEFAULT_SIB_QUEUE_REQUESTS 1024
+
+/* An overloaded SIB access connection accepts requests again once its
+   queue drains below this percentage of both caps */
+#define DBUSHANDLER_SIB_QUEUE_LOW_PERCENT 50
 
 struct _DBusHandler;
 typedef struct _DBusHandler DBusHandler;
@@ -129,11 +148,23 @@ DBusHandler *dbushandler_new();
  */
 void dbushandler_destroy(DBusHandler *self);
 
+/**
+ * Start I/O worker threads. Connections accepted afterwards are spread
+ * over the workers round-robin, all messages of one connection are
+ * dispatched by the same worker. Without workers connections are
+ * dispatched in the main loop. Call once before running the main loop.
+ *
+ * @param self pointer to dbushandler instance
+ * @param count number of worker threads, 0 for none
+ */
+void dbushandler_start_workers(DBusHandler *self, guint count);
+
 
 /**
  * Callback definition for sib registration events
  */
 typedef void (*WhiteBoardSIBRegisteredCB) (DBusHandler* context,  
+					   DBusConnection* conn,
 					   gchar* uuid,
 					   gchar* name, 
 					   gpointer user_data);
@@ -186,6 +217,179 @@ void dbushandler_set_callback_node_disconnected(DBusHandler *self,
 					     WhiteBoardNodeDisconnectedCB cb,
 					     gpointer user_data);
 
+/**
+ * Callback definition for access ids that expired or whose node or SIB
+ * access connection went away. node_connection of the route is NULL if
+ * the node itself disconnected.
+ */
+typedef void (*WhiteBoardAccessExpiredCB) (DBusHandler* context,
+					   gint accessid,
+					   AccessRoute *route,
+					   gpointer user_data);
+
+/**
+ * Set callback for expired and reclaimed access ids.
+ *
+ * @param self DBusHandler instance
+ * @param cb Callback function
+ * @param user_data User data pointer
+ */
+void dbushandler_set_callback_access_expired(DBusHandler *self,
+					     WhiteBoardAccessExpiredCB cb,
+					     gpointer user_data);
+
+/**
+ * Callback definition for direct channels opening or closing between a
+ * node and a SIB access process. Called with the DBusHandler lock held,
+ * the callback must not call back into the DBusHandler.
+ */
+typedef void (*WhiteBoardDirectChannelCB) (DBusHandler* context,
+					   const gchar *sibid,
+					   gpointer user_data);
+
+/**
+ * Set callback for direct channels opening or closing.
+ *
+ * @param self DBusHandler instance
+ * @param cb Callback function
+ * @param user_data User data pointer
+ */
+void dbushandler_set_callback_direct_channel(DBusHandler *self,
+					     WhiteBoardDirectChannelCB cb,
+					     gpointer user_data);
+
+/**
+ * Callback definition for adding counters of other components to the
+ * WHITEBOARD_DBUS_METHOD_GET_STATISTICS reply, see
+ * dbushandler_append_statistic.
+ */
+typedef void (*WhiteBoardStatisticsCB) (DBusHandler* context,
+					DBusMessageIter *dict,
+					gpointer user_data);
+
+/**
+ * Set callback for adding counters to the statistics reply.
+ *
+ * @param self DBusHandler instance
+ * @param cb Callback function
+ * @param user_data User data pointer
+ */
+void dbushandler_set_callback_statistics(DBusHandler *self,
+					 WhiteBoardStatisticsCB cb,
+					 gpointer user_data);
+
+/**
+ * Append a counter to the a{su} dictionary of the statistics reply
+ *
+ * @param dict Dictionary iterator passed to WhiteBoardStatisticsCB
+ * @param name Counter name
+ * @param value Counter value
+ */
+void dbushandler_append_statistic(DBusMessageIter *dict,
+				  const gchar *name,
+				  dbus_uint32_t value);
+
+/**
+ * Set the time after which join, query and subscribe access ids expire.
+ *
+ * @param self DBusHandler instance
+ * @param timeout_ms Timeout in milliseconds, 0 for never
+ */
+void dbushandler_set_access_timeout(DBusHandler *self, guint timeout_ms);
+
+/**
+ * Get the access id timeout.
+ *
+ * @param self DBusHandler instance
+ * @return Timeout in milliseconds, 0 for never
+ */
+guint dbushandler_get_access_timeout(DBusHandler *self);
+
+/**
+ * Set the caps of the outbound queue of each SIB access connection. The
+ * queue holds the bytes libdbus has not yet written and the requests the
+ * SIB has not yet answered.
+ *
+ * @param self DBusHandler instance
+ * @param max_bytes Queued bytes at which requests are refused, 0 for no cap
+ * @param max_requests Unanswered requests at which requests are refused,
+ *        0 for no cap
+ */
+void dbushandler_set_sib_queue_limits(DBusHandler *self,
+				      guint max_bytes,
+				      guint max_requests);
+
+/**
+ * Check if a request may be queued on a SIB access connection. Once a cap
+ * is hit the connection refuses requests until its queue drains below
+ * DBUSHANDLER_SIB_QUEUE_LOW_PERCENT of the caps.
+ *
+ * @param self DBusHandler instance
+ * @param sib_conn Connection of the SIB access process
+ * @return TRUE if the request may be sent, FALSE if the SIB is overloaded
+ */
+gboolean dbushandler_sib_can_send(DBusHandler *self,
+				  DBusConnection *sib_conn);
+
+/**
+ * Set the size of the shared memory ring offered to local SIB access
+ * processes that announce WHITEBOARD_SIB_CAPABILITY_SHM_RING. Applies to
+ * SIB access processes registering afterwards.
+ *
+ * @param self DBusHandler instance
+ * @param size Size of the data area of the ring, 0 to offer none
+ */
+void dbushandler_set_shm_ring_size(DBusHandler *self, guint size);
+
+/**
+ * Enable or disable brokering direct channels between nodes and SIB
+ * access processes, see WHITEBOARD_DBUS_NODE_SIGNAL_DIRECT_CHANNEL.
+ *
+ * @param self DBusHandler instance
+ * @param enabled TRUE to open direct channels after joins
+ */
+void dbushandler_set_direct_channels(DBusHandler *self, gboolean enabled);
+
+/**
+ * Open a direct channel between a node that joined a SIB and the SIB
+ * access process, if enabled and both announced the capability. A channel
+ * already open between them is revoked first.
+ *
+ * @param self DBusHandler instance
+ * @param node_conn Connection of the node
+ * @param sib_conn Connection of the SIB access process
+ * @param nodeid Id of the node
+ * @param sibid UUID of the SIB
+ * @return TRUE if the channel was opened
+ */
+gboolean dbushandler_open_direct_channel(DBusHandler *self,
+					 DBusConnection *node_conn,
+					 DBusConnection *sib_conn,
+					 const gchar *nodeid,
+					 const gchar *sibid);
+
+/**
+ * Revoke the direct channel between a node and a SIB, if any.
+ *
+ * @param self DBusHandler instance
+ * @param nodeid Id of the node
+ * @param sibid UUID of the SIB
+ */
+void dbushandler_close_direct_channel(DBusHandler *self,
+				      const gchar *nodeid,
+				      const gchar *sibid);
+
+/**
+ * Check if a SIB access process has direct channels open. Nodes write
+ * through them without the daemon seeing the requests.
+ *
+ * @param self DBusHandler instance
+ * @param sib_conn Connection of the SIB access process
+ * @return TRUE if at least one direct channel is open
+ */
+gboolean dbushandler_sib_has_direct_channels(DBusHandler *self,
+					     DBusConnection *sib_conn);
+
 /**
  * Get Dbus connection reference to session daemon.
  *
@@ -200,18 +404,42 @@ DBusConnection *dbushandler_get_session_bus(DBusHandler *self);
  *
  * @param self DBusHandler instance
  *
- * @return Pointer to GList structure containing the needed dbus connections.
+ * @return Snapshot of the connections, release it with
+ * connection_snapshot_unref.
  */
-GList * dbushandler_get_control_connections(DBusHandler *self); 
+ConnectionSnapshot * dbushandler_get_control_connections(DBusHandler *self); 
 
 /**
  * Get all available Node connections.
  *
  * @param self DBusHandler instance
  *
- * @return Pointer to GList structure containing the needed dbus connections.
+ * @return Snapshot of the connections, release it with
+ * connection_snapshot_unref.
+ */
+ConnectionSnapshot * dbushandler_get_node_connections(DBusHandler *self); 
+
+/**
+ * Get the capabilities a node announced when registering.
+ *
+ * @param self DBusHandler instance
+ * @param conn Node DBusConnection
+ *
+ * @return WHITEBOARD_NODE_CAPABILITY_* mask
+ */
+guint dbushandler_get_node_capabilities(DBusHandler *self,
+					DBusConnection *conn);
+
+/**
+ * Get the UUIDs registered on a connection.
+ *
+ * @param self DBusHandler instance
+ * @param conn DBusConnection
+ *
+ * @return List of copied UUIDs, free the strings and the list
  */
-GList * dbushandler_get_node_connections(DBusHandler *self); 
+GSList *dbushandler_get_connection_uuids(DBusHandler *self,
+					 DBusConnection *conn);
 
 
 
@@ -220,9 +448,26 @@ GList * dbushandler_get_node_connections(DBusHandler *self);
  *
  * @param self DBusHandler instance
  *
- * @return Pointer to GList structure containing the needed dbus connections.
+ * @return Snapshot of the connections, release it with
+ * connection_snapshot_unref.
+ */
+ConnectionSnapshot * dbushandler_get_discovery_connections(DBusHandler *self); 
+
+/**
+ * Queue a message on every connection of a snapshot. The message is
+ * marshalled once and shared by all the outgoing queues, the connections'
+ * main loops write it out. Connections with more than
+ * DBUSHANDLER_BROADCAST_MAX_OUTGOING bytes already queued are skipped.
+ *
+ * @param self DBusHandler instance
+ * @param connections Snapshot from dbushandler_get_*_connections
+ * @param msg Message to send
+ *
+ * @return number of connections the message was queued on
  */
-GList * dbushandler_get_discovery_connections(DBusHandler *self); 
+guint dbushandler_broadcast(DBusHandler *self,
+			    ConnectionSnapshot *connections,
+			    DBusMessage *msg);
 
 
 /**
@@ -298,19 +543,52 @@ DBusConnection *dbushandler_get_sib_access_connection_by_access_id(DBusHandler *
 DBusConnection *dbushandler_get_node_connection_by_access_id(DBusHandler *self,
 							     gint accessid);
 
-void dbushandler_set_sib_connection_with_access_id(DBusHandler *self,
-						   gint accessid,
-						   DBusConnection* sib_access_conn);
+/**
+ * Get the node and SIB access connections of an access id with one
+ * lookup. Safe to call from any dispatch thread without locking.
+ *
+ * @param self DBusHandler instance
+ * @param accessid Access id
+ * @param route Where the route is copied
+ * @return TRUE if the access id is valid
+ */
+gboolean dbushandler_get_access_route(DBusHandler *self,
+				      gint accessid,
+				      AccessRoute *route);
 
-void dbushandler_set_node_connection_with_access_id(DBusHandler *self,
-						    gint accessid,
-						    DBusConnection* node_conn);
+/**
+ * Get a new access id that is not routed. The id counter wraps around,
+ * so long lived ids, e.g. of subscriptions, are skipped.
+ *
+ * @param self DBusHandler instance
+ * @return A new positive access id
+ */
+gint dbushandler_new_access_id(DBusHandler *self);
 
+/**
+ * Route an access id between a node and a SIB access process
+ *
+ * @param self DBusHandler instance
+ * @param accessid Access id from dbushandler_new_access_id
+ * @param node_conn Connection of the node
+ * @param sib_access_conn Connection of the SIB access process
+ * @param op Operation the access id was allocated for
+ */
 void dbushandler_associate_access_id(DBusHandler* self,
 				     gint accessid, 
 				     DBusConnection* node_conn,
-				     DBusConnection* sib_access_conn);
+				     DBusConnection* sib_access_conn,
+				     AccessRouteOp op);
 
 void dbushandler_invalidate_access_id(DBusHandler *self, gint accessid);
 
+/**
+ * Keep an access id until it is invalidated or its connections go away,
+ * e.g. once a subscription is established.
+ *
+ * @param self DBusHandler instance
+ * @param accessid Access id
+ */
+void dbushandler_keep_access_id(DBusHandler *self, gint accessid);
+
 #endif
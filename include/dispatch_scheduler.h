@@ -0,0 +1,109 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard daemon.
+ *
+ * dispatch_scheduler.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef DISPATCH_SCHEDULER_H
+#define DISPATCH_SCHEDULER_H
+
+#include <glib.h>
+
+#define DBUS_API_SUBJECT_TO_CHANGE
+
+#include <dbus/dbus.h>
+
+/* Default number of messages a connection dispatches before the next
+   ready connection gets its turn */
+#define DISPATCH_SCHEDULER_DEFAULT_QUANTUM 4
+
+struct _DispatchScheduler;
+
+typedef struct _DispatchScheduler DispatchScheduler;
+
+/*****************************************************************************
+ * Creation/destruction
+ *****************************************************************************/
+
+/**
+ * Create a scheduler dispatching the connections of a main context
+ * round-robin.
+ *
+ * @param context GMainContext the connections are served in
+ * @param quantum Messages a connection dispatches per turn
+ * @return DispatchScheduler instance
+ */
+DispatchScheduler *dispatch_scheduler_new(GMainContext *context,
+					  guint quantum);
+
+/**
+ * Destroy a scheduler. The main context must no longer be running.
+ *
+ * @param self DispatchScheduler instance
+ */
+void dispatch_scheduler_destroy(DispatchScheduler *self);
+
+/*****************************************************************************
+ * Connections
+ *****************************************************************************/
+
+/**
+ * Serve a connection in the scheduler's main context. Replaces
+ * dbus_connection_setup_with_g_main: the watches and timeouts of the
+ * connection are polled in the context and its incoming messages are
+ * dispatched in turns of at most quantum messages, rotating between all
+ * connections with messages waiting.
+ *
+ * @param self DispatchScheduler instance
+ * @param conn DBusConnection
+ */
+void dispatch_scheduler_add_connection(DispatchScheduler *self,
+				       DBusConnection *conn);
+
+/**
+ * Get the counters of a scheduler. Any of the pointers may be NULL.
+ *
+ * @param self DispatchScheduler instance
+ * @param turns Number of turns given to connections
+ * @param preempted Number of turns that ended with messages left
+ */
+void dispatch_scheduler_get_statistics(DispatchScheduler *self,
+				       guint *turns,
+				       guint *preempted);
+
+#endif
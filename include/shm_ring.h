@@ -0,0 +1,221 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard daemon.
+ *
+ * shm_ring.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <glib.h>
+
+/* Rings carry marshalled D-Bus messages and are handed over as unix fds */
+#if defined(HAVE_MEMFD_CREATE) && defined(HAVE_EVENTFD) && \
+  defined(HAVE_DBUS_UNIX_FD) && defined(HAVE_DBUS_MESSAGE_MARSHAL)
+#define SHM_RING_SUPPORTED 1
+#endif
+
+/*****************************************************************************
+ * Shared memory layout
+ *
+ * A ring is a sealed memfd shared by exactly one producer and one consumer
+ * process, plus an eventfd the producer writes to wake a sleeping
+ * consumer. The memfd holds a header followed by the data area:
+ *
+ *   offset 0    guint32 magic (SHM_RING_MAGIC), version (SHM_RING_VERSION),
+ *               size of the data area in bytes (a power of two)
+ *   offset 64   guint32 head, bytes ever written, advanced by the producer
+ *   offset 128  guint32 tail, bytes ever read, advanced by the consumer
+ *   offset 132  guint32 waiting, set by a consumer going to sleep
+ *   offset 192  data area
+ *
+ * head and tail run freely and wrap at 2^32, their difference is the
+ * number of bytes in use. A record is a guint32 length followed by the
+ * data, padded to SHM_RING_ALIGN bytes, and never wraps around the end of
+ * the data area: a length of SHM_RING_WRAP tells the consumer to continue
+ * at the start. The producer publishes a record by storing head after the
+ * record is written and writes the eventfd only if waiting is set; the
+ * consumer sets waiting and checks head again before it sleeps.
+ *****************************************************************************/
+
+#define SHM_RING_MAGIC 0x57425247 // "WBRG"
+#define SHM_RING_VERSION 1
+#define SHM_RING_HEADER_SIZE 192
+#define SHM_RING_ALIGN 8
+#define SHM_RING_WRAP 0xffffffff
+
+/* Default size of the data area of a ring */
+#define SHM_RING_DEFAULT_SIZE (1024 * 1024)
+
+/* Records larger than this fraction of the data area are refused, so that
+   a single record never waits for the whole ring to drain */
+#define SHM_RING_MAX_RECORD_DIVISOR 4
+
+/* Polls a consumer spins before it sleeps. Kept short, the consumer runs
+   in a main loop dispatch and holds up the other sources meanwhile. */
+#define SHM_RING_SPIN 64
+
+/* Records a consumer handles per main loop iteration */
+#define SHM_RING_DEFAULT_QUANTUM 32
+
+struct _ShmRing;
+
+typedef struct _ShmRing ShmRing;
+
+/**
+ * Called for each record read from a ring. The data is only valid during
+ * the call.
+ *
+ * @param ring ShmRing instance
+ * @param data Record data in the shared memory
+ * @param len Length of the record data
+ * @param user_data User data given to shm_ring_attach_consumer
+ */
+typedef void (*ShmRingFunc)(ShmRing *ring, const gchar *data, guint len,
+			    gpointer user_data);
+
+/*****************************************************************************
+ * Creation/destruction
+ *****************************************************************************/
+
+/**
+ * Create a ring with its memfd and eventfd.
+ *
+ * @param size Size of the data area, rounded up to a power of two
+ * @return ShmRing instance or NULL if shared memory is not available
+ */
+ShmRing *shm_ring_new(guint size);
+
+/**
+ * Map a ring created by the peer, to produce into it. The ring takes
+ * over both file descriptors, also when it fails.
+ *
+ * @param fd The memfd of the ring, sealed against shrinking
+ * @param event_fd The eventfd waking the consumer
+ * @return ShmRing instance or NULL if fd does not hold a valid ring
+ */
+ShmRing *shm_ring_open(gint fd, gint event_fd);
+
+/**
+ * Increase the reference count of a ring
+ *
+ * @param self ShmRing instance
+ * @return the ring
+ */
+ShmRing *shm_ring_ref(ShmRing *self);
+
+/**
+ * Decrease the reference count of a ring, unmapping it and closing its
+ * file descriptors when the count drops to zero
+ *
+ * @param self ShmRing instance
+ */
+void shm_ring_unref(ShmRing *self);
+
+/**
+ * Get the memfd holding the ring. Owned by the ring.
+ *
+ * @param self ShmRing instance
+ * @return file descriptor
+ */
+gint shm_ring_get_fd(ShmRing *self);
+
+/**
+ * Get the eventfd waking the consumer. Owned by the ring.
+ *
+ * @param self ShmRing instance
+ * @return file descriptor
+ */
+gint shm_ring_get_event_fd(ShmRing *self);
+
+/*****************************************************************************
+ * Producer
+ *****************************************************************************/
+
+/**
+ * Append a record and wake the consumer if it sleeps. Several threads may
+ * write to the same ring.
+ *
+ * @param self ShmRing instance
+ * @param data Record data
+ * @param len Length of the record data
+ * @return TRUE if the record was written, FALSE if the ring is full, the
+ *         record too large or the ring corrupted by the peer
+ */
+gboolean shm_ring_write(ShmRing *self, const gchar *data, guint len);
+
+/*****************************************************************************
+ * Consumer
+ *****************************************************************************/
+
+/**
+ * Consume the ring in a main context. Records are handed to func in turns
+ * of at most SHM_RING_DEFAULT_QUANTUM; when the ring runs empty the
+ * consumer spins SHM_RING_SPIN polls before it sleeps on the eventfd. A ring has
+ * at most one consumer.
+ *
+ * @param self ShmRing instance
+ * @param context GMainContext to consume the ring in
+ * @param func Function called for each record
+ * @param user_data User data for func
+ * @param notify Called for user_data when the consumer is detached
+ */
+void shm_ring_attach_consumer(ShmRing *self, GMainContext *context,
+			      ShmRingFunc func, gpointer user_data,
+			      GDestroyNotify notify);
+
+/**
+ * Stop consuming the ring. func is not called after this returns, unless
+ * from a dispatch already in progress in another thread.
+ *
+ * @param self ShmRing instance
+ */
+void shm_ring_detach_consumer(ShmRing *self);
+
+/**
+ * Get the counters of a ring. Any of the pointers may be NULL.
+ *
+ * @param self ShmRing instance
+ * @param records Records written or read
+ * @param wakeups Eventfd wakeups sent or received
+ * @param spin_hits Records that arrived while the consumer was spinning
+ */
+void shm_ring_get_statistics(ShmRing *self, guint *records, guint *wakeups,
+			     guint *spin_hits);
+
+#endif
@@ -0,0 +1,142 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard daemon.
+ *
+ * whiteboard_daemon_ifaces.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef WHITEBOARD_DAEMON_IFACES_H
+#define WHITEBOARD_DAEMON_IFACES_H
+
+#include <whiteboard_dbus_ifaces.h>
+
+/*****************************************************************************
+ * Node capabilities
+ *
+ * A node may append a UINT32 capability mask after the uuid argument of
+ * the register node method. Nodes that send only the uuid get none.
+ *****************************************************************************/
+
+#define WHITEBOARD_NODE_CAPABILITY_NONE            0
+/* Node understands WHITEBOARD_DBUS_NODE_SIGNAL_SUBSCRIPTION_IND_BATCH */
+#define WHITEBOARD_NODE_CAPABILITY_BATCHED_IND     (1 << 0)
+/* Node accepts WHITEBOARD_DBUS_NODE_SIGNAL_DIRECT_CHANNEL */
+#define WHITEBOARD_NODE_CAPABILITY_DIRECT_CHANNEL  (1 << 1)
+
+/*****************************************************************************
+ * SIB access capabilities
+ *
+ * A SIB access process may append a UINT32 capability mask after the local
+ * argument of the register SIB method.
+ *****************************************************************************/
+
+#define WHITEBOARD_SIB_CAPABILITY_NONE             0
+/* A local SIB access process that can use a shared memory ring. If the
+ * daemon offers one, the register reply carries two UNIX_FDs after the
+ * status: memfd and eventfd of the ring from the SIB access process. The
+ * ring carries marshalled D-Bus messages that expect no reply, see
+ * shm_ring.h for the layout. The SIB access process sends all of those
+ * through the ring, so that results and indications keep their order.
+ * Requests to the SIB access process stay on the connection. */
+#define WHITEBOARD_SIB_CAPABILITY_SHM_RING         (1 << 0)
+/* SIB access process accepts WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_DIRECT_CHANNEL */
+#define WHITEBOARD_SIB_CAPABILITY_DIRECT_CHANNEL   (1 << 1)
+
+/*****************************************************************************
+ * Overload
+ *
+ * Returned instead of the access id of join, query and subscribe and as
+ * the status of insert, update and remove when the outbound queue of the
+ * SIB is full. Like other negative values it means the request failed,
+ * nodes may retry later.
+ *****************************************************************************/
+
+#define WHITEBOARD_STATUS_OVERLOADED -2
+
+/* Returned the same way when the node or the SIB exceeded its request
+ * rate, see the --node-rate and --sib-rate options of the daemon. */
+#define WHITEBOARD_STATUS_RATE_LIMITED -3
+
+/*****************************************************************************
+ * Daemon specific node signals
+ *****************************************************************************/
+
+/* Several subscription indications for one node in a single signal on
+ * WHITEBOARD_DBUS_NODE_INTERFACE. The only argument is an array of
+ * subscription_ind signals, each serialized with dbus_message_marshal
+ * (signature aay), in the order they were received from the SIB. */
+#define WHITEBOARD_DBUS_NODE_SIGNAL_SUBSCRIPTION_IND_BATCH "subscription_ind_batch"
+
+/*****************************************************************************
+ * Direct channels
+ *
+ * When the daemon runs with --direct-channels and both a node and the SIB
+ * it joined announced the direct channel capability, the daemon hands each
+ * of them one end of a connected unix socket after the join completed.
+ * The node may then send insert, update, remove, query and subscribe
+ * straight to the SIB access process over the socket, as messages
+ * serialized with dbus_message_marshal in their node interface form, and
+ * the SIB access process answers and sends indications the same way.
+ * Join, leave and unsubscribe still go through the daemon. The daemon
+ * shuts the socket down when the node leaves the SIB or either side
+ * disconnects, both ends then see end of file.
+ *****************************************************************************/
+
+/* Signal on WHITEBOARD_DBUS_NODE_INTERFACE, arguments SIB uuid and the
+ * node's end of the socket (signature sh). */
+#define WHITEBOARD_DBUS_NODE_SIGNAL_DIRECT_CHANNEL "direct_channel"
+
+/* Signal on WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE, arguments node id and
+ * the SIB access process's end of the socket (signature sh). */
+#define WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_DIRECT_CHANNEL "direct_channel"
+
+/*****************************************************************************
+ * Daemon specific methods
+ *****************************************************************************/
+
+/* Method on WHITEBOARD_DBUS_INTERFACE without arguments, returns the
+ * daemon counters as a dictionary of name -> value (signature a{su}). */
+#define WHITEBOARD_DBUS_METHOD_GET_STATISTICS "get_statistics"
+
+/* Method on WHITEBOARD_DBUS_DISCOVERY_INTERFACE without arguments, returns
+ * all registered SIBs as an array of (uuid, name) in registration order
+ * (signature a(ss)). Replaces the sib signals and the all_for_now
+ * terminator sent for WHITEBOARD_DBUS_DISCOVERY_METHOD_GET_SIBS, which is
+ * kept for older nodes. */
+#define WHITEBOARD_DBUS_DISCOVERY_METHOD_GET_SIB_LIST "get_sib_list"
+
+#endif /* WHITEBOARD_DAEMON_IFACES_H */
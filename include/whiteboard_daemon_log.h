@@ -0,0 +1,95 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard daemon.
+ *
+ * whiteboard_daemon_log.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef WHITEBOARD_DAEMON_LOG_H
+#define WHITEBOARD_DAEMON_LOG_H
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+#include <whiteboard_log.h>
+
+/**
+ * Debug categories (WHITEBOARD_DEBUG_* bit flags) that are printed by
+ * whiteboard_daemon_log_debugc. All categories are enabled by default,
+ * the mask can be narrowed with the WHITEBOARD_DEBUG_MASK environment
+ * variable, see whiteboard_daemon_log_init.
+ */
+extern guint whiteboard_daemon_debug_mask;
+
+/**
+ * Read the runtime debug category mask from the environment.
+ * Call once at startup, before the main loop is entered.
+ */
+void whiteboard_daemon_log_init(void);
+
+#ifdef WHITEBOARD_TRACE_DISABLED
+
+/* Production build: function tracing and debug messages compile to
+ * nothing, so their arguments are never evaluated. Warnings and errors
+ * are kept. */
+#undef whiteboard_log_debug_fb
+#undef whiteboard_log_debug_fe
+#undef whiteboard_log_debug
+#undef whiteboard_log_debugc
+
+#define whiteboard_log_debug_fb() do { } while (0)
+#define whiteboard_log_debug_fe() do { } while (0)
+#define whiteboard_log_debug(...) do { } while (0)
+#define whiteboard_log_debugc(category, ...) do { } while (0)
+
+#define whiteboard_daemon_log_debugc(category, ...) do { } while (0)
+
+#else
+
+/* Check the category before any formatting is done */
+#define whiteboard_daemon_log_debugc(category, ...)			\
+  do									\
+    {									\
+      if (G_UNLIKELY(whiteboard_daemon_debug_mask & (category)))	\
+	whiteboard_log_debugc((category), __VA_ARGS__);			\
+    } while (0)
+
+#endif /* WHITEBOARD_TRACE_DISABLED */
+
+#endif /* WHITEBOARD_DAEMON_LOG_H */
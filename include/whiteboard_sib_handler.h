@@ -62,7 +62,53 @@ WhiteBoardSIBHandler *whiteboard_sib_handler_new(DBusHandler* dbus_handler);
 void whiteboard_sib_handler_destroy(WhiteBoardSIBHandler* self);
 
 /**
- * Get a new sib_handler transaction id (never returns the same id twice)
+ * Configure batching of subscription indications. Indications for a node
+ * that announced WHITEBOARD_NODE_CAPABILITY_BATCHED_IND are collected for
+ * up to window milliseconds or max_count messages and delivered as one
+ * signal. Other nodes always get single indications.
+ *
+ * @param self A pointer to WhiteBoardSibHandler instance
+ * @param window Batching window in milliseconds, 0 disables batching
+ * @param max_count Maximum number of indications in one batch
+ */
+void whiteboard_sib_handler_set_indication_batching(WhiteBoardSIBHandler *self,
+						    guint window,
+						    guint max_count);
+
+/**
+ * Configure token bucket rate limits of join, insert, update, remove,
+ * query and subscribe requests, per node connection and per SIB. Requests
+ * over the rate are answered with WHITEBOARD_STATUS_RATE_LIMITED without being
+ * forwarded, so one flooding node cannot starve the others.
+ *
+ * @param self A pointer to WhiteBoardSibHandler instance
+ * @param node_rate Requests per second of one node, 0 for no limit
+ * @param node_burst Requests a node may send at once
+ * @param sib_rate Requests per second to one SIB, 0 for no limit
+ * @param sib_burst Requests a SIB may get at once
+ */
+void whiteboard_sib_handler_set_rate_limits(WhiteBoardSIBHandler *self,
+					    guint node_rate,
+					    guint node_burst,
+					    guint sib_rate,
+					    guint sib_burst);
+
+/**
+ * Configure the query result cache. Results are cached per SIB, query
+ * type and query, and the results of a SIB are invalidated whenever a
+ * write to it is forwarded or completes and whenever it sends a
+ * subscription indication. Only enable it when the SIBs are written
+ * through this daemon, writes by others go unnoticed.
+ *
+ * @param self A pointer to WhiteBoardSibHandler instance
+ * @param max_entries Maximum number of cached results, 0 disables caching
+ */
+void whiteboard_sib_handler_set_query_cache(WhiteBoardSIBHandler *self,
+					    guint max_entries);
+
+/**
+ * Get a new sib_handler transaction id. Ids are positive and wrap back
+ * to 1 after G_MAXINT, use dbushandler_new_access_id for routed ids.
  *
  * @return A new sib_handler transaction id
  */
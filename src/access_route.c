@@ -0,0 +1,502 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard daemon.
+ *
+ * access_route.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <glib.h>
+
+#define DBUS_API_SUBJECT_TO_CHANGE
+
+#include <dbus/dbus.h>
+#include <whiteboard_util.h>
+#include "whiteboard_daemon_log.h"
+
+#include "access_route.h"
+
+#define ACCESS_ROUTE_CACHE_LINE 64
+
+/* Number of ACCESS_ROUTE_TICK_MS buckets in the deadline wheel, later
+   deadlines go around the wheel more than once */
+#define ACCESS_ROUTE_WHEEL_SIZE 64
+
+/* Slot states besides a published access id */
+#define ACCESS_ROUTE_SLOT_FREE 0
+#define ACCESS_ROUTE_SLOT_BUSY -1
+
+/* One access id route, padded to a cache line so that threads routing
+   different ids don't share lines */
+typedef union _AccessRouteSlot
+{
+  struct
+  {
+    // published access id, ACCESS_ROUTE_SLOT_FREE or ACCESS_ROUTE_SLOT_BUSY
+    volatile gint id;
+    AccessRoute route;
+  } s;
+  gchar padding[ACCESS_ROUTE_CACHE_LINE];
+} AccessRouteSlot;
+
+/* Expired id copied out of the table */
+typedef struct _AccessRouteExpired
+{
+  gint id;
+  AccessRoute route;
+} AccessRouteExpired;
+
+struct _AccessRouteTable
+{
+  AccessRouteSlot *slots;
+  gpointer slots_mem;
+  guint mask;
+
+  // ids whose slot was taken by a long lived id, e.g. a subscription
+  GHashTable *overflow;
+  volatile gint overflow_count;
+  GStaticMutex overflow_lock;
+
+  // ids with a deadline by deadline tick, entries of removed ids are
+  // dropped when their bucket is swept
+  GSList *wheel[ACCESS_ROUTE_WHEEL_SIZE];
+  gint64 wheel_tick; // last swept tick
+  // protects the wheel and the deadlines of published routes
+  GStaticMutex wheel_lock;
+
+  volatile gint size;
+  volatile gint expired;
+};
+
+static gint64 access_route_now(void);
+
+static gint64 access_route_tick(gint64 usec);
+
+static void access_route_table_wheel_add(AccessRouteTable *self,
+					 gint id,
+					 gint64 deadline);
+
+static gboolean access_route_table_get_deadline(AccessRouteTable *self,
+						gint id,
+						gint64 *deadline);
+
+/*****************************************************************************
+ * Creation/destruction
+ *****************************************************************************/
+
+AccessRouteTable *access_route_table_new(guint size)
+{
+  AccessRouteTable *self = NULL;
+  guint slots = 1;
+
+  whiteboard_log_debug_fb();
+
+  while (slots < size)
+    slots <<= 1;
+
+  self = g_new0(AccessRouteTable, 1);
+
+  /* Align the slots to cache lines */
+  self->slots_mem = g_malloc0((slots + 1) * sizeof(AccessRouteSlot));
+  self->slots = (AccessRouteSlot *)
+    (((gsize) self->slots_mem + ACCESS_ROUTE_CACHE_LINE - 1) &
+     ~((gsize) ACCESS_ROUTE_CACHE_LINE - 1));
+  self->mask = slots - 1;
+
+  self->overflow = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+					 NULL, g_free);
+  self->overflow_count = 0;
+  g_static_mutex_init(&self->overflow_lock);
+
+  self->wheel_tick = access_route_tick(access_route_now());
+  g_static_mutex_init(&self->wheel_lock);
+
+  whiteboard_log_debug_fe();
+
+  return self;
+}
+
+void access_route_table_destroy(AccessRouteTable *self)
+{
+  guint i = 0;
+
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail(NULL != self);
+
+  for (i = 0; i < ACCESS_ROUTE_WHEEL_SIZE; i++)
+    g_slist_free(self->wheel[i]);
+  g_static_mutex_free(&self->wheel_lock);
+
+  g_hash_table_destroy(self->overflow);
+  g_static_mutex_free(&self->overflow_lock);
+  g_free(self->slots_mem);
+  g_free(self);
+
+  whiteboard_log_debug_fe();
+}
+
+/*****************************************************************************
+ * Routing
+ *****************************************************************************/
+
+void access_route_table_insert(AccessRouteTable *self,
+			       gint id,
+			       DBusConnection *node_conn,
+			       DBusConnection *sib_conn,
+			       AccessRouteOp op,
+			       guint timeout_ms)
+{
+  AccessRouteSlot *slot = NULL;
+  AccessRoute *route = NULL;
+  gint64 now = 0;
+
+  g_return_if_fail(NULL != self);
+  g_return_if_fail(id > 0);
+
+  now = access_route_now();
+
+  slot = &self->slots[(guint) id & self->mask];
+
+  if (g_atomic_int_compare_and_exchange(&slot->s.id, ACCESS_ROUTE_SLOT_FREE,
+					ACCESS_ROUTE_SLOT_BUSY))
+    {
+      route = &slot->s.route;
+    }
+  else
+    {
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
+				   "Access id %d spilled to overflow table\n",
+				   id);
+      route = g_new0(AccessRoute, 1);
+    }
+
+  route->node_connection = node_conn;
+  route->sib_connection = sib_conn;
+  route->op = op;
+  route->created = now;
+
+  /* The deadline of a slot may be changed by set_timeout of a previous
+     id until the slot is claimed, so it is only written under the lock */
+  g_static_mutex_lock(&self->wheel_lock);
+  route->deadline = 0;
+  if (timeout_ms > 0)
+    {
+      route->deadline = now + (gint64) timeout_ms * 1000;
+      access_route_table_wheel_add(self, id, route->deadline);
+    }
+  g_static_mutex_unlock(&self->wheel_lock);
+
+  g_atomic_int_inc(&self->size);
+
+  if (route == &slot->s.route)
+    {
+      /* Publishes the route, the atomic store is a full barrier */
+      g_atomic_int_set(&slot->s.id, id);
+    }
+  else
+    {
+      g_static_mutex_lock(&self->overflow_lock);
+      g_hash_table_insert(self->overflow, GINT_TO_POINTER(id), route);
+      g_atomic_int_inc(&self->overflow_count);
+      g_static_mutex_unlock(&self->overflow_lock);
+    }
+}
+
+gboolean access_route_table_set_timeout(AccessRouteTable *self,
+					gint id,
+					guint timeout_ms)
+{
+  AccessRouteSlot *slot = NULL;
+  AccessRoute *route = NULL;
+  gint64 deadline = 0;
+
+  g_return_val_if_fail(NULL != self, FALSE);
+
+  if (id <= 0)
+    return FALSE;
+
+  if (timeout_ms > 0)
+    deadline = access_route_now() + (gint64) timeout_ms * 1000;
+
+  slot = &self->slots[(guint) id & self->mask];
+
+  g_static_mutex_lock(&self->wheel_lock);
+  g_static_mutex_lock(&self->overflow_lock);
+  if (g_atomic_int_get(&slot->s.id) == id)
+    route = &slot->s.route;
+  else
+    route = (AccessRoute *) g_hash_table_lookup(self->overflow,
+						GINT_TO_POINTER(id));
+  if (route != NULL)
+    {
+      route->deadline = deadline;
+      if (deadline > 0)
+	access_route_table_wheel_add(self, id, deadline);
+    }
+  g_static_mutex_unlock(&self->overflow_lock);
+  g_static_mutex_unlock(&self->wheel_lock);
+
+  return (route != NULL);
+}
+
+gboolean access_route_table_lookup(AccessRouteTable *self,
+				   gint id,
+				   AccessRoute *route)
+{
+  AccessRouteSlot *slot = NULL;
+  AccessRoute *overflow_route = NULL;
+  AccessRoute copy;
+
+  g_return_val_if_fail(NULL != self, FALSE);
+
+  if (id <= 0)
+    return FALSE;
+
+  slot = &self->slots[(guint) id & self->mask];
+
+  if (g_atomic_int_get(&slot->s.id) == id)
+    {
+      copy = slot->s.route;
+
+      /* If the id is still there the copy is not torn, ids are only
+	 reused after the counter wraps so a slot that was freed and
+	 taken again is noticed */
+      if (g_atomic_int_get(&slot->s.id) == id)
+	{
+	  if (route != NULL)
+	    *route = copy;
+	  return TRUE;
+	}
+      return FALSE;
+    }
+
+  if (g_atomic_int_get(&self->overflow_count) == 0)
+    return FALSE;
+
+  g_static_mutex_lock(&self->overflow_lock);
+  overflow_route = (AccessRoute *) g_hash_table_lookup(self->overflow,
+						       GINT_TO_POINTER(id));
+  if (overflow_route != NULL && route != NULL)
+    *route = *overflow_route;
+  g_static_mutex_unlock(&self->overflow_lock);
+
+  return (overflow_route != NULL);
+}
+
+gboolean access_route_table_remove(AccessRouteTable *self, gint id)
+{
+  AccessRouteSlot *slot = NULL;
+  gboolean retval = FALSE;
+
+  g_return_val_if_fail(NULL != self, FALSE);
+
+  if (id <= 0)
+    return FALSE;
+
+  slot = &self->slots[(guint) id & self->mask];
+
+  if (g_atomic_int_compare_and_exchange(&slot->s.id, id,
+					ACCESS_ROUTE_SLOT_BUSY))
+    {
+      slot->s.route.node_connection = NULL;
+      slot->s.route.sib_connection = NULL;
+      slot->s.route.op = ACCESS_ROUTE_OP_NONE;
+      g_atomic_int_set(&slot->s.id, ACCESS_ROUTE_SLOT_FREE);
+      g_atomic_int_add(&self->size, -1);
+      return TRUE;
+    }
+
+  if (g_atomic_int_get(&self->overflow_count) == 0)
+    return FALSE;
+
+  g_static_mutex_lock(&self->overflow_lock);
+  retval = g_hash_table_remove(self->overflow, GINT_TO_POINTER(id));
+  if (retval)
+    {
+      g_atomic_int_add(&self->overflow_count, -1);
+      g_atomic_int_add(&self->size, -1);
+    }
+  g_static_mutex_unlock(&self->overflow_lock);
+
+  return retval;
+}
+
+/*****************************************************************************
+ * Reclamation
+ *****************************************************************************/
+
+guint access_route_table_expire(AccessRouteTable *self,
+				AccessRouteFunc func,
+				gpointer user_data)
+{
+  GArray *expired = NULL;
+  AccessRouteExpired entry;
+  GSList *bucket = NULL;
+  GSList *link = NULL;
+  gint64 now = 0;
+  gint64 now_tick = 0;
+  gint64 tick = 0;
+  gint64 deadline = 0;
+  gint id = 0;
+  guint i = 0;
+
+  g_return_val_if_fail(NULL != self, 0);
+
+  now = access_route_now();
+  now_tick = access_route_tick(now);
+
+  expired = g_array_new(FALSE, FALSE, sizeof(AccessRouteExpired));
+
+  g_static_mutex_lock(&self->wheel_lock);
+
+  /* After a long stall one lap covers every bucket */
+  tick = MAX(self->wheel_tick + 1, now_tick - ACCESS_ROUTE_WHEEL_SIZE + 1);
+  self->wheel_tick = now_tick;
+
+  for (; tick <= now_tick; tick++)
+    {
+      bucket = self->wheel[tick % ACCESS_ROUTE_WHEEL_SIZE];
+      self->wheel[tick % ACCESS_ROUTE_WHEEL_SIZE] = NULL;
+
+      for (link = bucket; link != NULL; link = link->next)
+	{
+	  id = GPOINTER_TO_INT(link->data);
+
+	  /* Removed, or the deadline was cleared */
+	  if (!access_route_table_get_deadline(self, id, &deadline) ||
+	      deadline == 0)
+	    continue;
+
+	  if (deadline > now)
+	    {
+	      access_route_table_wheel_add(self, id, deadline);
+	      continue;
+	    }
+
+	  entry.id = id;
+	  if (access_route_table_lookup(self, id, &entry.route) &&
+	      access_route_table_remove(self, id))
+	    g_array_append_val(expired, entry);
+	}
+      g_slist_free(bucket);
+    }
+
+  g_static_mutex_unlock(&self->wheel_lock);
+
+  g_atomic_int_add(&self->expired, expired->len);
+
+  for (i = 0; i < expired->len; i++)
+    {
+      AccessRouteExpired *e = &g_array_index(expired, AccessRouteExpired, i);
+
+      whiteboard_log_warning("Access id %d (op %d) expired\n",
+			     e->id, e->route.op);
+      if (func != NULL)
+	func(e->id, &e->route, user_data);
+    }
+
+  i = expired->len;
+  g_array_free(expired, TRUE);
+
+  return i;
+}
+
+void access_route_table_get_statistics(AccessRouteTable *self,
+				       guint *size,
+				       guint *overflow,
+				       guint *expired)
+{
+  g_return_if_fail(NULL != self);
+
+  if (size != NULL)
+    *size = (guint) g_atomic_int_get(&self->size);
+  if (overflow != NULL)
+    *overflow = (guint) g_atomic_int_get(&self->overflow_count);
+  if (expired != NULL)
+    *expired = (guint) g_atomic_int_get(&self->expired);
+}
+
+/*****************************************************************************
+ * Private functions
+ *****************************************************************************/
+
+static gint64 access_route_now(void)
+{
+  GTimeVal now;
+
+  g_get_current_time(&now);
+
+  return (gint64) now.tv_sec * G_GINT64_CONSTANT(1000000) + now.tv_usec;
+}
+
+static gint64 access_route_tick(gint64 usec)
+{
+  return usec / (ACCESS_ROUTE_TICK_MS * 1000);
+}
+
+/* Call with wheel_lock held */
+static void access_route_table_wheel_add(AccessRouteTable *self,
+					 gint id,
+					 gint64 deadline)
+{
+  gint64 tick = 0;
+
+  /* Never into a bucket that was already swept for this lap */
+  tick = MAX(access_route_tick(deadline), self->wheel_tick + 1);
+
+  self->wheel[tick % ACCESS_ROUTE_WHEEL_SIZE] =
+    g_slist_prepend(self->wheel[tick % ACCESS_ROUTE_WHEEL_SIZE],
+		    GINT_TO_POINTER(id));
+}
+
+/* Call with wheel_lock held */
+static gboolean access_route_table_get_deadline(AccessRouteTable *self,
+						gint id,
+						gint64 *deadline)
+{
+  AccessRoute route;
+
+  if (!access_route_table_lookup(self, id, &route))
+    return FALSE;
+
+  *deadline = route.deadline;
+
+  return TRUE;
+}
@@ -43,8 +43,12 @@
 #include "config.h"
 #endif
 #include <glib.h>
+
+#define DBUS_API_SUBJECT_TO_CHANGE
+
+#include <dbus/dbus.h>
 #include <whiteboard_util.h>
-#include <whiteboard_log.h>
+#include "whiteboard_daemon_log.h"
 
 #include "access_sib.h"
 
@@ -53,8 +57,15 @@ struct _AccessSIB
   gchar* uuid;
   gchar* name;
 
-  // list for joined nodes
-  GList *joined_nodes; 
+  // connection of the SIB access process, NULL when disconnected
+  DBusConnection *connection;
+
+  // set of joined node ids (case-insensitive), key owned by the table
+  GHashTable *joined_nodes;
+
+  // protects connection and joined_nodes, SIBs are used from all
+  // dispatch threads
+  GStaticMutex lock;
   
   gint refcount;
 };
@@ -86,7 +97,10 @@ AccessSIB* access_sib_new(gchar* uuid, gchar* name)
 	source->uuid = g_strdup(uuid);
 	source->name = g_strdup(name);
 	
-	source->joined_nodes = NULL;
+	source->joined_nodes = g_hash_table_new_full(access_sib_uuid_hash,
+						     access_sib_uuid_equal,
+						     g_free, NULL);
+	g_static_mutex_init(&source->lock);
 	
 	source->refcount = 1;
  
@@ -112,7 +126,7 @@ gint access_sib_ref(AccessSIB* source)
 		/* Refcount is something sensible */
 		g_atomic_int_inc(&source->refcount);
 
-		whiteboard_log_debugc(WHITEBOARD_DEBUG_NODE, 
+		whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_NODE, 
 				    "AccessSIB %s (%s) refcount: %d\n",
 				    source->name, source->uuid,
 				    source->refcount);
@@ -120,7 +134,7 @@ gint access_sib_ref(AccessSIB* source)
 	else
 	{
 		/* Refcount is already zero */
-		whiteboard_log_debugc(WHITEBOARD_DEBUG_NODE,
+		whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_NODE,
 				    "AccessSIB %s (%s) refcount already %d!\n",
 				    source->name, source->uuid,
 				    source->refcount);
@@ -144,14 +158,14 @@ gint access_sib_unref(AccessSIB* source)
 
 	if (g_atomic_int_dec_and_test(&source->refcount) == FALSE)
 	{
-		whiteboard_log_debugc(WHITEBOARD_DEBUG_NODE,
+		whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_NODE,
 				    "AccessSIB %s (%s) refcount dec: %d\n",
 				    source->name, source->uuid,
 				    source->refcount);
 	}
 	else
 	{
-		whiteboard_log_debugc(WHITEBOARD_DEBUG_NODE,
+		whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_NODE,
 				    "AccessSIB %s (%s) refcount dec: %d\n",
 				    source->name, source->uuid,
 				    source->refcount);
@@ -178,8 +192,13 @@ void access_sib_destroy(AccessSIB* source)
 
 	g_free(source->name);
 	source->name = NULL;
+
+	access_sib_set_connection(source, NULL);
 	
-	g_list_free(source->joined_nodes);
+	g_hash_table_destroy(source->joined_nodes);
+	source->joined_nodes = NULL;
+
+	g_static_mutex_free(&source->lock);
 	
 	g_free(source);
 
@@ -228,6 +247,54 @@ gboolean access_sib_get_name(AccessSIB* source, gchar** name)
 	return TRUE;
 }
 
+/**
+ * Set the DBus connection of the SIB access process serving this SIB.
+ * A reference to the connection is held until it is replaced or cleared.
+ *
+ * @param source A AccessSIB instance
+ * @param conn DBusConnection of the SIB access process, NULL to clear
+ */
+void access_sib_set_connection(AccessSIB* source, DBusConnection* conn)
+{
+	DBusConnection *old = NULL;
+
+	g_return_if_fail(source != NULL);
+
+	if (conn != NULL)
+		dbus_connection_ref(conn);
+
+	g_static_mutex_lock(&source->lock);
+	old = source->connection;
+	source->connection = conn;
+	g_static_mutex_unlock(&source->lock);
+
+	if (old != NULL)
+		dbus_connection_unref(old);
+}
+
+/**
+ * Get the DBus connection of the SIB access process serving this SIB.
+ * The returned connection is referenced, unref it when done, as the SIB
+ * may be concurrently cleared and the DBusHandler drop its reference.
+ *
+ * @param source A AccessSIB instance
+ * @return DBusConnection or NULL if the SIB access process is not connected
+ */
+DBusConnection* access_sib_get_connection(AccessSIB* source)
+{
+	DBusConnection *conn = NULL;
+
+	g_return_val_if_fail(source != NULL, NULL);
+
+	g_static_mutex_lock(&source->lock);
+	conn = source->connection;
+	if (conn != NULL)
+		dbus_connection_ref(conn);
+	g_static_mutex_unlock(&source->lock);
+
+	return conn;
+}
+
 /**
  * Compare a AccessSIB with a access_sib id
  *
@@ -244,55 +311,99 @@ gint access_sib_compare_id(gconstpointer a, gconstpointer b)
 		return g_strcasecmp(((AccessSIB*)a)->uuid, (gchar*) b);
 }
 
-gint access_sib_compare_nodeid(gconstpointer a, gconstpointer b)
+/**
+ * Hash function for SIB and node UUIDs. UUIDs are compared
+ * case-insensitively, so the hash is computed over the lowercased string.
+ *
+ * @param key A UUID string
+ * @return hash value
+ */
+guint access_sib_uuid_hash(gconstpointer key)
 {
-	if (a == NULL)
-		return -1;
-	else if (b == NULL)
-		return 1;
-	else
-	  return g_strcasecmp( (gchar *)a, (gchar*) b);
+	const gchar *p = (const gchar *) key;
+	guint h = 5381;
+
+	for ( ; *p != '\0'; p++)
+		h = (h << 5) + h + (guchar) g_ascii_tolower(*p);
+
+	return h;
 }
 
+/**
+ * Case-insensitive equality for SIB and node UUIDs
+ *
+ * @param a A UUID string
+ * @param b A UUID string
+ * @return TRUE if the UUIDs are equal
+ */
+gboolean access_sib_uuid_equal(gconstpointer a, gconstpointer b)
+{
+	return g_ascii_strcasecmp((const gchar *) a, (const gchar *) b) == 0;
+}
+
+static void access_sib_collect_joined_node(gpointer key, gpointer value,
+					   gpointer user_data)
+{
+  GList **list = (GList **) user_data;
+  *list = g_list_prepend(*list, g_strdup((const gchar *) key));
+}
+
+/**
+ * Get the ids of the nodes joined to this SIB. The returned list and the
+ * ids in it are copies, free the ids with g_free and the list with
+ * g_list_free.
+ *
+ * @param self A AccessSIB instance
+ * @return newly allocated list of node ids
+ */
 GList *access_sib_get_joined_nodes( AccessSIB *self)
 {
+  GList *list = NULL;
   g_return_val_if_fail(self!=NULL,NULL);
-  return self->joined_nodes;
+  g_static_mutex_lock(&self->lock);
+  g_hash_table_foreach(self->joined_nodes, access_sib_collect_joined_node, &list);
+  g_static_mutex_unlock(&self->lock);
+  return list;
 }
 
 gboolean access_sib_is_node_joined( AccessSIB *node, const gchar *nodeid)
 {
-  GList *result = NULL;
+  gboolean result = FALSE;
   whiteboard_log_debug_fb();
-  result = g_list_find_custom(node->joined_nodes, nodeid, access_sib_compare_nodeid);
+  g_return_val_if_fail(node != NULL, FALSE);
+  g_return_val_if_fail(nodeid != NULL, FALSE);
+  g_static_mutex_lock(&node->lock);
+  result = g_hash_table_lookup_extended(node->joined_nodes, nodeid, NULL, NULL);
+  g_static_mutex_unlock(&node->lock);
   
   whiteboard_log_debug_fe();
-  return (result != NULL);
+  return result;
 }
 
 void access_sib_add_to_joined_nodes(  AccessSIB *node, gchar *nodeid)
 {
-  gchar *id=NULL;
   whiteboard_log_debug_fb();
-  if( FALSE == access_sib_is_node_joined(node, nodeid) )
+  g_return_if_fail(node != NULL);
+  g_return_if_fail(nodeid != NULL);
+  g_static_mutex_lock(&node->lock);
+  if( FALSE == g_hash_table_lookup_extended(node->joined_nodes, nodeid, NULL, NULL) )
     {
-      id=g_strdup(nodeid); 
-      node->joined_nodes = g_list_prepend( node->joined_nodes, id);
+      g_hash_table_insert(node->joined_nodes, g_strdup(nodeid), NULL);
     }
+  g_static_mutex_unlock(&node->lock);
   whiteboard_log_debug_fe();
 }
 
 void access_sib_remove_from_joined_nodes( AccessSIB *node, gchar *nodeid)
 {
-  GList *result = NULL;
+  gboolean removed = FALSE;
   whiteboard_log_debug_fb();
-  result = g_list_find_custom(node->joined_nodes, nodeid, access_sib_compare_nodeid);
-  if(result != NULL)
-    {
-      node->joined_nodes = g_list_remove_link(node->joined_nodes, result);
-      g_free(result->data);
-    }
-  else
+  g_return_if_fail(node != NULL);
+  g_return_if_fail(nodeid != NULL);
+  g_static_mutex_lock(&node->lock);
+  removed = g_hash_table_remove(node->joined_nodes, nodeid);
+  g_static_mutex_unlock(&node->lock);
+  if( FALSE == removed )
     {
       whiteboard_log_warning("Cannot find node to remove from joined_nodes list");
     }
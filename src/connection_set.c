@@ -0,0 +1,243 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard daemon.
+ *
+ * connection_set.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <glib.h>
+
+#define DBUS_API_SUBJECT_TO_CHANGE
+
+#include <dbus/dbus.h>
+#include <whiteboard_util.h>
+#include "whiteboard_daemon_log.h"
+
+#include "connection_set.h"
+
+struct _ConnectionSet
+{
+  GPtrArray *members;
+  GHashTable *index; // DBusConnection -> position in members + 1
+  ConnectionSnapshot *snapshot; // NULL if the set changed since
+  GStaticMutex lock;
+};
+
+struct _ConnectionSnapshot
+{
+  volatile gint ref_count;
+  GList *connections; // referenced
+};
+
+static void connection_set_invalidate(ConnectionSet *self);
+
+/*****************************************************************************
+ * Creation/destruction
+ *****************************************************************************/
+
+ConnectionSet *connection_set_new(void)
+{
+  ConnectionSet *self = NULL;
+
+  self = g_new0(ConnectionSet, 1);
+  self->members = g_ptr_array_new();
+  self->index = g_hash_table_new(g_direct_hash, g_direct_equal);
+  g_static_mutex_init(&self->lock);
+
+  return self;
+}
+
+void connection_set_destroy(ConnectionSet *self)
+{
+  g_return_if_fail(NULL != self);
+
+  connection_set_invalidate(self);
+  g_hash_table_destroy(self->index);
+  g_ptr_array_free(self->members, TRUE);
+  g_static_mutex_free(&self->lock);
+  g_free(self);
+}
+
+/*****************************************************************************
+ * Membership
+ *****************************************************************************/
+
+gboolean connection_set_add(ConnectionSet *self, DBusConnection *conn)
+{
+  gboolean retval = FALSE;
+
+  g_return_val_if_fail(NULL != self, FALSE);
+  g_return_val_if_fail(NULL != conn, FALSE);
+
+  g_static_mutex_lock(&self->lock);
+  if (g_hash_table_lookup(self->index, conn) == NULL)
+    {
+      g_ptr_array_add(self->members, conn);
+      g_hash_table_insert(self->index, conn,
+			  GUINT_TO_POINTER(self->members->len));
+      connection_set_invalidate(self);
+      retval = TRUE;
+    }
+  g_static_mutex_unlock(&self->lock);
+
+  return retval;
+}
+
+gboolean connection_set_remove(ConnectionSet *self, DBusConnection *conn)
+{
+  DBusConnection *last = NULL;
+  guint position = 0;
+
+  g_return_val_if_fail(NULL != self, FALSE);
+
+  g_static_mutex_lock(&self->lock);
+  position = GPOINTER_TO_UINT(g_hash_table_lookup(self->index, conn));
+  if (position == 0)
+    {
+      g_static_mutex_unlock(&self->lock);
+      return FALSE;
+    }
+  g_hash_table_remove(self->index, conn);
+
+  /* Move the last member into the hole */
+  last = g_ptr_array_index(self->members, self->members->len - 1);
+  g_ptr_array_remove_index_fast(self->members, position - 1);
+  if (last != conn)
+    g_hash_table_insert(self->index, last, GUINT_TO_POINTER(position));
+
+  connection_set_invalidate(self);
+  g_static_mutex_unlock(&self->lock);
+
+  return TRUE;
+}
+
+gboolean connection_set_contains(ConnectionSet *self, DBusConnection *conn)
+{
+  gboolean retval = FALSE;
+
+  g_return_val_if_fail(NULL != self, FALSE);
+
+  g_static_mutex_lock(&self->lock);
+  retval = (g_hash_table_lookup(self->index, conn) != NULL);
+  g_static_mutex_unlock(&self->lock);
+
+  return retval;
+}
+
+guint connection_set_size(ConnectionSet *self)
+{
+  guint size = 0;
+
+  g_return_val_if_fail(NULL != self, 0);
+
+  g_static_mutex_lock(&self->lock);
+  size = self->members->len;
+  g_static_mutex_unlock(&self->lock);
+
+  return size;
+}
+
+/*****************************************************************************
+ * Snapshots
+ *****************************************************************************/
+
+ConnectionSnapshot *connection_set_snapshot(ConnectionSet *self)
+{
+  ConnectionSnapshot *snapshot = NULL;
+  DBusConnection *conn = NULL;
+  guint i = 0;
+
+  g_return_val_if_fail(NULL != self, NULL);
+
+  g_static_mutex_lock(&self->lock);
+  if (self->snapshot == NULL)
+    {
+      snapshot = g_new0(ConnectionSnapshot, 1);
+      snapshot->ref_count = 1;
+
+      /* Closed connections are waiting for their disconnect to be
+	 handled, nothing would reach them */
+      for (i = self->members->len; i > 0; i--)
+	{
+	  conn = (DBusConnection *) g_ptr_array_index(self->members, i - 1);
+	  if (!dbus_connection_get_is_connected(conn))
+	    continue;
+
+	  snapshot->connections =
+	    g_list_prepend(snapshot->connections, dbus_connection_ref(conn));
+	}
+      self->snapshot = snapshot;
+    }
+
+  snapshot = self->snapshot;
+  g_atomic_int_inc(&snapshot->ref_count);
+  g_static_mutex_unlock(&self->lock);
+
+  return snapshot;
+}
+
+GList *connection_snapshot_get_list(ConnectionSnapshot *snapshot)
+{
+  g_return_val_if_fail(NULL != snapshot, NULL);
+
+  return snapshot->connections;
+}
+
+void connection_snapshot_unref(ConnectionSnapshot *snapshot)
+{
+  if (snapshot == NULL)
+    return;
+
+  if (g_atomic_int_dec_and_test(&snapshot->ref_count))
+    {
+      g_list_foreach(snapshot->connections,
+		     (GFunc) dbus_connection_unref, NULL);
+      g_list_free(snapshot->connections);
+      g_free(snapshot);
+    }
+}
+
+/* Call with the lock held */
+static void connection_set_invalidate(ConnectionSet *self)
+{
+  /* Readers holding the old snapshot keep it alive */
+  connection_snapshot_unref(self->snapshot);
+  self->snapshot = NULL;
+}
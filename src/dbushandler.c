@@ -45,6 +45,10 @@
 #include <glib.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
 
 #define DBUS_API_SUBJECT_TO_CHANGE
 
@@ -58,9 +62,10 @@
 #include <whiteboard_util.h>
 
 #include "whiteboard_sib_handler.h"
+#include "whiteboard_daemon_ifaces.h"
 #include "dbushandler.h"
 //#include "dbushandler_marshal.h"
-#include "whiteboard_log.h"
+#include "whiteboard_daemon_log.h"
 
 #if 0
 static GType server_object_get_type();
@@ -156,23 +161,78 @@ static gint server_register(ServerObject *self);
 </node> \n\
 "
 #endif
+
+/* Interfaces handled by dbushandler_handle_message */
+typedef enum
+{
+  DBUSHANDLER_INTERFACE_UNKNOWN = 0,
+  DBUSHANDLER_INTERFACE_NODE,
+  DBUSHANDLER_INTERFACE_SIB_ACCESS,
+  DBUSHANDLER_INTERFACE_DISCOVERY,
+  DBUSHANDLER_INTERFACE_REGISTER,
+  DBUSHANDLER_INTERFACE_GENERAL,
+  DBUSHANDLER_INTERFACE_LOG,
+  DBUSHANDLER_INTERFACE_DBUS,
+  DBUSHANDLER_INTERFACE_LOCAL,
+  DBUSHANDLER_INTERFACE_INTROSPECTABLE
+} DBusHandlerInterface;
+
 struct _DBusHandler
 {
-  GList *node_connections;
-  GList *control_connections;
-  GList *sib_connections;
-  GList *discovery_connections;
+  ConnectionSet *node_connections;
+  ConnectionSet *control_connections;
+  ConnectionSet *sib_connections;
+  ConnectionSet *discovery_connections;
   
   /* UUID -> dbus connection */
   GHashTable *connection_map;
 
-  /* access id -> node connection */
-  GHashTable *access_node_map;
-  /* access id -> sib connection */
-  GHashTable *access_sib_map;
+  /* access id -> node and sib connections */
+  AccessRouteTable *access_routes;
+  guint access_timeout;
+  guint access_sweep_id;
 
   /* subscription id -> ui connection */
   GHashTable *subscription_map;
+
+  /* interface name -> DBusHandlerInterface */
+  GHashTable *interface_map;
+
+  /* dbus connection -> ConnectionRecord */
+  GHashTable *connection_records;
+  guint access_ids_reclaimed;
+
+  volatile gint broadcasts_sent;
+  volatile gint broadcasts_skipped;
+
+  /* SIB access connection queue caps, 0 for none */
+  guint sib_queue_bytes;
+  guint sib_queue_requests;
+  guint sib_requests_refused;
+
+  /* Size of the shared memory rings offered to local SIB access
+     processes, 0 to offer none */
+  guint shm_ring_size;
+
+  /* "nodeid\nsibid", lowercased -> DirectChannel */
+  gboolean direct_channels_enabled;
+  GHashTable *direct_channels;
+
+  /* protects the connection lists and maps above, messages are
+     dispatched in several threads */
+  GStaticRecMutex lock;
+
+  /* I/O worker threads, a connection is dispatched by one of them */
+  guint worker_count;
+  GMainContext **worker_contexts;
+  GMainLoop **worker_loops;
+  GThread **workers;
+  volatile gint next_worker;
+
+  /* Round-robin dispatching of node and SIB access connections, one per
+     main context */
+  DispatchScheduler *scheduler;
+  DispatchScheduler **worker_schedulers;
   
   GMainLoop *loop;
   DBusConnection *session_bus;
@@ -184,13 +244,53 @@ struct _DBusHandler
   gpointer user_data_sib_handler;
   gpointer user_data_sib_registered;
   gpointer user_data_node_disconnected;
+  WhiteBoardAccessExpiredCB access_expired_cb;
+  gpointer user_data_access_expired;
+  WhiteBoardStatisticsCB statistics_cb;
+  gpointer user_data_statistics;
+  WhiteBoardDirectChannelCB direct_channel_cb;
+  gpointer user_data_direct_channel;
 };
 
-typedef struct _rmData
+/* Everything a connection registered, so that a disconnect is torn down
+   in time proportional to what the connection owned */
+typedef struct _ConnectionRecord
+{
+  GSList *uuids; // keys in connection_map, owned
+  GSList *subscriptions; // keys in subscription_map, owned
+  GHashTable *access_ids; // access ids routed through the connection
+  guint capabilities; // WHITEBOARD_NODE_CAPABILITY_* of a node,
+                      // WHITEBOARD_SIB_CAPABILITY_* of a SIB access process
+  GSList *channels; // DirectChannels the connection is an end of
+  guint pending; // access ids of a SIB access connection not yet answered
+  gboolean overloaded; // refusing requests until the queue drains
+  GMainContext *context; // dispatching the connection
+  ShmRing *from_sib; // shared memory ring of a local SIB access process
+} ConnectionRecord;
+
+/* Socket a node and a SIB access process talk over directly */
+typedef struct _DirectChannel
+{
+  gchar *key; // in direct_channels
+  gchar *sibid;
+  DBusConnection *node_connection; // not referenced, the channel is
+  DBusConnection *sib_connection;  // closed before either goes away
+  gint fd; // the daemon's copy of the node end, shut down to revoke
+} DirectChannel;
+
+/* Consumer of the ring a local SIB access process writes to */
+typedef struct _ShmRingEndpoint
+{
+  DBusHandler *dbus_handler;
+  DBusConnection *connection;
+} ShmRingEndpoint;
+
+/* Access id removed when its connection went away */
+typedef struct _ReclaimedAccessId
 {
-  gpointer value;
-  gpointer key;
-} rmData;
+  gint accessid;
+  AccessRoute route;
+} ReclaimedAccessId;
   
 /* Keep this preprocessor instruction always AFTER struct definitions
    and BEFORE any function declaration/prototype */
@@ -233,7 +333,53 @@ static int dbushandler_register_discovery(DBusHandler *self,
 
 static void dbushandler_handle_disconnect( DBusHandler *self, DBusConnection *conn);
 
-static gboolean dbushandler_compare_hashtable_value(gpointer _key, gpointer _value, gpointer _data);
+static GHashTable *dbushandler_create_interface_map(void);
+
+static gpointer dbushandler_worker_thread(gpointer data);
+
+static gboolean dbushandler_sweep_access_ids(gpointer data);
+
+static void dbushandler_access_id_expired(gint accessid,
+					  AccessRoute *route,
+					  gpointer data);
+
+static ConnectionRecord *dbushandler_get_record(DBusHandler *self,
+						DBusConnection *conn,
+						gboolean create);
+
+static void dbushandler_record_free(gpointer data);
+
+static GSList *dbushandler_record_remove_key(GSList *keys, const gchar *key);
+
+static void dbushandler_record_forget_access_id(DBusHandler *self,
+						gint accessid,
+						AccessRoute *route);
+
+static gchar *dbushandler_direct_channel_key(const gchar *nodeid,
+					     const gchar *sibid);
+
+static void dbushandler_direct_channel_close(DBusHandler *self,
+					     DirectChannel *channel);
+
+static void dbushandler_direct_channel_free(gpointer data);
+
+static void dbushandler_send_statistics(DBusHandler *self,
+					DBusConnection *conn,
+					DBusMessage *msg);
+
+static void dbushandler_get_dispatch_statistics(DBusHandler *self,
+						guint *turns,
+						guint *preempted);
+
+#ifdef SHM_RING_SUPPORTED
+static ShmRing *dbushandler_create_shm_ring(DBusHandler *self,
+					    DBusConnection *conn);
+
+static void dbushandler_shm_ring_cb(ShmRing *ring, const gchar *data,
+				    guint len, gpointer user_data);
+
+static void dbushandler_shm_ring_endpoint_free(gpointer data);
+#endif
 
 /* Public functions */
 
@@ -266,20 +412,35 @@ DBusHandler* dbushandler_new(gchar* local_address, GMainLoop* loop)
   
   self->loop = loop;
   g_main_loop_ref(loop);
+  self->scheduler = dispatch_scheduler_new(g_main_loop_get_context(loop),
+					   DISPATCH_SCHEDULER_DEFAULT_QUANTUM);
   
   self->local_address = g_strdup(local_address);
-  self->node_connections = NULL;
-  self->control_connections = NULL;
-  self->sib_connections = NULL;
+  self->node_connections = connection_set_new();
+  self->control_connections = connection_set_new();
+  self->sib_connections = connection_set_new();
+  self->discovery_connections = connection_set_new();
   
   self->connection_map = g_hash_table_new_full(g_str_hash, g_str_equal,
 					       g_free, NULL);
   
-  self->access_node_map = g_hash_table_new(g_direct_hash, g_direct_equal);
-  self->access_sib_map = g_hash_table_new(g_direct_hash,
-					  g_direct_equal);
+  self->access_routes = access_route_table_new(ACCESS_ROUTE_TABLE_DEFAULT_SIZE);
+  self->access_timeout = DBUSHANDLER_DEFAULT_ACCESS_TIMEOUT;
+  self->sib_queue_bytes = DBUSHANDLER_DEFAULT_SIB_QUEUE_BYTES;
+  self->sib_queue_requests = DBUSHANDLER_DEFAULT_SIB_QUEUE_REQUESTS;
+  self->access_sweep_id = g_timeout_add(ACCESS_ROUTE_TICK_MS,
+					dbushandler_sweep_access_ids, self);
   self->subscription_map = g_hash_table_new_full(g_str_hash, g_str_equal,
 						 g_free, NULL);
+  self->interface_map = dbushandler_create_interface_map();
+  self->connection_records = g_hash_table_new_full(g_direct_hash,
+						   g_direct_equal,
+						   NULL,
+						   dbushandler_record_free);
+  self->direct_channels = g_hash_table_new_full(g_str_hash, g_str_equal,
+						NULL,
+						dbushandler_direct_channel_free);
+  g_static_rec_mutex_init(&self->lock);
 	
   if (-1 == dbushandler_initialize(self))
     {
@@ -296,27 +457,93 @@ DBusHandler* dbushandler_new(gchar* local_address, GMainLoop* loop)
 
 void dbushandler_destroy(DBusHandler *self)
 {
+  guint i = 0;
+
   whiteboard_log_debug_fb();
 
   g_return_if_fail(NULL != self);
 
+  for (i = 0; i < self->worker_count; i++)
+    {
+      g_main_loop_quit(self->worker_loops[i]);
+      g_thread_join(self->workers[i]);
+      dispatch_scheduler_destroy(self->worker_schedulers[i]);
+      g_main_loop_unref(self->worker_loops[i]);
+      g_main_context_unref(self->worker_contexts[i]);
+    }
+  g_free(self->workers);
+  g_free(self->worker_loops);
+  g_free(self->worker_contexts);
+  g_free(self->worker_schedulers);
+  dispatch_scheduler_destroy(self->scheduler);
+
   g_main_loop_unref(self->loop);
 
   g_free(self->local_address);
 
   g_hash_table_destroy(self->connection_map);
-  g_hash_table_destroy(self->access_node_map);
-  g_hash_table_destroy(self->access_sib_map);
+  g_source_remove(self->access_sweep_id);
+  access_route_table_destroy(self->access_routes);
   g_hash_table_destroy(self->subscription_map);
-  g_list_free(self->node_connections);
-  g_list_free(self->control_connections);
-  g_list_free(self->sib_connections);
+  g_hash_table_destroy(self->interface_map);
+  g_hash_table_destroy(self->direct_channels);
+  g_hash_table_destroy(self->connection_records);
+  connection_set_destroy(self->node_connections);
+  connection_set_destroy(self->control_connections);
+  connection_set_destroy(self->sib_connections);
+  connection_set_destroy(self->discovery_connections);
+  g_static_rec_mutex_free(&self->lock);
 
 	
   g_free(self);
 
   whiteboard_log_debug_fe();
 }
+void dbushandler_start_workers(DBusHandler *self, guint count)
+{
+  guint i = 0;
+
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail(NULL != self);
+  g_return_if_fail(0 == self->worker_count);
+
+  if (count == 0)
+    return;
+
+  self->worker_contexts = g_new0(GMainContext *, count);
+  self->worker_loops = g_new0(GMainLoop *, count);
+  self->workers = g_new0(GThread *, count);
+  self->worker_schedulers = g_new0(DispatchScheduler *, count);
+
+  for (i = 0; i < count; i++)
+    {
+      self->worker_contexts[i] = g_main_context_new();
+      self->worker_schedulers[i] =
+	dispatch_scheduler_new(self->worker_contexts[i],
+			       DISPATCH_SCHEDULER_DEFAULT_QUANTUM);
+      self->worker_loops[i] = g_main_loop_new(self->worker_contexts[i],
+					      FALSE);
+      self->workers[i] = g_thread_create(dbushandler_worker_thread,
+					 self->worker_loops[i], TRUE, NULL);
+      if (self->workers[i] == NULL)
+	{
+	  whiteboard_log_error("Could not start dispatch thread %u\n", i);
+	  dispatch_scheduler_destroy(self->worker_schedulers[i]);
+	  g_main_loop_unref(self->worker_loops[i]);
+	  g_main_context_unref(self->worker_contexts[i]);
+	  break;
+	}
+    }
+  self->worker_count = i;
+
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
+			       "Started %u dispatch threads\n",
+			       self->worker_count);
+
+  whiteboard_log_debug_fe();
+}
+
 #if 0
 ServerObject *server_object_new(const gchar *path)
 {
@@ -519,32 +746,399 @@ void dbushandler_set_callback_node_disconnected(DBusHandler *self,
   self->user_data_node_disconnected = user_data;
 }
 
-GList *dbushandler_get_node_connections(DBusHandler *self)
+void dbushandler_set_callback_access_expired(DBusHandler *self,
+					     WhiteBoardAccessExpiredCB cb,
+					     gpointer user_data)
+{
+  g_return_if_fail(NULL != self);
+  g_return_if_fail(NULL != cb);
+
+  self->access_expired_cb = cb;
+  self->user_data_access_expired = user_data;
+}
+
+void dbushandler_set_callback_direct_channel(DBusHandler *self,
+					     WhiteBoardDirectChannelCB cb,
+					     gpointer user_data)
+{
+  g_return_if_fail(NULL != self);
+  g_return_if_fail(NULL != cb);
+
+  self->direct_channel_cb = cb;
+  self->user_data_direct_channel = user_data;
+}
+
+void dbushandler_set_callback_statistics(DBusHandler *self,
+					 WhiteBoardStatisticsCB cb,
+					 gpointer user_data)
+{
+  g_return_if_fail(NULL != self);
+  g_return_if_fail(NULL != cb);
+
+  self->statistics_cb = cb;
+  self->user_data_statistics = user_data;
+}
+
+void dbushandler_set_access_timeout(DBusHandler *self, guint timeout_ms)
+{
+  g_return_if_fail(NULL != self);
+
+  self->access_timeout = timeout_ms;
+}
+
+guint dbushandler_get_access_timeout(DBusHandler *self)
+{
+  g_return_val_if_fail(NULL != self, 0);
+
+  return self->access_timeout;
+}
+
+void dbushandler_set_shm_ring_size(DBusHandler *self, guint size)
+{
+  g_return_if_fail(NULL != self);
+
+  g_static_rec_mutex_lock(&self->lock);
+  self->shm_ring_size = size;
+  g_static_rec_mutex_unlock(&self->lock);
+}
+
+void dbushandler_set_direct_channels(DBusHandler *self, gboolean enabled)
+{
+  g_return_if_fail(NULL != self);
+
+  g_static_rec_mutex_lock(&self->lock);
+  self->direct_channels_enabled = enabled;
+  g_static_rec_mutex_unlock(&self->lock);
+}
+
+gboolean dbushandler_open_direct_channel(DBusHandler *self,
+					 DBusConnection *node_conn,
+					 DBusConnection *sib_conn,
+					 const gchar *nodeid,
+					 const gchar *sibid)
 {
+#ifdef HAVE_DBUS_UNIX_FD
+  ConnectionRecord *node_record = NULL;
+  ConnectionRecord *sib_record = NULL;
+  DirectChannel *channel = NULL;
+  DBusMessage *node_signal = NULL;
+  DBusMessage *sib_signal = NULL;
+  gint fds[2];
+  gboolean retval = FALSE;
+
+  g_return_val_if_fail(NULL != self, FALSE);
+  g_return_val_if_fail(NULL != node_conn, FALSE);
+  g_return_val_if_fail(NULL != sib_conn, FALSE);
+  g_return_val_if_fail(NULL != nodeid, FALSE);
+  g_return_val_if_fail(NULL != sibid, FALSE);
+
+  if (!self->direct_channels_enabled ||
+      !dbus_connection_can_send_type(node_conn, DBUS_TYPE_UNIX_FD) ||
+      !dbus_connection_can_send_type(sib_conn, DBUS_TYPE_UNIX_FD))
+    return FALSE;
+
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+    {
+      whiteboard_log_warning("Could not create direct channel: %s\n",
+			     strerror(errno));
+      return FALSE;
+    }
+
+  node_signal = dbus_message_new_signal(WHITEBOARD_DBUS_OBJECT,
+					WHITEBOARD_DBUS_NODE_INTERFACE,
+					WHITEBOARD_DBUS_NODE_SIGNAL_DIRECT_CHANNEL);
+  sib_signal = dbus_message_new_signal(WHITEBOARD_DBUS_OBJECT,
+				       WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+				       WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_DIRECT_CHANNEL);
+
+  /* The signals hold their own duplicates of the ends */
+  if (node_signal != NULL && sib_signal != NULL &&
+      dbus_message_append_args(node_signal,
+			       DBUS_TYPE_STRING, &sibid,
+			       DBUS_TYPE_UNIX_FD, &fds[0],
+			       DBUS_TYPE_INVALID) &&
+      dbus_message_append_args(sib_signal,
+			       DBUS_TYPE_STRING, &nodeid,
+			       DBUS_TYPE_UNIX_FD, &fds[1],
+			       DBUS_TYPE_INVALID))
+    {
+      g_static_rec_mutex_lock(&self->lock);
+      node_record = dbushandler_get_record(self, node_conn, FALSE);
+      sib_record = dbushandler_get_record(self, sib_conn, FALSE);
+
+      if (node_record != NULL && sib_record != NULL &&
+	  (node_record->capabilities & WHITEBOARD_NODE_CAPABILITY_DIRECT_CHANNEL) &&
+	  (sib_record->capabilities & WHITEBOARD_SIB_CAPABILITY_DIRECT_CHANNEL))
+	{
+	  channel = g_new0(DirectChannel, 1);
+	  channel->key = dbushandler_direct_channel_key(nodeid, sibid);
+	  channel->sibid = g_strdup(sibid);
+	  channel->node_connection = node_conn;
+	  channel->sib_connection = sib_conn;
+	  channel->fd = fds[0];
+
+	  /* A node joining the same SIB again gets a fresh channel */
+	  dbushandler_direct_channel_close(self,
+					   g_hash_table_lookup(self->direct_channels,
+							       channel->key));
+	  g_hash_table_insert(self->direct_channels, channel->key, channel);
+	  node_record->channels = g_slist_prepend(node_record->channels, channel);
+	  sib_record->channels = g_slist_prepend(sib_record->channels, channel);
+	  if (self->direct_channel_cb != NULL)
+	    self->direct_channel_cb(self, sibid, self->user_data_direct_channel);
+	  retval = TRUE;
+	}
+      g_static_rec_mutex_unlock(&self->lock);
+    }
+  else
+    {
+      whiteboard_log_error("Out of memory\n");
+    }
+
+  if (retval)
+    {
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
+				   "Direct channel between node %s and SIB %s\n",
+				   nodeid, sibid);
+      /* The SIB end first, so that it is listening when the node writes */
+      dbus_connection_send(sib_conn, sib_signal, NULL);
+      dbus_connection_send(node_conn, node_signal, NULL);
+    }
+  else
+    {
+      close(fds[0]);
+    }
+  /* The SIB end lives on in sib_signal, shutting the node end is enough */
+  close(fds[1]);
+
+  if (node_signal != NULL)
+    dbus_message_unref(node_signal);
+  if (sib_signal != NULL)
+    dbus_message_unref(sib_signal);
+
+  return retval;
+#else
+  return FALSE;
+#endif
+}
+
+void dbushandler_close_direct_channel(DBusHandler *self,
+				      const gchar *nodeid,
+				      const gchar *sibid)
+{
+  gchar *key = NULL;
+
+  g_return_if_fail(NULL != self);
+  g_return_if_fail(NULL != nodeid);
+  g_return_if_fail(NULL != sibid);
+
+  key = dbushandler_direct_channel_key(nodeid, sibid);
+  g_static_rec_mutex_lock(&self->lock);
+  dbushandler_direct_channel_close(self,
+				   g_hash_table_lookup(self->direct_channels, key));
+  g_static_rec_mutex_unlock(&self->lock);
+  g_free(key);
+}
+
+gboolean dbushandler_sib_has_direct_channels(DBusHandler *self,
+					     DBusConnection *sib_conn)
+{
+  ConnectionRecord *record = NULL;
+  gboolean retval = FALSE;
+
+  g_return_val_if_fail(NULL != self, FALSE);
+  g_return_val_if_fail(NULL != sib_conn, FALSE);
+
+  g_static_rec_mutex_lock(&self->lock);
+  record = dbushandler_get_record(self, sib_conn, FALSE);
+  if (record != NULL)
+    retval = (record->channels != NULL);
+  g_static_rec_mutex_unlock(&self->lock);
+
+  return retval;
+}
+
+void dbushandler_set_sib_queue_limits(DBusHandler *self,
+				      guint max_bytes,
+				      guint max_requests)
+{
+  g_return_if_fail(NULL != self);
+
+  g_static_rec_mutex_lock(&self->lock);
+  self->sib_queue_bytes = max_bytes;
+  self->sib_queue_requests = max_requests;
+  g_static_rec_mutex_unlock(&self->lock);
+}
+
+gboolean dbushandler_sib_can_send(DBusHandler *self,
+				  DBusConnection *sib_conn)
+{
+  ConnectionRecord *record = NULL;
+  guint bytes = 0;
+  gboolean full = FALSE;
+  gboolean drained = FALSE;
+  gboolean retval = TRUE;
+
+  g_return_val_if_fail(NULL != self, FALSE);
+  g_return_val_if_fail(NULL != sib_conn, FALSE);
+
+#ifdef HAVE_DBUS_CONNECTION_GET_OUTGOING_SIZE
+  bytes = dbus_connection_get_outgoing_size(sib_conn);
+#endif
+
+  g_static_rec_mutex_lock(&self->lock);
+  record = dbushandler_get_record(self, sib_conn, FALSE);
+  if (record != NULL)
+    {
+      full = ((self->sib_queue_bytes > 0 &&
+	       bytes >= self->sib_queue_bytes) ||
+	      (self->sib_queue_requests > 0 &&
+	       record->pending >= self->sib_queue_requests));
+      drained = ((self->sib_queue_bytes == 0 ||
+		  bytes <= (guint64) self->sib_queue_bytes *
+		  DBUSHANDLER_SIB_QUEUE_LOW_PERCENT / 100) &&
+		 (self->sib_queue_requests == 0 ||
+		  record->pending <= (guint64) self->sib_queue_requests *
+		  DBUSHANDLER_SIB_QUEUE_LOW_PERCENT / 100));
+
+      if (!record->overloaded && full)
+	{
+	  record->overloaded = TRUE;
+	  whiteboard_log_warning("SIB access %p overloaded, %u bytes and "
+				 "%u requests queued\n",
+				 sib_conn, bytes, record->pending);
+	}
+      else if (record->overloaded && drained)
+	{
+	  record->overloaded = FALSE;
+	  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
+				       "SIB access %p accepting requests\n",
+				       sib_conn);
+	}
+
+      if (record->overloaded)
+	{
+	  self->sib_requests_refused++;
+	  retval = FALSE;
+	}
+    }
+  g_static_rec_mutex_unlock(&self->lock);
+
+  return retval;
+}
+
+ConnectionSnapshot *dbushandler_get_node_connections(DBusHandler *self)
+{
+  g_return_val_if_fail(NULL != self, NULL);
+
+  return connection_set_snapshot(self->node_connections);
+}
+
+guint dbushandler_get_node_capabilities(DBusHandler *self,
+					DBusConnection *conn)
+{
+  ConnectionRecord *record = NULL;
+  guint capabilities = WHITEBOARD_NODE_CAPABILITY_NONE;
+
+  g_return_val_if_fail(NULL != self, WHITEBOARD_NODE_CAPABILITY_NONE);
+
+  g_static_rec_mutex_lock(&self->lock);
+  record = dbushandler_get_record(self, conn, FALSE);
+  if (record != NULL)
+    capabilities = record->capabilities;
+  g_static_rec_mutex_unlock(&self->lock);
+
+  return capabilities;
+}
+
+GSList *dbushandler_get_connection_uuids(DBusHandler *self,
+					 DBusConnection *conn)
+{
+  ConnectionRecord *record = NULL;
+  GSList *link = NULL;
+  GSList *uuids = NULL;
+
   g_return_val_if_fail(NULL != self, NULL);
 
-  return self->node_connections;
+  g_static_rec_mutex_lock(&self->lock);
+  record = dbushandler_get_record(self, conn, FALSE);
+  if (record != NULL)
+    {
+      for (link = record->uuids; link != NULL; link = link->next)
+	uuids = g_slist_prepend(uuids, g_strdup((gchar *) link->data));
+    }
+  g_static_rec_mutex_unlock(&self->lock);
+
+  return uuids;
 }
 
-GList *dbushandler_get_control_connections(DBusHandler *self)
+ConnectionSnapshot *dbushandler_get_control_connections(DBusHandler *self)
 {
   g_return_val_if_fail(NULL != self, NULL);
 
-  return self->control_connections;
+  return connection_set_snapshot(self->control_connections);
 }
 
-GList *dbushandler_get_sib_connections(DBusHandler *self)
+ConnectionSnapshot *dbushandler_get_sib_connections(DBusHandler *self)
 {
   g_return_val_if_fail(NULL != self, NULL);
 
-  return self->sib_connections;
+  return connection_set_snapshot(self->sib_connections);
 }
 
-GList *dbushandler_get_discovery_connections(DBusHandler *self)
+ConnectionSnapshot *dbushandler_get_discovery_connections(DBusHandler *self)
 {
   g_return_val_if_fail(NULL != self, NULL);
 
-  return self->discovery_connections;
+  return connection_set_snapshot(self->discovery_connections);
+}
+
+guint dbushandler_broadcast(DBusHandler *self,
+			    ConnectionSnapshot *connections,
+			    DBusMessage *msg)
+{
+  DBusConnection *conn = NULL;
+  GList *link = NULL;
+  guint sent = 0;
+  guint skipped = 0;
+
+  g_return_val_if_fail(NULL != self, 0);
+  g_return_val_if_fail(NULL != connections, 0);
+  g_return_val_if_fail(NULL != msg, 0);
+
+  /* The first send assigns the serial and locks the message, after that
+     every queue just takes a reference to the same marshalled message */
+  for (link = connection_snapshot_get_list(connections);
+       link != NULL;
+       link = link->next)
+    {
+      conn = (DBusConnection *) link->data;
+
+#ifdef HAVE_DBUS_CONNECTION_GET_OUTGOING_SIZE
+      if (dbus_connection_get_outgoing_size(conn) >
+	  DBUSHANDLER_BROADCAST_MAX_OUTGOING)
+	{
+	  skipped++;
+	  continue;
+	}
+#endif
+
+      if (dbus_connection_send(conn, msg, NULL))
+	sent++;
+      else
+	skipped++;
+    }
+
+  g_atomic_int_add(&self->broadcasts_sent, sent);
+  if (skipped > 0)
+    {
+      g_atomic_int_add(&self->broadcasts_skipped, skipped);
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
+				   "Broadcast skipped %u slow connections\n",
+				   skipped);
+    }
+
+  return sent;
 }
 
 DBusConnection *dbushandler_get_session_bus(DBusHandler *self)
@@ -562,12 +1156,30 @@ static int dbushandler_register_node(DBusHandler *self, DBusConnection *conn,
   gchar* registered_uuid = NULL;
   gchar* unique_name = NULL;
   gint status = -1;
+  DBusMessageIter iter;
+  dbus_uint32_t capabilities = WHITEBOARD_NODE_CAPABILITY_NONE;
   whiteboard_log_debug_fb();
 
   /* TODO: browse_id -> unique_id? -> util? */
 
   whiteboard_util_parse_message(msg, DBUS_TYPE_STRING, &registered_uuid,
 				DBUS_TYPE_INVALID);
+
+  /* Newer nodes append their capabilities after the uuid */
+  if (dbus_message_iter_init(msg, &iter) &&
+      dbus_message_iter_next(&iter) &&
+      dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_UINT32)
+    {
+      dbus_message_iter_get_basic(&iter, &capabilities);
+    }
+
+  g_static_rec_mutex_lock(&self->lock);
+  dbushandler_get_record(self, conn, TRUE)->capabilities = capabilities;
+  g_static_rec_mutex_unlock(&self->lock);
+
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
+			       "Node %s capabilities: 0x%x\n",
+			       registered_uuid, capabilities);
   unique_name = g_strdup_printf(":%d", whiteboard_sib_handler_get_access_id());
   whiteboard_log_debug("Setting unique name %s for ui connection: %s\n", registered_uuid, unique_name);
   
@@ -578,7 +1190,7 @@ static int dbushandler_register_node(DBusHandler *self, DBusConnection *conn,
 
   g_free(unique_name);
 
-  self->node_connections = g_list_prepend(self->node_connections, conn);
+  connection_set_add(self->node_connections, conn);
 
   status = 0;
   whiteboard_util_send_method_return(conn, msg,
@@ -607,7 +1219,7 @@ static int dbushandler_unregister_node(DBusHandler *self, DBusConnection *conn,
   
   if( dbushandler_remove_connection_by_uuid(self, uuid))
     {
-      whiteboard_log_debugc(WHITEBOARD_DEBUG_DBUS, "Node connection w/ uuid: %s removed\n", uuid);
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS, "Node connection w/ uuid: %s removed\n", uuid);
     }
 
   whiteboard_log_debug_fe();
@@ -635,8 +1247,7 @@ static int dbushandler_register_control(DBusHandler *self, DBusConnection *conn,
   dbus_bus_set_unique_name(conn, unique_name); 
   g_free(unique_name);
 
-  self->control_connections = g_list_prepend(self->control_connections,
-					     conn);
+  connection_set_add(self->control_connections, conn);
 
 
   status = 0;
@@ -659,6 +1270,14 @@ static int dbushandler_register_sib(DBusHandler *self,
   gboolean local = FALSE;
   gchar* unique_name = NULL;
   gint status = -1;
+  DBusMessageIter iter;
+  dbus_uint32_t capabilities = WHITEBOARD_SIB_CAPABILITY_NONE;
+  guint i = 0;
+#ifdef SHM_RING_SUPPORTED
+  DBusMessage *reply = NULL;
+  ShmRing *from_sib = NULL;
+  gint fds[2];
+#endif
   whiteboard_log_debug_fb();
   unique_name = g_strdup_printf(":%d", whiteboard_sib_handler_get_access_id());
   whiteboard_log_debug("Setting unique name for node connection: %s\n", unique_name);
@@ -669,6 +1288,20 @@ static int dbushandler_register_sib(DBusHandler *self,
 				DBUS_TYPE_STRING, &mimetypes, // Not used for sources
 				DBUS_TYPE_BOOLEAN, &local,
 				DBUS_TYPE_INVALID);
+
+  /* Newer SIB access processes append their capabilities after local */
+  if (dbus_message_iter_init(msg, &iter))
+    {
+      for (i = 0; i < 4; i++)
+	if (!dbus_message_iter_next(&iter))
+	  break;
+      if (i == 4 && dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_UINT32)
+	dbus_message_iter_get_basic(&iter, &capabilities);
+    }
+
+  g_static_rec_mutex_lock(&self->lock);
+  dbushandler_get_record(self, conn, TRUE)->capabilities = capabilities;
+  g_static_rec_mutex_unlock(&self->lock);
 	
   whiteboard_log_debug("Registered uuid: %s\n", registered_uuid);
 
@@ -677,15 +1310,45 @@ static int dbushandler_register_sib(DBusHandler *self,
   dbus_bus_set_unique_name(conn, unique_name); 
   g_free(unique_name);
 
-  self->sib_connections = g_list_prepend(self->sib_connections, conn);
+  connection_set_add(self->sib_connections, conn);
 
   /* TODO: Pass local variable to callback */
   self->sib_registered_cb(self, 
+			  conn,
 			  registered_uuid,
 			  friendly_name,
 			  self->user_data_sib_registered);
 
   status = 0;
+#ifdef SHM_RING_SUPPORTED
+  if (local && (capabilities & WHITEBOARD_SIB_CAPABILITY_SHM_RING) &&
+      (from_sib = dbushandler_create_shm_ring(self, conn)) != NULL)
+    {
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
+				   "SIB %s uses a shared memory ring\n",
+				   registered_uuid);
+      fds[0] = shm_ring_get_fd(from_sib);
+      fds[1] = shm_ring_get_event_fd(from_sib);
+
+      reply = dbus_message_new_method_return(msg);
+      if (reply != NULL &&
+	  dbus_message_append_args(reply,
+				   DBUS_TYPE_INT32, &status,
+				   DBUS_TYPE_UNIX_FD, &fds[0],
+				   DBUS_TYPE_UNIX_FD, &fds[1],
+				   DBUS_TYPE_INVALID))
+	dbus_connection_send(conn, reply, NULL);
+      else
+	whiteboard_log_error("Out of memory\n");
+
+      if (reply != NULL)
+	dbus_message_unref(reply);
+
+      whiteboard_log_debug_fe();
+
+      return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+#endif
   whiteboard_util_send_method_return(conn, msg,
 				     DBUS_TYPE_INT32, &status,
 				     WHITEBOARD_UTIL_LIST_END);
@@ -696,6 +1359,107 @@ static int dbushandler_register_sib(DBusHandler *self,
   return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+#ifdef SHM_RING_SUPPORTED
+/**
+ * Create the shared memory ring a local SIB access process writes to and
+ * start consuming it. Requests to the SIB access process stay on the
+ * connection, a second channel would let them overtake each other. The
+ * ring is owned by the connection record and goes away with the
+ * connection.
+ *
+ * @param self DBusHandler instance
+ * @param conn Connection of the SIB access process
+ * @return The ring, owned by the record, or NULL
+ */
+static ShmRing *dbushandler_create_shm_ring(DBusHandler *self,
+					    DBusConnection *conn)
+{
+  ConnectionRecord *record = NULL;
+  ShmRingEndpoint *endpoint = NULL;
+  GMainContext *context = NULL;
+  ShmRing *from_sib = NULL;
+
+  if (self->shm_ring_size == 0 ||
+      !dbus_connection_can_send_type(conn, DBUS_TYPE_UNIX_FD))
+    return NULL;
+
+  from_sib = shm_ring_new(self->shm_ring_size);
+  if (from_sib == NULL)
+    return NULL;
+
+  endpoint = g_new0(ShmRingEndpoint, 1);
+  endpoint->dbus_handler = self;
+  endpoint->connection = dbus_connection_ref(conn);
+
+  g_static_rec_mutex_lock(&self->lock);
+  record = dbushandler_get_record(self, conn, TRUE);
+
+  /* A re-registering SIB access process gets a new ring */
+  if (record->from_sib != NULL)
+    {
+      shm_ring_detach_consumer(record->from_sib);
+      shm_ring_unref(record->from_sib);
+    }
+  record->from_sib = from_sib;
+
+  /* Ring messages are handled by the thread handling the connection */
+  context = (record->context != NULL) ? record->context :
+    g_main_loop_get_context(self->loop);
+  shm_ring_attach_consumer(from_sib, context, dbushandler_shm_ring_cb,
+			   endpoint, dbushandler_shm_ring_endpoint_free);
+  g_static_rec_mutex_unlock(&self->lock);
+
+  return from_sib;
+}
+
+static void dbushandler_shm_ring_cb(ShmRing *ring, const gchar *data,
+				    guint len, gpointer user_data)
+{
+  ShmRingEndpoint *endpoint = (ShmRingEndpoint *) user_data;
+  DBusMessage *msg = NULL;
+  DBusError err;
+
+  dbus_error_init(&err);
+  msg = dbus_message_demarshal(data, (int) len, &err);
+  if (msg == NULL)
+    {
+      whiteboard_log_warning("Invalid message in shared memory ring: %s\n",
+			     err.message);
+      dbus_error_free(&err);
+      return;
+    }
+
+  /* The ring carries signals and the results the SIB access process
+     sends as method returns, neither expects a reply. A method call
+     would be answered on the connection, out of order with the ring. */
+  if (!dbus_message_get_no_reply(msg) ||
+      (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_SIGNAL &&
+       dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_METHOD_RETURN))
+    {
+      whiteboard_log_warning("Dropping %s %s from shared memory ring, "
+			     "only messages without a reply are allowed\n",
+			     dbus_message_type_to_string(dbus_message_get_type(msg)),
+			     dbus_message_get_member(msg) ?
+			     dbus_message_get_member(msg) : "");
+      dbus_message_unref(msg);
+      return;
+    }
+
+  /* Same path as the messages read from the connection */
+  dbushandler_handle_message(endpoint->connection, msg,
+			     endpoint->dbus_handler);
+  dbus_message_unref(msg);
+}
+
+static void dbushandler_shm_ring_endpoint_free(gpointer data)
+{
+  ShmRingEndpoint *endpoint = (ShmRingEndpoint *) data;
+
+  dbus_connection_unref(endpoint->connection);
+  g_free(endpoint);
+}
+#endif
+
 static int dbushandler_register_discovery(DBusHandler *self,
 					  DBusConnection *conn,
 					  DBusMessage *msg)
@@ -719,7 +1483,7 @@ static int dbushandler_register_discovery(DBusHandler *self,
 
   g_free(unique_name);
 
-  self->discovery_connections = g_list_prepend(self->discovery_connections, conn);
+  connection_set_add(self->discovery_connections, conn);
 
   status = 0;
   whiteboard_util_send_method_return(conn, msg,
@@ -910,6 +1674,9 @@ static void dbushandler_handle_connection(DBusServer *server,
 					  gpointer data)
 {
   DBusHandler *self = (DBusHandler *) data;
+  DispatchScheduler *scheduler = NULL;
+  GMainContext *context = NULL;
+  guint worker = 0;
 
   whiteboard_log_debug_fb();
 
@@ -921,8 +1688,28 @@ static void dbushandler_handle_connection(DBusServer *server,
   g_return_if_fail(NULL != self);
 
   dbus_connection_add_filter(conn, &dbushandler_handle_message, data, NULL);
-  dbus_connection_setup_with_g_main(conn,
-				    g_main_loop_get_context(self->loop));
+
+  /* All messages of a connection are dispatched by the same thread, so
+     they are handled in order */
+  if (self->worker_count > 0)
+    {
+      worker = (guint) g_atomic_int_exchange_and_add(&self->next_worker, 1);
+      scheduler = self->worker_schedulers[worker % self->worker_count];
+      context = self->worker_contexts[worker % self->worker_count];
+    }
+  else
+    {
+      scheduler = self->scheduler;
+      context = g_main_loop_get_context(self->loop);
+    }
+
+  g_static_rec_mutex_lock(&self->lock);
+  dbushandler_get_record(self, conn, TRUE)->context = context;
+  g_static_rec_mutex_unlock(&self->lock);
+
+  /* A busy connection dispatches a few messages at a time and then
+     waits for the other ready connections */
+  dispatch_scheduler_add_connection(scheduler, conn);
 
   whiteboard_log_debug_fe();
 }
@@ -1040,6 +1827,10 @@ static DBusHandlerResult dbushandler_whiteboard_general_message(
 					     WHITEBOARD_UTIL_LIST_END);
 	  g_string_free(address,FALSE);
 	}
+      else if (!strcmp(member, WHITEBOARD_DBUS_METHOD_GET_STATISTICS))
+	{
+	  dbushandler_send_statistics(self, conn, msg);
+	}
       else if (!strcmp(member, WHITEBOARD_METHOD_CUSTOM_COMMAND))
 	{
 	  whiteboard_log_debug("Custom command request.\n");
@@ -1302,36 +2093,137 @@ static DBusHandlerResult dbushandler_org_freedesktop_dbus_introspectable( DBusHa
 static void dbushandler_handle_disconnect( DBusHandler* self,
 					   DBusConnection* conn)
 {
+  ConnectionRecord *record = NULL;
+  GSList *uuids = NULL;
+  GSList *link = NULL;
+  GArray *reclaimed = NULL;
+  ReclaimedAccessId entry;
+  GList *ids = NULL;
+  GList *id = NULL;
+  guint i = 0;
+
   whiteboard_log_debug_fb();
-  // Assume that it was a node connection that left
-  // TODO: apply also for SIB access
-  rmData *rm = NULL;
-  gchar *nodeid = NULL;
-  rm = g_new0(rmData,1);
-  rm->value = conn;
-  
-  while( g_hash_table_find(self->connection_map, dbushandler_compare_hashtable_value, rm ) )
+
+  connection_set_remove(self->node_connections, conn);
+  connection_set_remove(self->control_connections, conn);
+  connection_set_remove(self->sib_connections, conn);
+  connection_set_remove(self->discovery_connections, conn);
+
+  g_static_rec_mutex_lock(&self->lock);
+  record = dbushandler_get_record(self, conn, FALSE);
+  if (record == NULL)
     {
-      nodeid = g_strdup((gchar *)rm->key);
-      self->node_disconnected_cb(self, nodeid, self->user_data_node_disconnected);
-      
-      dbushandler_remove_connection_by_uuid(self, nodeid);
-      
-      g_free(nodeid);
+      g_static_rec_mutex_unlock(&self->lock);
+      whiteboard_log_debug_fe();
+      return;
+    }
+
+  /* Revoke the direct channels while both records are still there */
+  while (record->channels != NULL)
+    dbushandler_direct_channel_close(self,
+				     (DirectChannel *) record->channels->data);
+
+  g_hash_table_steal(self->connection_records, conn);
+
+  /* UUIDs still pointing at this connection */
+  for (link = record->uuids; link != NULL; link = link->next)
+    {
+      if (g_hash_table_lookup(self->connection_map, link->data) == conn)
+	{
+	  g_hash_table_remove(self->connection_map, link->data);
+	  uuids = g_slist_prepend(uuids, link->data);
+	  link->data = NULL;
+	}
+    }
+
+  for (link = record->subscriptions; link != NULL; link = link->next)
+    {
+      if (g_hash_table_lookup(self->subscription_map, link->data) == conn)
+	g_hash_table_remove(self->subscription_map, link->data);
     }
-  g_free(rm);
+
+  /* Fail the operations still pending on this connection */
+  reclaimed = g_array_new(FALSE, FALSE, sizeof(ReclaimedAccessId));
+  ids = g_hash_table_get_keys(record->access_ids);
+  for (id = ids; id != NULL; id = id->next)
+    {
+      entry.accessid = GPOINTER_TO_INT(id->data);
+      if (!access_route_table_lookup(self->access_routes, entry.accessid,
+				     &entry.route) ||
+	  !access_route_table_remove(self->access_routes, entry.accessid))
+	continue;
+
+      /* The other end of the route keeps no stale id */
+      dbushandler_record_forget_access_id(self, entry.accessid, &entry.route);
+
+      /* Nobody to tell if the node itself went away */
+      if (entry.route.node_connection == conn)
+	entry.route.node_connection = NULL;
+      g_array_append_val(reclaimed, entry);
+    }
+  g_list_free(ids);
+  self->access_ids_reclaimed += reclaimed->len;
+  g_static_rec_mutex_unlock(&self->lock);
+
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
+			       "Connection %p gone, %u uuids, %u access ids\n",
+			       conn, g_slist_length(uuids), reclaimed->len);
+
+  /* The callbacks take the SIB handler lock, don't hold ours */
+  for (link = uuids; link != NULL; link = link->next)
+    {
+      self->node_disconnected_cb(self, (gchar *) link->data,
+				 self->user_data_node_disconnected);
+      g_free(link->data);
+    }
+  g_slist_free(uuids);
+
+  for (i = 0; i < reclaimed->len; i++)
+    {
+      ReclaimedAccessId *e = &g_array_index(reclaimed, ReclaimedAccessId, i);
+
+      if (self->access_expired_cb != NULL)
+	self->access_expired_cb(self, e->accessid, &e->route,
+				self->user_data_access_expired);
+    }
+  g_array_free(reclaimed, TRUE);
+
+  dbushandler_record_free(record);
   whiteboard_log_debug_fe(); 
 }
-static gboolean dbushandler_compare_hashtable_value(gpointer _key, gpointer _value, gpointer _data)
+
+/**
+ * Build the interface name -> DBusHandlerInterface table used to classify
+ * incoming messages.
+ *
+ * @return new hash table
+ */
+static GHashTable *dbushandler_create_interface_map(void)
 {
-  rmData *rm = (rmData *)_data;
-  g_return_val_if_fail(rm != NULL, FALSE);
-  if( _value == rm->value)
-    {
-      rm->key = _key;
-      return TRUE;
-    }
-  return FALSE;
+  GHashTable *map = NULL;
+
+  map = g_hash_table_new(g_str_hash, g_str_equal);
+
+  g_hash_table_insert(map, WHITEBOARD_DBUS_NODE_INTERFACE,
+		      GINT_TO_POINTER(DBUSHANDLER_INTERFACE_NODE));
+  g_hash_table_insert(map, WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+		      GINT_TO_POINTER(DBUSHANDLER_INTERFACE_SIB_ACCESS));
+  g_hash_table_insert(map, WHITEBOARD_DBUS_DISCOVERY_INTERFACE,
+		      GINT_TO_POINTER(DBUSHANDLER_INTERFACE_DISCOVERY));
+  g_hash_table_insert(map, WHITEBOARD_DBUS_REGISTER_INTERFACE,
+		      GINT_TO_POINTER(DBUSHANDLER_INTERFACE_REGISTER));
+  g_hash_table_insert(map, WHITEBOARD_DBUS_INTERFACE,
+		      GINT_TO_POINTER(DBUSHANDLER_INTERFACE_GENERAL));
+  g_hash_table_insert(map, WHITEBOARD_DBUS_LOG_INTERFACE,
+		      GINT_TO_POINTER(DBUSHANDLER_INTERFACE_LOG));
+  g_hash_table_insert(map, DBUS_INTERFACE_DBUS,
+		      GINT_TO_POINTER(DBUSHANDLER_INTERFACE_DBUS));
+  g_hash_table_insert(map, DBUS_INTERFACE_LOCAL,
+		      GINT_TO_POINTER(DBUSHANDLER_INTERFACE_LOCAL));
+  g_hash_table_insert(map, DBUS_INTERFACE_INTROSPECTABLE,
+		      GINT_TO_POINTER(DBUSHANDLER_INTERFACE_INTROSPECTABLE));
+
+  return map;
 }
 
 static DBusHandlerResult dbushandler_handle_message(DBusConnection *conn,
@@ -1342,8 +2234,9 @@ static DBusHandlerResult dbushandler_handle_message(DBusConnection *conn,
   const gchar* interface = NULL;
   const gchar* member = NULL;
   const gchar* connection_name = NULL;
-  WhiteBoardPacket* packet = NULL;
+  WhiteBoardPacket packet;
   gint type = 0;
+  DBusHandlerInterface interface_id = DBUSHANDLER_INTERFACE_UNKNOWN;
   DBusHandlerResult result = DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
   whiteboard_log_debug_fb();
 
@@ -1359,101 +2252,84 @@ static DBusHandlerResult dbushandler_handle_message(DBusConnection *conn,
   g_return_val_if_fail(NULL != interface,
 		       DBUS_HANDLER_RESULT_NOT_YET_HANDLED);
 
-  packet = g_new0(WhiteBoardPacket, 1);
-  g_return_val_if_fail(NULL != packet, DBUS_HANDLER_RESULT_NEED_MEMORY);
+  interface_id = (DBusHandlerInterface)
+    GPOINTER_TO_INT(g_hash_table_lookup(self->interface_map, interface));
 
   /* TODO: Could be optimized, sender is not needed in many
    * of the routed packets.
    */
-  if (!strcmp(interface, WHITEBOARD_DBUS_NODE_INTERFACE))
+  switch (interface_id)
     {
-      whiteboard_log_debug("Got node_access packet\n");
+    case DBUSHANDLER_INTERFACE_NODE:
+    case DBUSHANDLER_INTERFACE_SIB_ACCESS:
+    case DBUSHANDLER_INTERFACE_DISCOVERY:
+      whiteboard_log_debug("Got %s packet\n", interface);
 	    
       if ( NULL != connection_name )
 	dbus_message_set_sender(msg, connection_name);
 	  
-      packet->message = msg;
-      packet->connection = conn;
-      self->sib_handler_cb(self, packet, self->user_data_sib_handler);
-      result = DBUS_HANDLER_RESULT_HANDLED;
-    }
-  else if (!strcmp(interface, WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE))
-    {
-      whiteboard_log_debug("Got node packet\n");
-	    
-      if ( NULL != connection_name )
-	dbus_message_set_sender(msg, connection_name);
-	    
-      packet->message = msg;
-      packet->connection = conn;
-      self->sib_handler_cb(self, packet, self->user_data_sib_handler);
-      result = DBUS_HANDLER_RESULT_HANDLED;
-    }
-  else if (!strcmp(interface, WHITEBOARD_DBUS_DISCOVERY_INTERFACE))
-    {
-      whiteboard_log_debug("Got discovery packet\n");
-	    
-      if ( NULL != connection_name )
-	dbus_message_set_sender(msg, connection_name);
-	    
-      packet->message = msg;
-      packet->connection = conn;
-      self->sib_handler_cb(self, packet, self->user_data_sib_handler);
-    }
-  else if (!strcmp(interface, WHITEBOARD_DBUS_REGISTER_INTERFACE))
-    {
+      /* The packet only lives for the duration of the callback */
+      packet.message = msg;
+      packet.connection = conn;
+      self->sib_handler_cb(self, &packet, self->user_data_sib_handler);
+      if (interface_id != DBUSHANDLER_INTERFACE_DISCOVERY)
+	result = DBUS_HANDLER_RESULT_HANDLED;
+      break;
+
+    case DBUSHANDLER_INTERFACE_REGISTER:
       whiteboard_log_debug("Got register packet\n");
 
       //if ( NULL != connection_name )
       //	dbus_message_set_sender(msg, connection_name);
 
       result = dbushandler_whiteboard_register_message(self, conn, msg);
-    }
-  else if (!strcmp(interface, WHITEBOARD_DBUS_INTERFACE))
-    {
+      break;
+
+    case DBUSHANDLER_INTERFACE_GENERAL:
       whiteboard_log_debug("Got general whiteboard packet\n");
 
       /* Don't set the sender because session bus goes wacko */
 
       dbushandler_whiteboard_general_message(self, conn, msg);
       result = DBUS_HANDLER_RESULT_HANDLED;      
-    }
-  else if (!strcmp(interface, WHITEBOARD_DBUS_LOG_INTERFACE))
-    {
-      GList* node_connections = dbushandler_get_node_connections(self); 
+      break;
+
+    case DBUSHANDLER_INTERFACE_LOG:
+      {
+	ConnectionSnapshot* node_connections = dbushandler_get_node_connections(self); 
 	  
-      whiteboard_log_debug("Got log message packet\n"); 
+	whiteboard_log_debug("Got log message packet\n"); 
 	  
-      if ( NULL != connection_name ) 
-	dbus_message_set_sender(msg, connection_name); 
+	if ( NULL != connection_name ) 
+	  dbus_message_set_sender(msg, connection_name); 
 	  
-      whiteboard_util_send_message_to_list(node_connections, msg);
-      result = DBUS_HANDLER_RESULT_HANDLED;      
-      
-    }
-  else if (!strcmp(interface, DBUS_INTERFACE_DBUS))
-    {
+	dbushandler_broadcast(self, node_connections, msg);
+	connection_snapshot_unref(node_connections);
+	result = DBUS_HANDLER_RESULT_HANDLED;      
+      }
+      break;
+
+    case DBUSHANDLER_INTERFACE_DBUS:
       whiteboard_log_debug("Got generic DBus packet\n");
       dbushandler_org_freedesktop_dbus_message(self, conn, msg);
       result = DBUS_HANDLER_RESULT_HANDLED;      
-    }
-  else if (!strcmp(interface, DBUS_INTERFACE_LOCAL))
-    {
+      break;
+
+    case DBUSHANDLER_INTERFACE_LOCAL:
       whiteboard_log_debug("Got Local DBus packet\n");
       dbushandler_org_freedesktop_dbus_local( self, conn,msg);
-    }
-  else if( !strcmp(interface, DBUS_INTERFACE_INTROSPECTABLE ) )
-    {
+      break;
+
+    case DBUSHANDLER_INTERFACE_INTROSPECTABLE:
       whiteboard_log_debug("Got Introspectable DBus packet\n");
       result = dbushandler_org_freedesktop_dbus_introspectable( self, conn,msg);
-    }
-  else
-    {
+      break;
+
+    default:
       whiteboard_log_warning("Unknown interface: %s (member: %s)\n", 
 			     interface, member);
+      break;
     }
-	
-  g_free(packet);
 
   whiteboard_log_debug_fe();
 
@@ -1468,17 +2344,23 @@ static DBusHandlerResult dbushandler_handle_message(DBusConnection *conn,
 void dbushandler_add_connection_by_uuid(DBusHandler* self, gchar* uuid,
 					DBusConnection* conn)
 {
+  ConnectionRecord *record = NULL;
+
   whiteboard_log_debug_fb();
 
   g_return_if_fail(NULL != self);
   g_return_if_fail(NULL != uuid);
   g_return_if_fail(NULL != conn);
 
+  g_static_rec_mutex_lock(&self->lock);
   g_hash_table_insert(self->connection_map, g_strdup(uuid), conn);
+  record = dbushandler_get_record(self, conn, TRUE);
+  record->uuids = g_slist_prepend(record->uuids, g_strdup(uuid));
 
-  whiteboard_log_debugc(WHITEBOARD_DEBUG_DBUS,
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
 			"Insert UUID: %s, conn: %p. Map size: %d\n",
 			uuid, conn, g_hash_table_size(self->connection_map));
+  g_static_rec_mutex_unlock(&self->lock);
 
   whiteboard_log_debug_fe();
 }
@@ -1493,11 +2375,13 @@ DBusConnection *dbushandler_get_connection_by_uuid(DBusHandler *self,
   g_return_val_if_fail(NULL != self, NULL);
   g_return_val_if_fail(NULL != uuid, NULL);
 
-  whiteboard_log_debugc(WHITEBOARD_DEBUG_DBUS,
+  g_static_rec_mutex_lock(&self->lock);
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
 			"Trying to get UUID: %s, Map size: %d\n",
 			uuid, g_hash_table_size(self->connection_map));
 	
   conn = (DBusConnection*) g_hash_table_lookup(self->connection_map, uuid);
+  g_static_rec_mutex_unlock(&self->lock);
 
   whiteboard_log_debug_fe();
 
@@ -1507,6 +2391,7 @@ DBusConnection *dbushandler_get_connection_by_uuid(DBusHandler *self,
 gboolean dbushandler_remove_connection_by_uuid(DBusHandler* self, gchar* uuid)
 {
   DBusConnection* conn = NULL;
+  ConnectionRecord *record = NULL;
   gboolean retval = FALSE;
 
   whiteboard_log_debug_fb();
@@ -1514,24 +2399,27 @@ gboolean dbushandler_remove_connection_by_uuid(DBusHandler* self, gchar* uuid)
   g_return_val_if_fail(NULL != self, FALSE);
   g_return_val_if_fail(NULL != uuid, FALSE);
 
+  g_static_rec_mutex_lock(&self->lock);
   conn = dbushandler_get_connection_by_uuid(self, uuid);
   if (conn != NULL)
     {
       /* Remove the connection from the hash map */
       retval = g_hash_table_remove(self->connection_map, uuid);
 
-      whiteboard_log_debugc(WHITEBOARD_DEBUG_DBUS,
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
 			    "Removed:%s, conn:%p, ok:%s. Map size:%d\n",
 			    uuid, conn, (retval) ? "TRUE" : "FALSE",
 			    g_hash_table_size(self->connection_map));
 
-      self->node_connections = 
-	g_list_remove(self->node_connections, conn);
-      self->sib_connections = 
-	g_list_remove(self->sib_connections, conn);
+      record = dbushandler_get_record(self, conn, FALSE);
+      if (record != NULL)
+	record->uuids = dbushandler_record_remove_key(record->uuids, uuid);
+      connection_set_remove(self->node_connections, conn);
+      connection_set_remove(self->sib_connections, conn);
       
       // dbus_connection_unref(conn);
     }
+  g_static_rec_mutex_unlock(&self->lock);
 
   whiteboard_log_debug_fe();
 
@@ -1542,15 +2430,38 @@ gboolean dbushandler_remove_connection_by_uuid(DBusHandler* self, gchar* uuid)
  * Connection lists by access ID
  *****************************************************************************/
 
+gboolean dbushandler_get_access_route(DBusHandler *self,
+				      gint accessid,
+				      AccessRoute *route)
+{
+  g_return_val_if_fail(NULL != self, FALSE);
+
+  return access_route_table_lookup(self->access_routes, accessid, route);
+}
+
+gint dbushandler_new_access_id(DBusHandler *self)
+{
+  gint accessid = 0;
+
+  g_return_val_if_fail(NULL != self, 0);
+
+  do
+    accessid = whiteboard_sib_handler_get_access_id();
+  while (access_route_table_lookup(self->access_routes, accessid, NULL));
+
+  return accessid;
+}
+
 DBusConnection *dbushandler_get_sib_connection_by_access_id(DBusHandler *self,
 							     gint accessid)
 {
+  AccessRoute route;
   DBusConnection* conn = NULL;
   
   whiteboard_log_debug_fb();
   
-  conn = (DBusConnection*) g_hash_table_lookup(self->access_sib_map,
-					       GINT_TO_POINTER(accessid));
+  if (access_route_table_lookup(self->access_routes, accessid, &route))
+    conn = route.sib_connection;
   
   whiteboard_log_debug_fe();
   
@@ -1560,85 +2471,113 @@ DBusConnection *dbushandler_get_sib_connection_by_access_id(DBusHandler *self,
 DBusConnection *dbushandler_get_node_connection_by_access_id(DBusHandler *self,
 							   gint accessid)
 {
+  AccessRoute route;
   DBusConnection* conn = NULL;
   
   whiteboard_log_debug_fb();
   
-  conn = (DBusConnection*) g_hash_table_lookup(self->access_node_map,
-					       GINT_TO_POINTER(accessid));
+  if (access_route_table_lookup(self->access_routes, accessid, &route))
+    conn = route.node_connection;
   
   whiteboard_log_debug_fe();
   
   return conn;
 }
 
-void dbushandler_set_sib_connection_with_access_id(DBusHandler *self,
-						   gint accessid,
-						   DBusConnection* conn)
-{
-  whiteboard_log_debug_fb();
-  whiteboard_log_debug("Validating (sib) access id: %d\n", accessid);
-  g_hash_table_insert(self->access_sib_map,
-		      GINT_TO_POINTER(accessid), (gpointer) conn);
-  whiteboard_log_debug_fe();
-}
-
-void dbushandler_set_node_connection_with_access_id(DBusHandler *self,
-						    gint accessid,
-						    DBusConnection* conn)
-{
-  whiteboard_log_debug_fb();
-  whiteboard_log_debug("Validating (node) access id: %d\n", accessid);
-  g_hash_table_insert(self->access_node_map,
-		      GINT_TO_POINTER(accessid), (gpointer) conn);
-  whiteboard_log_debug_fe();
-}
-
 void dbushandler_associate_access_id(DBusHandler* self,
 				     gint accessid, 
 				     DBusConnection* node_conn,
-				     DBusConnection* sib_conn)
+				     DBusConnection* sib_conn,
+				     AccessRouteOp op)
 {
+  ConnectionRecord *record = NULL;
+
   whiteboard_log_debug_fb();
   whiteboard_log_debug("Validating access id: %d\n", accessid);
-  g_hash_table_insert(self->access_node_map,
-		      GINT_TO_POINTER(accessid),
-		      (gpointer) node_conn);
-  
-  g_hash_table_insert(self->access_sib_map,
-		      GINT_TO_POINTER(accessid),
-		      (gpointer) sib_conn);
+  /* Writes are timed by their pending call */
+  access_route_table_insert(self->access_routes, accessid,
+			    node_conn, sib_conn, op,
+			    (op == ACCESS_ROUTE_OP_WRITE) ? 0 :
+			    self->access_timeout);
+
+  g_static_rec_mutex_lock(&self->lock);
+  g_hash_table_insert(dbushandler_get_record(self, node_conn, TRUE)->access_ids,
+		      GINT_TO_POINTER(accessid), NULL);
+
+  /* The SIB owes an answer until the id goes away or is kept */
+  record = dbushandler_get_record(self, sib_conn, TRUE);
+  g_hash_table_insert(record->access_ids,
+		      GINT_TO_POINTER(accessid), GINT_TO_POINTER(TRUE));
+  record->pending++;
+  g_static_rec_mutex_unlock(&self->lock);
   
   whiteboard_log_debug_fe();
 }
 
 void dbushandler_invalidate_access_id(DBusHandler *self, gint accessid)
 {
+  AccessRoute route;
+
   whiteboard_log_debug_fb();
   whiteboard_log_debug("Invalidating access id: %d\n", accessid);
-  g_hash_table_remove(self->access_node_map,
-		      GINT_TO_POINTER(accessid));
-  g_hash_table_remove(self->access_sib_map,
-		      GINT_TO_POINTER(accessid));
+  if (access_route_table_lookup(self->access_routes, accessid, &route) &&
+      access_route_table_remove(self->access_routes, accessid))
+    {
+      g_static_rec_mutex_lock(&self->lock);
+      dbushandler_record_forget_access_id(self, accessid, &route);
+      g_static_rec_mutex_unlock(&self->lock);
+    }
   whiteboard_log_debug_fe();
 }
 
+void dbushandler_keep_access_id(DBusHandler *self, gint accessid)
+{
+  ConnectionRecord *record = NULL;
+  AccessRoute route;
+
+  g_return_if_fail(NULL != self);
+
+  access_route_table_set_timeout(self->access_routes, accessid, 0);
+
+  /* An established subscription is no longer queued on the SIB */
+  if (access_route_table_lookup(self->access_routes, accessid, &route))
+    {
+      g_static_rec_mutex_lock(&self->lock);
+      record = dbushandler_get_record(self, route.sib_connection, FALSE);
+      if (record != NULL &&
+	  g_hash_table_lookup(record->access_ids, GINT_TO_POINTER(accessid)))
+	{
+	  g_hash_table_insert(record->access_ids,
+			      GINT_TO_POINTER(accessid), NULL);
+	  record->pending--;
+	}
+      g_static_rec_mutex_unlock(&self->lock);
+    }
+}
+
 
 void dbushandler_add_connection_by_subscription_id(DBusHandler* self,
 						   gchar* subscription_id,
 						   DBusConnection* conn)
 {
+  ConnectionRecord *record = NULL;
+
   whiteboard_log_debug_fb();
 
   g_return_if_fail(NULL != self);
   g_return_if_fail(NULL != subscription_id);
   g_return_if_fail(NULL != conn);
 
+  g_static_rec_mutex_lock(&self->lock);
   g_hash_table_insert(self->subscription_map, g_strdup(subscription_id), conn);
+  record = dbushandler_get_record(self, conn, TRUE);
+  record->subscriptions = g_slist_prepend(record->subscriptions,
+					  g_strdup(subscription_id));
 
-  whiteboard_log_debugc(WHITEBOARD_DEBUG_DBUS,
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
 			"Insert subscr_id: %s, conn: %p. Map size: %d\n",
 			subscription_id, conn, g_hash_table_size(self->subscription_map));
+  g_static_rec_mutex_unlock(&self->lock);
 
   whiteboard_log_debug_fe();
 }
@@ -1653,11 +2592,13 @@ DBusConnection *dbushandler_get_connection_by_subscription_id(DBusHandler *self,
   g_return_val_if_fail(NULL != self, NULL);
   g_return_val_if_fail(NULL != subscription_id, NULL);
 
-  whiteboard_log_debugc(WHITEBOARD_DEBUG_DBUS,
+  g_static_rec_mutex_lock(&self->lock);
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
 			"Trying to get SUBSCRIPTION_ID: %s, Map size: %d\n",
 			subscription_id, g_hash_table_size(self->subscription_map));
 	
   conn = (DBusConnection*) g_hash_table_lookup(self->subscription_map, subscription_id);
+  g_static_rec_mutex_unlock(&self->lock);
 
   whiteboard_log_debug_fe();
 
@@ -1667,6 +2608,7 @@ DBusConnection *dbushandler_get_connection_by_subscription_id(DBusHandler *self,
 gboolean dbushandler_remove_connection_by_subscription_id(DBusHandler* self, gchar* subscription_id)
 {
   DBusConnection* conn = NULL;
+  ConnectionRecord *record = NULL;
   gboolean retval = FALSE;
 
   whiteboard_log_debug_fb();
@@ -1674,19 +2616,27 @@ gboolean dbushandler_remove_connection_by_subscription_id(DBusHandler* self, gch
   g_return_val_if_fail(NULL != self, FALSE);
   g_return_val_if_fail(NULL != subscription_id, FALSE);
 
+  g_static_rec_mutex_lock(&self->lock);
   conn = dbushandler_get_connection_by_subscription_id(self, subscription_id);
   if (conn != NULL)
     {
       /* Remove the connection from the hash map */
       retval = g_hash_table_remove(self->subscription_map, subscription_id);
 
-      whiteboard_log_debugc(WHITEBOARD_DEBUG_DBUS,
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
 			    "Removed:%s, conn:%p, ok:%s. Map size:%d\n",
 			    subscription_id, conn, (retval) ? "TRUE" : "FALSE",
 			    g_hash_table_size(self->subscription_map));
+
+      record = dbushandler_get_record(self, conn, FALSE);
+      if (record != NULL)
+	record->subscriptions =
+	  dbushandler_record_remove_key(record->subscriptions,
+					subscription_id);
 		
       // dbus_connection_unref(conn);
     }
+  g_static_rec_mutex_unlock(&self->lock);
 
   whiteboard_log_debug_fe();
 
@@ -1697,6 +2647,334 @@ static void dbushandler_unregister_handler(DBusConnection* conn,gpointer data)
 {
   // TODO 
 }
+
+static gboolean dbushandler_sweep_access_ids(gpointer data)
+{
+  DBusHandler *self = (DBusHandler *) data;
+
+  access_route_table_expire(self->access_routes,
+			    dbushandler_access_id_expired, self);
+
+  return TRUE;
+}
+
+static void dbushandler_access_id_expired(gint accessid,
+					  AccessRoute *route,
+					  gpointer data)
+{
+  DBusHandler *self = (DBusHandler *) data;
+
+  g_static_rec_mutex_lock(&self->lock);
+  dbushandler_record_forget_access_id(self, accessid, route);
+  g_static_rec_mutex_unlock(&self->lock);
+
+  if (self->access_expired_cb != NULL)
+    self->access_expired_cb(self, accessid, route,
+			    self->user_data_access_expired);
+}
+
+/* Call with the lock held */
+static ConnectionRecord *dbushandler_get_record(DBusHandler *self,
+						DBusConnection *conn,
+						gboolean create)
+{
+  ConnectionRecord *record = NULL;
+
+  record = (ConnectionRecord *) g_hash_table_lookup(self->connection_records,
+						    conn);
+  if (record == NULL && create && conn != NULL)
+    {
+      record = g_new0(ConnectionRecord, 1);
+      record->access_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+      g_hash_table_insert(self->connection_records, conn, record);
+    }
+
+  return record;
+}
+
+static void dbushandler_record_free(gpointer data)
+{
+  ConnectionRecord *record = (ConnectionRecord *) data;
+
+  g_slist_foreach(record->uuids, (GFunc) g_free, NULL);
+  g_slist_free(record->uuids);
+  g_slist_foreach(record->subscriptions, (GFunc) g_free, NULL);
+  g_slist_free(record->subscriptions);
+  g_hash_table_destroy(record->access_ids);
+  g_slist_free(record->channels);
+#ifdef SHM_RING_SUPPORTED
+  if (record->from_sib != NULL)
+    {
+      shm_ring_detach_consumer(record->from_sib);
+      shm_ring_unref(record->from_sib);
+    }
+#endif
+  g_free(record);
+}
+
+static gchar *dbushandler_direct_channel_key(const gchar *nodeid,
+					     const gchar *sibid)
+{
+  gchar *key = NULL;
+  gchar *lower = NULL;
+
+  /* UUIDs compare case-insensitively */
+  key = g_strconcat(nodeid, "\n", sibid, NULL);
+  lower = g_ascii_strdown(key, -1);
+  g_free(key);
+
+  return lower;
+}
+
+/**
+ * Revoke a direct channel and forget it. Call with the lock held.
+ *
+ * @param self DBusHandler instance
+ * @param channel DirectChannel or NULL
+ */
+static void dbushandler_direct_channel_close(DBusHandler *self,
+					     DirectChannel *channel)
+{
+  ConnectionRecord *record = NULL;
+
+  if (channel == NULL)
+    return;
+
+  record = dbushandler_get_record(self, channel->node_connection, FALSE);
+  if (record != NULL)
+    record->channels = g_slist_remove(record->channels, channel);
+  record = dbushandler_get_record(self, channel->sib_connection, FALSE);
+  if (record != NULL)
+    record->channels = g_slist_remove(record->channels, channel);
+
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
+			       "Revoking direct channel %p\n", channel);
+
+  if (self->direct_channel_cb != NULL)
+    self->direct_channel_cb(self, channel->sibid,
+			    self->user_data_direct_channel);
+
+  /* Frees the channel */
+  g_hash_table_remove(self->direct_channels, channel->key);
+}
+
+static void dbushandler_direct_channel_free(gpointer data)
+{
+  DirectChannel *channel = (DirectChannel *) data;
+
+  /* Shutting down our copy shuts the socket down for both peers */
+  shutdown(channel->fd, SHUT_RDWR);
+  close(channel->fd);
+  g_free(channel->key);
+  g_free(channel->sibid);
+  g_free(channel);
+}
+
+static GSList *dbushandler_record_remove_key(GSList *keys, const gchar *key)
+{
+  GSList *link = NULL;
+
+  link = g_slist_find_custom(keys, key, (GCompareFunc) strcmp);
+  if (link != NULL)
+    {
+      g_free(link->data);
+      keys = g_slist_delete_link(keys, link);
+    }
+
+  return keys;
+}
+
+/* Call with the lock held */
+static void dbushandler_record_forget_access_id(DBusHandler *self,
+						gint accessid,
+						AccessRoute *route)
+{
+  ConnectionRecord *record = NULL;
+
+  record = dbushandler_get_record(self, route->node_connection, FALSE);
+  if (record != NULL)
+    g_hash_table_remove(record->access_ids, GINT_TO_POINTER(accessid));
+
+  record = dbushandler_get_record(self, route->sib_connection, FALSE);
+  if (record != NULL)
+    {
+      if (g_hash_table_lookup(record->access_ids, GINT_TO_POINTER(accessid)))
+	record->pending--;
+      g_hash_table_remove(record->access_ids, GINT_TO_POINTER(accessid));
+    }
+}
+
+void dbushandler_append_statistic(DBusMessageIter *dict,
+				  const gchar *name,
+				  dbus_uint32_t value)
+{
+  DBusMessageIter entry;
+
+  dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+  dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &name);
+  dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT32, &value);
+  dbus_message_iter_close_container(dict, &entry);
+}
+
+/**
+ * Sum the counters of the dispatch schedulers of all threads
+ */
+static void dbushandler_get_dispatch_statistics(DBusHandler *self,
+						guint *turns,
+						guint *preempted)
+{
+  guint t = 0;
+  guint p = 0;
+  guint i = 0;
+
+  dispatch_scheduler_get_statistics(self->scheduler, turns, preempted);
+  for (i = 0; i < self->worker_count; i++)
+    {
+      dispatch_scheduler_get_statistics(self->worker_schedulers[i], &t, &p);
+      *turns += t;
+      *preempted += p;
+    }
+}
+
+/**
+ * Reply to WHITEBOARD_DBUS_METHOD_GET_STATISTICS with the sizes of the
+ * routing maps and the queue depth of each SIB.
+ */
+static void dbushandler_send_statistics(DBusHandler *self,
+					DBusConnection *conn,
+					DBusMessage *msg)
+{
+  DBusMessage *reply = NULL;
+  DBusMessageIter iter;
+  DBusMessageIter dict;
+  const gchar *names[15];
+  dbus_uint32_t values[15];
+  GHashTableIter sibs;
+  gpointer uuid = NULL;
+  gpointer sib_conn = NULL;
+  ConnectionRecord *record = NULL;
+  gchar *name = NULL;
+  guint count = 0;
+  guint i = 0;
+#ifdef SHM_RING_SUPPORTED
+  guint ring_records = 0;
+  guint ring_spin_hits = 0;
+#endif
+
+  whiteboard_log_debug_fb();
+
+  g_static_rec_mutex_lock(&self->lock);
+  names[count] = "connections";
+  values[count++] = g_hash_table_size(self->connection_map);
+  names[count] = "node_connections";
+  values[count++] = connection_set_size(self->node_connections);
+  names[count] = "sib_connections";
+  values[count++] = connection_set_size(self->sib_connections);
+  names[count] = "subscriptions";
+  values[count++] = g_hash_table_size(self->subscription_map);
+  names[count] = "access_ids_reclaimed";
+  values[count++] = self->access_ids_reclaimed;
+  names[count] = "sib_requests_refused";
+  values[count++] = self->sib_requests_refused;
+  names[count] = "direct_channels";
+  values[count++] = g_hash_table_size(self->direct_channels);
+  g_static_rec_mutex_unlock(&self->lock);
+
+  names[count] = "dispatch_turns";
+  names[count + 1] = "dispatch_preempted";
+  dbushandler_get_dispatch_statistics(self, &values[count],
+				      &values[count + 1]);
+  count += 2;
+
+  names[count] = "broadcasts_sent";
+  values[count++] = g_atomic_int_get(&self->broadcasts_sent);
+  names[count] = "broadcasts_skipped";
+  values[count++] = g_atomic_int_get(&self->broadcasts_skipped);
+
+  names[count] = "access_ids";
+  names[count + 1] = "access_ids_overflow";
+  names[count + 2] = "access_ids_expired";
+  access_route_table_get_statistics(self->access_routes,
+				    &values[count], &values[count + 1],
+				    &values[count + 2]);
+  count += 3;
+
+  reply = dbus_message_new_method_return(msg);
+  if (reply == NULL)
+    {
+      whiteboard_log_error("Out of memory\n");
+      return;
+    }
+
+  dbus_message_iter_init_append(reply, &iter);
+  dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+				   DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+				   DBUS_TYPE_STRING_AS_STRING
+				   DBUS_TYPE_UINT32_AS_STRING
+				   DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+				   &dict);
+  for (i = 0; i < count; i++)
+    dbushandler_append_statistic(&dict, names[i], values[i]);
+
+  /* Queue depth of each SIB, connection_map has only the registered
+     uuid of SIB access connections */
+  g_static_rec_mutex_lock(&self->lock);
+  g_hash_table_iter_init(&sibs, self->connection_map);
+  while (g_hash_table_iter_next(&sibs, &uuid, &sib_conn))
+    {
+      if (!connection_set_contains(self->sib_connections, sib_conn))
+	continue;
+      record = dbushandler_get_record(self, sib_conn, FALSE);
+
+      name = g_strdup_printf("sib_queue_requests:%s", (gchar *) uuid);
+      dbushandler_append_statistic(&dict, name,
+				   (record != NULL) ? record->pending : 0);
+      g_free(name);
+
+      name = g_strdup_printf("sib_queue_bytes:%s", (gchar *) uuid);
+#ifdef HAVE_DBUS_CONNECTION_GET_OUTGOING_SIZE
+      dbushandler_append_statistic(&dict, name,
+				   dbus_connection_get_outgoing_size(sib_conn));
+#else
+      dbushandler_append_statistic(&dict, name, 0);
+#endif
+      g_free(name);
+
+#ifdef SHM_RING_SUPPORTED
+      if (record != NULL && record->from_sib != NULL)
+	{
+	  shm_ring_get_statistics(record->from_sib, &ring_records, NULL,
+				  &ring_spin_hits);
+	  name = g_strdup_printf("shm_ring_received:%s", (gchar *) uuid);
+	  dbushandler_append_statistic(&dict, name, ring_records);
+	  g_free(name);
+	  name = g_strdup_printf("shm_ring_spin_hits:%s", (gchar *) uuid);
+	  dbushandler_append_statistic(&dict, name, ring_spin_hits);
+	  g_free(name);
+	}
+#endif
+    }
+  g_static_rec_mutex_unlock(&self->lock);
+
+  if (self->statistics_cb != NULL)
+    self->statistics_cb(self, &dict, self->user_data_statistics);
+
+  dbus_message_iter_close_container(&iter, &dict);
+
+  dbus_connection_send(conn, reply, NULL);
+  dbus_message_unref(reply);
+
+  whiteboard_log_debug_fe();
+}
+
+static gpointer dbushandler_worker_thread(gpointer data)
+{
+  GMainLoop *loop = (GMainLoop *) data;
+
+  g_main_loop_run(loop);
+
+  return NULL;
+}
 #if 0
 gboolean discover_discover (ServerObject *server, gchar *uuid, gchar **address, GError **error)
 {
@@ -0,0 +1,455 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard daemon.
+ *
+ * dispatch_scheduler.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <glib.h>
+
+#define DBUS_API_SUBJECT_TO_CHANGE
+
+#include <dbus/dbus.h>
+#include <whiteboard_util.h>
+#include "whiteboard_daemon_log.h"
+
+#include "dispatch_scheduler.h"
+
+/* GSource dispatching the ready connections of a context */
+typedef struct _DispatchSource
+{
+  GSource source;
+  DispatchScheduler *scheduler;
+} DispatchSource;
+
+struct _DispatchScheduler
+{
+  GMainContext *context;
+  GSource *source;
+  guint quantum;
+
+  // connections with messages waiting, in the order they get their turn,
+  // each holds a reference
+  GQueue *ready;
+  GHashTable *queued; // DBusConnection -> TRUE if in ready
+  GStaticMutex lock;
+
+  volatile gint turns;
+  volatile gint preempted;
+};
+
+static gboolean dispatch_source_prepare(GSource *source, gint *timeout);
+
+static gboolean dispatch_source_check(GSource *source);
+
+static gboolean dispatch_source_dispatch(GSource *source,
+					 GSourceFunc callback,
+					 gpointer user_data);
+
+static void dispatch_scheduler_enqueue(DispatchScheduler *self,
+				       DBusConnection *conn);
+
+static void dispatch_scheduler_dispatch_status_cb(DBusConnection *conn,
+						  DBusDispatchStatus status,
+						  void *data);
+
+static void dispatch_scheduler_wakeup_cb(void *data);
+
+static dbus_bool_t dispatch_scheduler_add_watch(DBusWatch *watch, void *data);
+
+static void dispatch_scheduler_remove_watch(DBusWatch *watch, void *data);
+
+static void dispatch_scheduler_toggle_watch(DBusWatch *watch, void *data);
+
+static gboolean dispatch_scheduler_watch_cb(GIOChannel *channel,
+					    GIOCondition condition,
+					    gpointer data);
+
+static dbus_bool_t dispatch_scheduler_add_timeout(DBusTimeout *timeout,
+						  void *data);
+
+static void dispatch_scheduler_remove_timeout(DBusTimeout *timeout,
+					      void *data);
+
+static void dispatch_scheduler_toggle_timeout(DBusTimeout *timeout,
+					      void *data);
+
+static gboolean dispatch_scheduler_timeout_cb(gpointer data);
+
+static void dispatch_scheduler_source_free(void *data);
+
+static GSourceFuncs dispatch_source_funcs =
+  {
+    dispatch_source_prepare,
+    dispatch_source_check,
+    dispatch_source_dispatch,
+    NULL
+  };
+
+/*****************************************************************************
+ * Creation/destruction
+ *****************************************************************************/
+
+DispatchScheduler *dispatch_scheduler_new(GMainContext *context,
+					  guint quantum)
+{
+  DispatchScheduler *self = NULL;
+
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail(NULL != context, NULL);
+
+  self = g_new0(DispatchScheduler, 1);
+  self->context = g_main_context_ref(context);
+  self->quantum = MAX(quantum, 1);
+  self->ready = g_queue_new();
+  self->queued = g_hash_table_new(g_direct_hash, g_direct_equal);
+  g_static_mutex_init(&self->lock);
+
+  /* Same priority as dbus-glib's message queue source */
+  self->source = g_source_new(&dispatch_source_funcs, sizeof(DispatchSource));
+  ((DispatchSource *) self->source)->scheduler = self;
+  g_source_set_priority(self->source, G_PRIORITY_DEFAULT);
+  g_source_attach(self->source, context);
+
+  whiteboard_log_debug_fe();
+
+  return self;
+}
+
+void dispatch_scheduler_destroy(DispatchScheduler *self)
+{
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail(NULL != self);
+
+  g_source_destroy(self->source);
+  g_source_unref(self->source);
+
+  g_queue_foreach(self->ready, (GFunc) dbus_connection_unref, NULL);
+  g_queue_free(self->ready);
+  g_hash_table_destroy(self->queued);
+  g_static_mutex_free(&self->lock);
+  g_main_context_unref(self->context);
+  g_free(self);
+
+  whiteboard_log_debug_fe();
+}
+
+/*****************************************************************************
+ * Connections
+ *****************************************************************************/
+
+void dispatch_scheduler_add_connection(DispatchScheduler *self,
+				       DBusConnection *conn)
+{
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail(NULL != self);
+  g_return_if_fail(NULL != conn);
+
+  if (!dbus_connection_set_watch_functions(conn,
+					   dispatch_scheduler_add_watch,
+					   dispatch_scheduler_remove_watch,
+					   dispatch_scheduler_toggle_watch,
+					   self, NULL) ||
+      !dbus_connection_set_timeout_functions(conn,
+					     dispatch_scheduler_add_timeout,
+					     dispatch_scheduler_remove_timeout,
+					     dispatch_scheduler_toggle_timeout,
+					     self, NULL))
+    {
+      whiteboard_log_error("Out of memory\n");
+      whiteboard_log_debug_fe();
+      return;
+    }
+
+  dbus_connection_set_wakeup_main_function(conn,
+					   dispatch_scheduler_wakeup_cb,
+					   self, NULL);
+  dbus_connection_set_dispatch_status_function(conn,
+					       dispatch_scheduler_dispatch_status_cb,
+					       self, NULL);
+
+  /* Messages may have arrived with the authentication */
+  if (dbus_connection_get_dispatch_status(conn) == DBUS_DISPATCH_DATA_REMAINS)
+    dispatch_scheduler_enqueue(self, conn);
+
+  whiteboard_log_debug_fe();
+}
+
+void dispatch_scheduler_get_statistics(DispatchScheduler *self,
+				       guint *turns,
+				       guint *preempted)
+{
+  g_return_if_fail(NULL != self);
+
+  if (turns != NULL)
+    *turns = g_atomic_int_get(&self->turns);
+  if (preempted != NULL)
+    *preempted = g_atomic_int_get(&self->preempted);
+}
+
+/*****************************************************************************
+ * Round-robin dispatching
+ *****************************************************************************/
+
+static gboolean dispatch_source_prepare(GSource *source, gint *timeout)
+{
+  DispatchScheduler *self = ((DispatchSource *) source)->scheduler;
+  gboolean retval = FALSE;
+
+  *timeout = -1;
+
+  g_static_mutex_lock(&self->lock);
+  retval = !g_queue_is_empty(self->ready);
+  g_static_mutex_unlock(&self->lock);
+
+  return retval;
+}
+
+static gboolean dispatch_source_check(GSource *source)
+{
+  gint timeout = 0;
+
+  return dispatch_source_prepare(source, &timeout);
+}
+
+static gboolean dispatch_source_dispatch(GSource *source,
+					 GSourceFunc callback,
+					 gpointer user_data)
+{
+  DispatchScheduler *self = ((DispatchSource *) source)->scheduler;
+  DBusConnection *conn = NULL;
+  guint turns = 0;
+  guint i = 0;
+  guint n = 0;
+
+  /* Every connection ready now gets one turn, connections becoming ready
+     meanwhile wait for the next iteration */
+  g_static_mutex_lock(&self->lock);
+  turns = g_queue_get_length(self->ready);
+  g_static_mutex_unlock(&self->lock);
+
+  for (i = 0; i < turns; i++)
+    {
+      g_static_mutex_lock(&self->lock);
+      conn = (DBusConnection *) g_queue_pop_head(self->ready);
+      if (conn != NULL)
+	g_hash_table_remove(self->queued, conn);
+      g_static_mutex_unlock(&self->lock);
+
+      if (conn == NULL)
+	break;
+
+      for (n = 0; n < self->quantum; n++)
+	{
+	  if (dbus_connection_dispatch(conn) != DBUS_DISPATCH_DATA_REMAINS)
+	    break;
+	}
+
+      g_atomic_int_inc(&self->turns);
+
+      /* Back to the end of the line */
+      if (dbus_connection_get_dispatch_status(conn) ==
+	  DBUS_DISPATCH_DATA_REMAINS)
+	{
+	  g_atomic_int_inc(&self->preempted);
+	  dispatch_scheduler_enqueue(self, conn);
+	}
+
+      dbus_connection_unref(conn);
+    }
+
+  return TRUE;
+}
+
+static void dispatch_scheduler_enqueue(DispatchScheduler *self,
+				       DBusConnection *conn)
+{
+  gboolean added = FALSE;
+
+  g_static_mutex_lock(&self->lock);
+  if (g_hash_table_lookup(self->queued, conn) == NULL)
+    {
+      g_queue_push_tail(self->ready, dbus_connection_ref(conn));
+      g_hash_table_insert(self->queued, conn, GINT_TO_POINTER(TRUE));
+      added = TRUE;
+    }
+  g_static_mutex_unlock(&self->lock);
+
+  if (added)
+    g_main_context_wakeup(self->context);
+}
+
+/* May be called in any thread */
+static void dispatch_scheduler_dispatch_status_cb(DBusConnection *conn,
+						  DBusDispatchStatus status,
+						  void *data)
+{
+  if (status == DBUS_DISPATCH_DATA_REMAINS)
+    dispatch_scheduler_enqueue((DispatchScheduler *) data, conn);
+}
+
+static void dispatch_scheduler_wakeup_cb(void *data)
+{
+  g_main_context_wakeup(((DispatchScheduler *) data)->context);
+}
+
+/*****************************************************************************
+ * Watches and timeouts
+ *****************************************************************************/
+
+static dbus_bool_t dispatch_scheduler_add_watch(DBusWatch *watch, void *data)
+{
+  DispatchScheduler *self = (DispatchScheduler *) data;
+  GIOChannel *channel = NULL;
+  GSource *source = NULL;
+  GIOCondition condition = G_IO_ERR | G_IO_HUP;
+  guint flags = 0;
+
+  if (!dbus_watch_get_enabled(watch))
+    return TRUE;
+
+  flags = dbus_watch_get_flags(watch);
+  if (flags & DBUS_WATCH_READABLE)
+    condition |= G_IO_IN;
+  if (flags & DBUS_WATCH_WRITABLE)
+    condition |= G_IO_OUT;
+
+#ifdef HAVE_DBUS_WATCH_GET_UNIX_FD
+  channel = g_io_channel_unix_new(dbus_watch_get_unix_fd(watch));
+#else
+  channel = g_io_channel_unix_new(dbus_watch_get_fd(watch));
+#endif
+  source = g_io_create_watch(channel, condition);
+  g_io_channel_unref(channel);
+
+  g_source_set_callback(source, (GSourceFunc) dispatch_scheduler_watch_cb,
+			watch, NULL);
+  g_source_attach(source, self->context);
+  dbus_watch_set_data(watch, source, dispatch_scheduler_source_free);
+
+  return TRUE;
+}
+
+static void dispatch_scheduler_remove_watch(DBusWatch *watch, void *data)
+{
+  /* Frees the source */
+  dbus_watch_set_data(watch, NULL, NULL);
+}
+
+static void dispatch_scheduler_toggle_watch(DBusWatch *watch, void *data)
+{
+  if (dbus_watch_get_enabled(watch))
+    dispatch_scheduler_add_watch(watch, data);
+  else
+    dispatch_scheduler_remove_watch(watch, data);
+}
+
+static gboolean dispatch_scheduler_watch_cb(GIOChannel *channel,
+					    GIOCondition condition,
+					    gpointer data)
+{
+  DBusWatch *watch = (DBusWatch *) data;
+  guint flags = 0;
+
+  if (condition & G_IO_IN)
+    flags |= DBUS_WATCH_READABLE;
+  if (condition & G_IO_OUT)
+    flags |= DBUS_WATCH_WRITABLE;
+  if (condition & G_IO_ERR)
+    flags |= DBUS_WATCH_ERROR;
+  if (condition & G_IO_HUP)
+    flags |= DBUS_WATCH_HANGUP;
+
+  /* Only reads, the messages read are dispatched by the scheduler */
+  dbus_watch_handle(watch, flags);
+
+  return TRUE;
+}
+
+static dbus_bool_t dispatch_scheduler_add_timeout(DBusTimeout *timeout,
+						  void *data)
+{
+  DispatchScheduler *self = (DispatchScheduler *) data;
+  GSource *source = NULL;
+
+  if (!dbus_timeout_get_enabled(timeout))
+    return TRUE;
+
+  source = g_timeout_source_new(dbus_timeout_get_interval(timeout));
+  g_source_set_callback(source, dispatch_scheduler_timeout_cb,
+			timeout, NULL);
+  g_source_attach(source, self->context);
+  dbus_timeout_set_data(timeout, source, dispatch_scheduler_source_free);
+
+  return TRUE;
+}
+
+static void dispatch_scheduler_remove_timeout(DBusTimeout *timeout,
+					      void *data)
+{
+  /* Frees the source */
+  dbus_timeout_set_data(timeout, NULL, NULL);
+}
+
+static void dispatch_scheduler_toggle_timeout(DBusTimeout *timeout,
+					      void *data)
+{
+  /* The interval may have changed too */
+  dispatch_scheduler_remove_timeout(timeout, data);
+  dispatch_scheduler_add_timeout(timeout, data);
+}
+
+static gboolean dispatch_scheduler_timeout_cb(gpointer data)
+{
+  dbus_timeout_handle((DBusTimeout *) data);
+
+  return TRUE;
+}
+
+static void dispatch_scheduler_source_free(void *data)
+{
+  GSource *source = (GSource *) data;
+
+  g_source_destroy(source);
+  g_source_unref(source);
+}
@@ -47,7 +47,7 @@
 #include <stdlib.h>
 #include <glib.h>
 
-#include <whiteboard_log.h>
+#include "whiteboard_daemon_log.h"
 
 #include "dbushandler.h"
 #include "whiteboard_control.h"
@@ -56,6 +56,69 @@
 WhiteBoardControl *whiteboard_control = NULL;
 GMainLoop *whiteboard_mainloop = NULL;
 
+static gchar *main_socket = NULL;
+static gint main_batch_window = 0;
+static gint main_batch_max = 32;
+static gint main_workers = 0;
+static gint main_access_timeout = DBUSHANDLER_DEFAULT_ACCESS_TIMEOUT / 1000;
+static gint main_sib_queue_bytes = DBUSHANDLER_DEFAULT_SIB_QUEUE_BYTES;
+static gint main_sib_queue_requests = DBUSHANDLER_DEFAULT_SIB_QUEUE_REQUESTS;
+static gint main_node_rate = 0;
+static gint main_node_burst = 0;
+static gint main_sib_rate = 0;
+static gint main_sib_burst = 0;
+static gint main_shm_ring_size = 0;
+static gboolean main_direct_channels = FALSE;
+static gint main_query_cache = 0;
+
+static GOptionEntry main_options[] =
+{
+	{ "socket", 0, 0, G_OPTION_ARG_FILENAME, &main_socket,
+	  "Path of the unix socket for node and SIB access connections "
+	  "(default /tmp/dbus-test)", "PATH" },
+	{ "batch-window", 0, 0, G_OPTION_ARG_INT, &main_batch_window,
+	  "Batch subscription indications for N ms (default 0, disabled)",
+	  "N" },
+	{ "batch-max", 0, 0, G_OPTION_ARG_INT, &main_batch_max,
+	  "Maximum number of subscription indications in one batch "
+	  "(default 32)", "N" },
+	{ "workers", 0, 0, G_OPTION_ARG_INT, &main_workers,
+	  "Dispatch node and SIB access connections in N threads "
+	  "(default 0, main loop only)", "N" },
+	{ "access-timeout", 0, 0, G_OPTION_ARG_INT, &main_access_timeout,
+	  "Fail joins, queries and writes not answered by the SIB in N "
+	  "seconds (default 60, 0 to wait forever)", "N" },
+	{ "sib-queue-bytes", 0, 0, G_OPTION_ARG_INT, &main_sib_queue_bytes,
+	  "Refuse requests to a SIB with N bytes unsent "
+	  "(default 4194304, 0 for no cap)", "N" },
+	{ "sib-queue-requests", 0, 0, G_OPTION_ARG_INT,
+	  &main_sib_queue_requests,
+	  "Refuse requests to a SIB with N requests unanswered "
+	  "(default 1024, 0 for no cap)", "N" },
+	{ "node-rate", 0, 0, G_OPTION_ARG_INT, &main_node_rate,
+	  "Allow each node N requests per second (default 0, no limit)",
+	  "N" },
+	{ "node-burst", 0, 0, G_OPTION_ARG_INT, &main_node_burst,
+	  "Allow each node a burst of N requests (default the node rate)",
+	  "N" },
+	{ "sib-rate", 0, 0, G_OPTION_ARG_INT, &main_sib_rate,
+	  "Allow N requests per second to each SIB (default 0, no limit)",
+	  "N" },
+	{ "sib-burst", 0, 0, G_OPTION_ARG_INT, &main_sib_burst,
+	  "Allow a burst of N requests to each SIB (default the SIB rate)",
+	  "N" },
+	{ "shm-ring-size", 0, 0, G_OPTION_ARG_INT, &main_shm_ring_size,
+	  "Offer local SIB access processes a shared memory ring of N bytes "
+	  "(default 0, disabled)", "N" },
+	{ "direct-channels", 0, 0, G_OPTION_ARG_NONE, &main_direct_channels,
+	  "Connect joined nodes directly to the SIB access process when "
+	  "both support it", NULL },
+	{ "query-cache", 0, 0, G_OPTION_ARG_INT, &main_query_cache,
+	  "Cache the results of up to N queries (default 0, disabled)",
+	  "N" },
+	{ NULL }
+};
+
 void main_signal_handler(int sig)
 {
 	static volatile sig_atomic_t signalled = 0;
@@ -81,9 +144,24 @@ int main(int argc, char **argv)
 {
 	DBusHandler *dbushandler = NULL;
 	WhiteBoardSIBHandler *whiteboard_sib_handler = NULL;
+	GOptionContext *option_context = NULL;
+	GError *error = NULL;
 	
 	whiteboard_log_debug_fb();
 
+	whiteboard_daemon_log_init();
+
+	option_context = g_option_context_new("- WhiteBoard daemon");
+	g_option_context_add_main_entries(option_context, main_options, NULL);
+	if (!g_option_context_parse(option_context, &argc, &argv, &error))
+	{
+		whiteboard_log_error("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(option_context);
+		return 1;
+	}
+	g_option_context_free(option_context);
+
 	g_type_init();
 
 	g_thread_init(NULL);
@@ -97,18 +175,41 @@ int main(int argc, char **argv)
 	whiteboard_mainloop = g_main_loop_new(NULL, FALSE);
 	g_main_loop_ref(whiteboard_mainloop);
 
-	/* TODO: remove hardcoded values */
 	/* Create a new DBus connection handler */
 	whiteboard_log_debug("Creating dbus handler.\n");
-	dbushandler = dbushandler_new("/tmp/dbus-test",
+	dbushandler = dbushandler_new(main_socket != NULL ? main_socket :
+				      "/tmp/dbus-test",
 				      whiteboard_mainloop);
+	dbushandler_set_access_timeout(dbushandler,
+				       MAX(main_access_timeout, 0) * 1000);
+	dbushandler_set_sib_queue_limits(dbushandler,
+					 MAX(main_sib_queue_bytes, 0),
+					 MAX(main_sib_queue_requests, 0));
+	dbushandler_set_shm_ring_size(dbushandler, MAX(main_shm_ring_size, 0));
+	dbushandler_set_direct_channels(dbushandler, main_direct_channels);
 	whiteboard_log_debug("Done\n");
 
 	/* Create the node access component */
 	whiteboard_log_debug("Creating sib access handler.\n");
 	whiteboard_sib_handler = whiteboard_sib_handler_new(dbushandler);
+	whiteboard_sib_handler_set_indication_batching(whiteboard_sib_handler,
+						       MAX(main_batch_window, 0),
+						       MAX(main_batch_max, 1));
+	whiteboard_sib_handler_set_rate_limits(whiteboard_sib_handler,
+					       MAX(main_node_rate, 0),
+					       MAX(main_node_burst > 0 ?
+						   main_node_burst : main_node_rate,
+						   1),
+					       MAX(main_sib_rate, 0),
+					       MAX(main_sib_burst > 0 ?
+						   main_sib_burst : main_sib_rate,
+						   1));
+	whiteboard_sib_handler_set_query_cache(whiteboard_sib_handler,
+					       MAX(main_query_cache, 0));
 	whiteboard_log_debug("Done\n");
 
+	dbushandler_start_workers(dbushandler, MAX(main_workers, 0));
+
 	/* Create new control object and start all sinks/sources */
 	whiteboard_log_debug("Creating control object and starting sibaccess/sib modules.\n");
 	whiteboard_control = whiteboard_control_new();
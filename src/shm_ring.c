@@ -0,0 +1,601 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard daemon.
+ *
+ * shm_ring.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+/* memfd_create */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <glib.h>
+
+#include "shm_ring.h"
+
+#ifdef SHM_RING_SUPPORTED
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#include "whiteboard_daemon_log.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS (1024 + 9)
+#define F_GET_SEALS (1024 + 10)
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+#define SHM_RING_CPU_RELAX() __asm__ __volatile__("pause")
+#else
+#define SHM_RING_CPU_RELAX() do { } while (0)
+#endif
+
+#define SHM_RING_RECORD_SIZE(len)					\
+  (((guint32) sizeof(guint32) + (len) + SHM_RING_ALIGN - 1) &		\
+   ~(guint32) (SHM_RING_ALIGN - 1))
+
+#define SHM_RING_LOAD(p) ((guint32) g_atomic_int_get((volatile gint *) (p)))
+#define SHM_RING_STORE(p, v) g_atomic_int_set((volatile gint *) (p), (gint) (v))
+
+/* A locked read-modify-write, orders the preceding stores before the load */
+#define SHM_RING_FENCED_LOAD(p)						\
+  ((guint32) g_atomic_int_exchange_and_add((volatile gint *) (p), 0))
+
+/* Shared header, see shm_ring.h. head and tail are kept on their own
+   cache lines so that producer and consumer do not write the same line */
+typedef struct _ShmRingHeader
+{
+  guint32 magic;
+  guint32 version;
+  guint32 size;
+  guint32 reserved;
+  guint8 pad0[48];
+  volatile guint32 head;
+  guint8 pad1[60];
+  volatile guint32 tail;
+  volatile guint32 waiting;
+  guint8 pad2[56];
+} ShmRingHeader;
+
+/* GSource consuming a ring */
+typedef struct _ShmRingSource
+{
+  GSource source;
+  GPollFD pollfd;
+  ShmRing *ring;
+  ShmRingFunc func;
+  gpointer user_data;
+  GDestroyNotify notify;
+} ShmRingSource;
+
+struct _ShmRing
+{
+  volatile gint ref_count;
+  gint fd;
+  gint event_fd;
+  ShmRingHeader *header; // NULL if not mapped
+  gchar *data;
+  guint32 size; // of the data area, a power of two
+
+  // Private copies of head and tail, the shared ones may be overwritten
+  // by a misbehaving peer
+  guint32 head;
+  guint32 tail;
+  gboolean broken; // the peer corrupted the ring, no more records
+
+  GStaticMutex write_lock; // producers
+  GSource *source; // consumer
+
+  volatile gint records;
+  volatile gint wakeups;
+  volatile gint spin_hits;
+};
+
+static gboolean shm_ring_source_prepare(GSource *source, gint *timeout);
+
+static gboolean shm_ring_source_check(GSource *source);
+
+static gboolean shm_ring_source_dispatch(GSource *source,
+					 GSourceFunc callback,
+					 gpointer user_data);
+
+static void shm_ring_source_finalize(GSource *source);
+
+static gboolean shm_ring_is_empty(ShmRing *self);
+
+static gboolean shm_ring_peek(ShmRing *self, const gchar **data, guint *len);
+
+static void shm_ring_consume(ShmRing *self, guint len);
+
+static gboolean shm_ring_spin(ShmRing *self);
+
+static gboolean shm_ring_corrupted(ShmRing *self);
+
+static GSourceFuncs shm_ring_source_funcs =
+  {
+    shm_ring_source_prepare,
+    shm_ring_source_check,
+    shm_ring_source_dispatch,
+    shm_ring_source_finalize
+  };
+
+/*****************************************************************************
+ * Creation/destruction
+ *****************************************************************************/
+
+ShmRing *shm_ring_new(guint size)
+{
+  ShmRing *self = NULL;
+  guint32 data_size = 4096;
+  gpointer map = MAP_FAILED;
+
+  whiteboard_log_debug_fb();
+
+  while (data_size < size && data_size < (1U << 30))
+    data_size <<= 1;
+
+  self = g_new0(ShmRing, 1);
+  self->ref_count = 1;
+  self->event_fd = -1;
+  g_static_mutex_init(&self->write_lock);
+
+  /* The seals keep the peer from shrinking the memfd under our mapping */
+  self->fd = memfd_create("whiteboard-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (self->fd < 0 ||
+      ftruncate(self->fd, SHM_RING_HEADER_SIZE + data_size) < 0 ||
+      fcntl(self->fd, F_ADD_SEALS,
+	    F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0 ||
+      (self->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0 ||
+      (map = mmap(NULL, SHM_RING_HEADER_SIZE + data_size,
+		  PROT_READ | PROT_WRITE, MAP_SHARED,
+		  self->fd, 0)) == MAP_FAILED)
+    {
+      whiteboard_log_warning("Could not create shared memory ring: %s\n",
+			     strerror(errno));
+      shm_ring_unref(self);
+      whiteboard_log_debug_fe();
+      return NULL;
+    }
+
+  self->header = (ShmRingHeader *) map;
+  self->data = (gchar *) map + SHM_RING_HEADER_SIZE;
+  self->size = data_size;
+
+  self->header->magic = SHM_RING_MAGIC;
+  self->header->version = SHM_RING_VERSION;
+  self->header->size = data_size;
+  /* Until the consumer has looked at the ring, wake it on every record */
+  self->header->waiting = 1;
+
+  whiteboard_log_debug_fe();
+
+  return self;
+}
+
+ShmRing *shm_ring_open(gint fd, gint event_fd)
+{
+  ShmRing *self = NULL;
+  ShmRingHeader *header = NULL;
+  struct stat st;
+  gpointer map = MAP_FAILED;
+  guint32 data_size = 0;
+  gint seals = 0;
+
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail(fd >= 0, NULL);
+  g_return_val_if_fail(event_fd >= 0, NULL);
+
+  self = g_new0(ShmRing, 1);
+  self->ref_count = 1;
+  self->fd = fd;
+  self->event_fd = event_fd;
+  g_static_mutex_init(&self->write_lock);
+
+  /* Unsealed, the creator could shrink the memfd under our mapping */
+  seals = fcntl(fd, F_GET_SEALS);
+  if (seals < 0 || !(seals & F_SEAL_SHRINK) ||
+      fstat(fd, &st) < 0 || st.st_size < SHM_RING_HEADER_SIZE ||
+      (map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		  fd, 0)) == MAP_FAILED)
+    {
+      whiteboard_log_warning("Could not map shared memory ring\n");
+      shm_ring_unref(self);
+      whiteboard_log_debug_fe();
+      return NULL;
+    }
+
+  /* Read once, the creator may change the header at any time */
+  header = (ShmRingHeader *) map;
+  data_size = *(volatile guint32 *) &header->size;
+  if (header->magic != SHM_RING_MAGIC ||
+      header->version != SHM_RING_VERSION ||
+      data_size == 0 || (data_size & (data_size - 1)) != 0 ||
+      SHM_RING_HEADER_SIZE + (off_t) data_size != st.st_size)
+    {
+      whiteboard_log_warning("Not a shared memory ring\n");
+      munmap(map, st.st_size);
+      shm_ring_unref(self);
+      whiteboard_log_debug_fe();
+      return NULL;
+    }
+
+  self->header = header;
+  self->data = (gchar *) map + SHM_RING_HEADER_SIZE;
+  self->size = data_size;
+  self->head = SHM_RING_LOAD(&header->head);
+  self->tail = SHM_RING_LOAD(&header->tail);
+
+  whiteboard_log_debug_fe();
+
+  return self;
+}
+
+ShmRing *shm_ring_ref(ShmRing *self)
+{
+  g_return_val_if_fail(NULL != self, NULL);
+
+  g_atomic_int_inc(&self->ref_count);
+
+  return self;
+}
+
+void shm_ring_unref(ShmRing *self)
+{
+  g_return_if_fail(NULL != self);
+
+  if (!g_atomic_int_dec_and_test(&self->ref_count))
+    return;
+
+  if (self->header != NULL)
+    munmap(self->header, SHM_RING_HEADER_SIZE + self->size);
+  if (self->event_fd >= 0)
+    close(self->event_fd);
+  if (self->fd >= 0)
+    close(self->fd);
+  g_static_mutex_free(&self->write_lock);
+  g_free(self);
+}
+
+gint shm_ring_get_fd(ShmRing *self)
+{
+  g_return_val_if_fail(NULL != self, -1);
+
+  return self->fd;
+}
+
+gint shm_ring_get_event_fd(ShmRing *self)
+{
+  g_return_val_if_fail(NULL != self, -1);
+
+  return self->event_fd;
+}
+
+/*****************************************************************************
+ * Producer
+ *****************************************************************************/
+
+gboolean shm_ring_write(ShmRing *self, const gchar *data, guint len)
+{
+  guint32 used = 0;
+  guint32 offset = 0;
+  guint32 contiguous = 0;
+  guint32 need = 0;
+  guint64 one = 1;
+  gboolean retval = FALSE;
+
+  g_return_val_if_fail(NULL != self, FALSE);
+  g_return_val_if_fail(NULL != data || len == 0, FALSE);
+
+  if (len > self->size / SHM_RING_MAX_RECORD_DIVISOR)
+    return FALSE;
+
+  need = SHM_RING_RECORD_SIZE(len);
+
+  g_static_mutex_lock(&self->write_lock);
+  used = self->head - SHM_RING_LOAD(&self->header->tail);
+  offset = self->head & (self->size - 1);
+  contiguous = self->size - offset;
+
+  if (!self->broken && used > self->size)
+    {
+      whiteboard_log_warning("Shared memory ring corrupted by the peer\n");
+      self->broken = TRUE;
+    }
+  else if (!self->broken &&
+	   self->size - used >= ((need > contiguous) ? contiguous + need : need))
+    {
+      /* Records do not wrap, skip the rest of the data area */
+      if (need > contiguous)
+	{
+	  *(guint32 *) (self->data + offset) = SHM_RING_WRAP;
+	  self->head += contiguous;
+	  offset = 0;
+	}
+
+      *(guint32 *) (self->data + offset) = len;
+      memcpy(self->data + offset + sizeof(guint32), data, len);
+      self->head += need;
+      SHM_RING_STORE(&self->header->head, self->head);
+      g_atomic_int_inc(&self->records);
+      retval = TRUE;
+    }
+  g_static_mutex_unlock(&self->write_lock);
+
+  /* Pairs with the consumer setting waiting before its last look at
+     head, one of the two sees the other */
+  if (retval && SHM_RING_FENCED_LOAD(&self->header->waiting))
+    {
+      if (write(self->event_fd, &one, sizeof(one)) == sizeof(one))
+	g_atomic_int_inc(&self->wakeups);
+    }
+
+  return retval;
+}
+
+/*****************************************************************************
+ * Consumer
+ *****************************************************************************/
+
+void shm_ring_attach_consumer(ShmRing *self, GMainContext *context,
+			      ShmRingFunc func, gpointer user_data,
+			      GDestroyNotify notify)
+{
+  ShmRingSource *source = NULL;
+
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail(NULL != self);
+  g_return_if_fail(NULL != func);
+  g_return_if_fail(NULL == self->source);
+
+  self->source = g_source_new(&shm_ring_source_funcs, sizeof(ShmRingSource));
+  source = (ShmRingSource *) self->source;
+  source->ring = shm_ring_ref(self);
+  source->func = func;
+  source->user_data = user_data;
+  source->notify = notify;
+  source->pollfd.fd = self->event_fd;
+  source->pollfd.events = G_IO_IN;
+  g_source_add_poll(self->source, &source->pollfd);
+  g_source_attach(self->source, context);
+
+  whiteboard_log_debug_fe();
+}
+
+void shm_ring_detach_consumer(ShmRing *self)
+{
+  g_return_if_fail(NULL != self);
+
+  if (self->source == NULL)
+    return;
+
+  /* user_data is released in finalize, after a running dispatch */
+  g_source_destroy(self->source);
+  g_source_unref(self->source);
+  self->source = NULL;
+}
+
+void shm_ring_get_statistics(ShmRing *self, guint *records, guint *wakeups,
+			     guint *spin_hits)
+{
+  g_return_if_fail(NULL != self);
+
+  if (records != NULL)
+    *records = (guint) g_atomic_int_get(&self->records);
+  if (wakeups != NULL)
+    *wakeups = (guint) g_atomic_int_get(&self->wakeups);
+  if (spin_hits != NULL)
+    *spin_hits = (guint) g_atomic_int_get(&self->spin_hits);
+}
+
+/*****************************************************************************
+ * Private functions
+ *****************************************************************************/
+
+static gboolean shm_ring_source_prepare(GSource *source, gint *timeout)
+{
+  *timeout = -1;
+
+  return !shm_ring_is_empty(((ShmRingSource *) source)->ring);
+}
+
+static gboolean shm_ring_source_check(GSource *source)
+{
+  ShmRingSource *ring_source = (ShmRingSource *) source;
+  guint64 count = 0;
+
+  if (ring_source->pollfd.revents & G_IO_IN)
+    {
+      if (read(ring_source->pollfd.fd, &count, sizeof(count)) == sizeof(count))
+	g_atomic_int_inc(&ring_source->ring->wakeups);
+    }
+
+  return !shm_ring_is_empty(ring_source->ring);
+}
+
+static gboolean shm_ring_source_dispatch(GSource *source,
+					 GSourceFunc callback,
+					 gpointer user_data)
+{
+  ShmRingSource *ring_source = (ShmRingSource *) source;
+  ShmRing *self = ring_source->ring;
+  const gchar *data = NULL;
+  guint len = 0;
+  guint count = 0;
+
+  /* Awake, producers need not write the eventfd */
+  SHM_RING_STORE(&self->header->waiting, 0);
+
+  for (;;)
+    {
+      while (count < SHM_RING_DEFAULT_QUANTUM &&
+	     shm_ring_peek(self, &data, &len))
+	{
+	  ring_source->func(self, data, len, ring_source->user_data);
+	  shm_ring_consume(self, len);
+	  count++;
+	}
+
+      /* A burst usually continues, spinning briefly saves the wakeup */
+      if (count >= SHM_RING_DEFAULT_QUANTUM || self->broken ||
+	  !shm_ring_spin(self))
+	break;
+    }
+
+  /* Sleep on the eventfd. A record written meanwhile is seen by prepare,
+     the exchange orders this store before the next look at head. */
+  if (count < SHM_RING_DEFAULT_QUANTUM)
+    g_atomic_int_compare_and_exchange((volatile gint *) &self->header->waiting,
+				      0, 1);
+
+  return TRUE;
+}
+
+static void shm_ring_source_finalize(GSource *source)
+{
+  ShmRingSource *ring_source = (ShmRingSource *) source;
+
+  if (ring_source->notify != NULL)
+    ring_source->notify(ring_source->user_data);
+  shm_ring_unref(ring_source->ring);
+}
+
+static gboolean shm_ring_is_empty(ShmRing *self)
+{
+  return self->broken || SHM_RING_LOAD(&self->header->head) == self->tail;
+}
+
+static gboolean shm_ring_peek(ShmRing *self, const gchar **data, guint *len)
+{
+  guint32 used = 0;
+  guint32 offset = 0;
+  guint32 length = 0;
+
+  while (!self->broken)
+    {
+      used = SHM_RING_LOAD(&self->header->head) - self->tail;
+      if (used == 0)
+	return FALSE;
+      if (used > self->size)
+	return shm_ring_corrupted(self);
+
+      offset = self->tail & (self->size - 1);
+      /* Read once, the peer may change the shared copy at any time */
+      length = *(volatile guint32 *) (self->data + offset);
+
+      if (length == SHM_RING_WRAP)
+	{
+	  if (self->size - offset > used)
+	    return shm_ring_corrupted(self);
+
+	  self->tail += self->size - offset;
+	  SHM_RING_STORE(&self->header->tail, self->tail);
+	  continue;
+	}
+
+      if (length > self->size / SHM_RING_MAX_RECORD_DIVISOR ||
+	  SHM_RING_RECORD_SIZE(length) > used ||
+	  SHM_RING_RECORD_SIZE(length) > self->size - offset)
+	return shm_ring_corrupted(self);
+
+      *data = self->data + offset + sizeof(guint32);
+      *len = length;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void shm_ring_consume(ShmRing *self, guint len)
+{
+  self->tail += SHM_RING_RECORD_SIZE(len);
+  SHM_RING_STORE(&self->header->tail, self->tail);
+  g_atomic_int_inc(&self->records);
+}
+
+/**
+ * Poll the ring for a new record for at most SHM_RING_SPIN polls.
+ *
+ * @param self ShmRing instance
+ * @return TRUE if a record arrived
+ */
+static gboolean shm_ring_spin(ShmRing *self)
+{
+  guint i = 0;
+
+  for (i = 0; i < SHM_RING_SPIN; i++)
+    {
+      if (SHM_RING_LOAD(&self->header->head) != self->tail)
+	{
+	  g_atomic_int_inc(&self->spin_hits);
+	  return TRUE;
+	}
+      SHM_RING_CPU_RELAX();
+    }
+
+  return FALSE;
+}
+
+static gboolean shm_ring_corrupted(ShmRing *self)
+{
+  whiteboard_log_warning("Shared memory ring corrupted by the peer\n");
+  self->broken = TRUE;
+
+  return FALSE;
+}
+
+#endif /* SHM_RING_SUPPORTED */
@@ -56,7 +56,7 @@
 #include <whiteboard_util.h>
 
 #include "whiteboard_control.h"
-#include "whiteboard_log.h"
+#include "whiteboard_daemon_log.h"
 
 struct _WhiteBoardControl
 {
@@ -45,7 +45,11 @@
 #include <glib.h>
 #include <stdlib.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #define DBUS_API_SUBJECT_TO_CHANGE
 
@@ -55,13 +59,21 @@
 #include <whiteboard_util.h>
 #include <whiteboard_dbus_ifaces.h>
 #include <whiteboard_node.h>
-#include <whiteboard_log.h>
+#include "whiteboard_daemon_log.h"
 #include <sibmsg.h>
 
 #include "dbushandler.h"
 #include "access_sib.h"
+#include "whiteboard_daemon_ifaces.h"
 #include "whiteboard_sib_handler.h"
 
+#ifndef F_GET_SEALS
+#define F_GET_SEALS (1024 + 10)
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#define F_SEAL_WRITE 0x0008
+#endif
+
 
 typedef struct _JoinData
 {
@@ -69,16 +81,168 @@ typedef struct _JoinData
   gchar *node;
 } JoinData;
 
+/* Handler for a routed node/SIB access message */
+typedef gint (*WhiteBoardSIBHandlerMessageCB)(DBusHandler *context,
+					      WhiteBoardPacket *packet,
+					      gpointer user_data);
+
+/* How a node request over its rate is answered. The request arguments
+   must start with the node id and the SIB uuid. */
+typedef enum
+{
+  MESSAGE_LIMIT_NONE = 0, // not rate limited
+  MESSAGE_LIMIT_ACCESS_ID, // reply is an access id (INT32)
+  MESSAGE_LIMIT_STATUS // reply is a status and a response (INT32, STRING)
+} MessageLimit;
+
+/* Entry of the (message type, member) -> handler dispatch table */
+typedef struct _MessageHandlerEntry
+{
+  gint type;
+  const gchar *member;
+  WhiteBoardSIBHandlerMessageCB handler;
+  MessageLimit limit;
+} MessageHandlerEntry;
+
+/* Token bucket of a node connection or a SIB */
+typedef struct _RateBucket
+{
+  gdouble tokens;
+  gint64 updated; // microseconds since the epoch
+  DBusConnection *connection; // referenced, node buckets only
+} RateBucket;
+
+/* Refill parameters for dropping full buckets */
+typedef struct _BucketSweep
+{
+  gint64 now;
+  guint rate;
+  guint burst;
+} BucketSweep;
+
+/* Interval of dropping full buckets, in microseconds */
+#define RATE_BUCKET_SWEEP_INTERVAL G_GINT64_CONSTANT(10000000)
+
+/* Subscription indications waiting to be delivered to one node connection */
+typedef struct _IndicationBatch
+{
+  WhiteBoardSIBHandler *sib_handler;
+  DBusConnection *connection;
+  GSList *messages; // newest first
+  guint count;
+  guint timeout_id;
+  volatile gint ref_count; // batch_map and the timeout hold a reference
+} IndicationBatch;
+
+/* Node write request (insert/update/remove) waiting for the SIB reply */
+typedef struct _PendingWrite
+{
+  DBusHandler *dbus_handler;
+  WhiteBoardSIBHandler *sib_handler;
+  gchar *sibid; // its cached query results are invalidated on the reply
+  gint access_id;
+  DBusConnection *node_connection;
+  DBusMessage *request;
+  volatile gint replied; // set by the first of libdbus and forward_write
+} PendingWrite;
+
+/* RDF document of a request or result, inline or as a sealed memfd */
+typedef struct _Payload
+{
+  gint type; // DBUS_TYPE_STRING or DBUS_TYPE_UNIX_FD
+  const gchar *string; // owned by the message
+  gint fd; // owned by the payload
+} Payload;
+
+#define PAYLOAD_INIT { DBUS_TYPE_INVALID, NULL, -1 }
+
+/* Largest document read from a file descriptor to be sent inline */
+#define PAYLOAD_MAX_INLINE (16 * 1024 * 1024)
+
+/* Seals a payload memfd must carry, so that it cannot change under us */
+#define PAYLOAD_SEALS (F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW)
+
+/* Query result in the query cache, or a query waiting for its result */
+typedef struct _QueryCacheEntry
+{
+  gchar *key; // SIB uuid, query type and query
+  gchar *sib; // SIB uuid
+  guint generation; // of the SIB when the query was forwarded
+  gchar *results; // NULL while waiting
+  GList *link; // in query_cache_lru
+} QueryCacheEntry;
+
+/* Larger query results are not cached */
+#define QUERY_CACHE_MAX_RESULT (64 * 1024)
+
 struct _WhiteBoardSIBHandler
 {
   DBusHandler *dbus_handler;
-  GList* sib_list; // all registered SIBs 
+  GList* sib_list; // all registered SIBs, in registration order
+
+  // normalized SIB uuid -> AccessSIB, for routing lookups
+  GHashTable *sib_map;
 
   // nodeid -> server URI for joined nodes.
   GHashTable *joined_nodes_map;
 
   // accessid -> JoinData 
   GHashTable *joindata_map;
+
+  // member -> WhiteBoardSIBHandlerMessageCB, one table per message type
+  GHashTable *handler_map[DBUS_NUM_MESSAGE_TYPES];
+
+  // subscription indication batching, disabled when batch_window is 0
+  guint batch_window; // ms
+  guint batch_max;
+
+  // node DBusConnection -> IndicationBatch
+  GHashTable *batch_map;
+
+  // get_sib_list reply for the current sib_list, NULL until requested
+  // after a change
+  DBusMessage *sib_list_reply;
+
+  // request rates per second and bursts, 0 rate for no limit
+  guint node_rate;
+  guint node_burst;
+  guint sib_rate;
+  guint sib_burst;
+
+  // node DBusConnection -> RateBucket, SIB uuid -> RateBucket
+  GHashTable *node_buckets;
+  GHashTable *sib_buckets;
+  gint64 buckets_swept;
+  guint node_rate_limited;
+  guint sib_rate_limited;
+
+  // protects the buckets, kept apart from lock so that admission does
+  // not wait for other handlers
+  GStaticMutex rate_lock;
+
+  // query result cache, disabled when query_cache_max is 0
+  guint query_cache_max;
+
+  // key -> QueryCacheEntry, QueryCacheEntry most recently used first
+  GHashTable *query_cache;
+  GQueue *query_cache_lru;
+
+  // access id -> QueryCacheEntry of a forwarded query
+  GHashTable *pending_queries;
+
+  // SIB uuid -> generation, bumped to invalidate the results of the SIB
+  GHashTable *cache_generations;
+  guint cache_generation;
+  guint query_cache_hits;
+  guint query_cache_misses;
+  guint query_cache_evictions;
+
+  // protects the cache, taken after lock
+  GStaticMutex cache_lock;
+
+  // protects sib_list, sib_map, joined_nodes_map, joindata_map,
+  // batch_map and sib_list_reply, handlers run in several dispatch threads
+  GStaticRecMutex lock;
 };
 
 /* Keep this preprocessor instruction always AFTER struct definitions
@@ -93,6 +257,7 @@ static void whiteboard_sib_handler_dbus_cb(DBusHandler *context, WhiteBoardPacke
 					   gpointer user_data);
 
 static void whiteboard_sib_handler_sib_registered_cb(DBusHandler* context, 
+						      DBusConnection* conn,
 						      gchar* uuid, gchar* name,
 						      gpointer user_data);
 
@@ -100,6 +265,11 @@ static void whiteboard_sib_handler_node_disconnected_cb(DBusHandler* context,
 							gchar* uuid,
 							gpointer user_data);
 
+static void whiteboard_sib_handler_access_expired_cb(DBusHandler *context,
+						     gint access_id,
+						     AccessRoute *route,
+						     gpointer user_data);
+
 static gint whiteboard_sib_handler_handle_method_get_description(DBusHandler *context,
 								 WhiteBoardPacket *packet,
 								 gpointer user_data);
@@ -151,8 +321,74 @@ static gint whiteboard_sib_handler_handle_subscribe_return(DBusHandler *context,
 							   WhiteBoardPacket *packet,
 							   gpointer user_data);
 
-static const gchar *whiteboard_sib_handler_get_sib_by_joined_nodeid(WhiteBoardSIBHandler *self,
-								    const gchar *nodeid);
+static gint whiteboard_sib_handler_handle_method_get_sibs(DBusHandler *context,
+							  WhiteBoardPacket *packet,
+							  gpointer user_data);
+
+static gint whiteboard_sib_handler_handle_method_get_sib_list(DBusHandler *context,
+							      WhiteBoardPacket *packet,
+							      gpointer user_data);
+
+static DBusMessage *whiteboard_sib_handler_build_sib_list(WhiteBoardSIBHandler *self);
+
+static void whiteboard_sib_handler_sibs_changed(WhiteBoardSIBHandler *self);
+
+static gint whiteboard_sib_handler_admit(WhiteBoardSIBHandler *self,
+					 DBusConnection *conn,
+					 DBusMessage *msg);
+
+static RateBucket *whiteboard_sib_handler_bucket_new(guint burst, gint64 now);
+
+static void whiteboard_sib_handler_bucket_free(gpointer data);
+
+static gboolean whiteboard_sib_handler_take_token(RateBucket *bucket,
+						  guint rate,
+						  guint burst,
+						  gint64 now);
+
+static void whiteboard_sib_handler_sweep_buckets(WhiteBoardSIBHandler *self,
+						 gint64 now);
+
+static void whiteboard_sib_handler_statistics_cb(DBusHandler *context,
+						 DBusMessageIter *dict,
+						 gpointer user_data);
+
+static void whiteboard_sib_handler_direct_channel_cb(DBusHandler *context,
+						     const gchar *sibid,
+						     gpointer user_data);
+
+static gint whiteboard_sib_handler_handle_signal_sib_removed(DBusHandler *context,
+							     WhiteBoardPacket *packet,
+							     gpointer user_data);
+
+static gint whiteboard_sib_handler_handle_query_return(DBusHandler *context,
+						       WhiteBoardPacket *packet,
+						       gpointer user_data);
+
+static void whiteboard_sib_handler_create_handler_map(WhiteBoardSIBHandler *self);
+
+static gboolean whiteboard_sib_handler_queue_indication(WhiteBoardSIBHandler *self,
+							DBusConnection *conn,
+							DBusMessage *msg);
+
+static void whiteboard_sib_handler_flush_indications(WhiteBoardSIBHandler *self,
+						     DBusConnection *conn);
+
+static gboolean whiteboard_sib_handler_batch_timeout_cb(gpointer user_data);
+
+static void whiteboard_sib_handler_batch_unref(gpointer data);
+
+static void whiteboard_sib_handler_batch_free(gpointer data);
+
+static gboolean whiteboard_sib_handler_batch_orphaned(gpointer key,
+						      gpointer value,
+						      gpointer user_data);
+
+static AccessSIB *whiteboard_sib_handler_lookup_sib(WhiteBoardSIBHandler *self,
+						   const gchar *uuid);
+
+static gchar *whiteboard_sib_handler_get_sib_by_joined_nodeid(WhiteBoardSIBHandler *self,
+							      const gchar *nodeid);
 
 static void  whiteboard_sib_handler_add_sib_by_joined_nodeid(WhiteBoardSIBHandler *self,
 							     gchar *node,
@@ -166,11 +402,59 @@ static gboolean whiteboard_sib_handler_remove_sib_by_joined_nodeid(WhiteBoardSIB
 static void whiteboard_sib_handler_add_joindata_by_accessid(WhiteBoardSIBHandler *self,
 							    gint accessid,
 							    JoinData *jd);
-static JoinData *whiteboard_sib_handler_get_joindata_by_accessid(WhiteBoardSIBHandler *self,
-								 gint accessid);
+static JoinData *whiteboard_sib_handler_steal_joindata_by_accessid(WhiteBoardSIBHandler *self,
+								   gint accessid);
+
+static gchar *whiteboard_sib_handler_cache_key(WhiteBoardSIBHandler *self,
+					       const gchar *sibid,
+					       gint type,
+					       Payload *request);
+
+static gchar *whiteboard_sib_handler_cache_lookup(WhiteBoardSIBHandler *self,
+						  const gchar *key,
+						  const gchar *sibid);
+
+static void whiteboard_sib_handler_cache_expect(WhiteBoardSIBHandler *self,
+						gint access_id,
+						gchar *key,
+						const gchar *sibid);
+
+static void whiteboard_sib_handler_cache_forget(WhiteBoardSIBHandler *self,
+						gint access_id);
+
+static void whiteboard_sib_handler_cache_store(WhiteBoardSIBHandler *self,
+					       gint access_id,
+					       gint status,
+					       Payload *results);
 
-static gboolean whiteboard_sib_handler_remove_joindata_by_accessid(WhiteBoardSIBHandler* self, gint accessid);
+static void whiteboard_sib_handler_cache_trim(WhiteBoardSIBHandler *self);
 
+static void whiteboard_sib_handler_cache_invalidate(WhiteBoardSIBHandler *self,
+						    const gchar *sibid);
+
+static void whiteboard_sib_handler_cache_invalidate_connection(WhiteBoardSIBHandler *self,
+							       DBusConnection *conn);
+
+static void whiteboard_sib_handler_cache_entry_free(gpointer data);
+
+static gboolean whiteboard_sib_handler_send_result(DBusConnection *node_connection,
+						   const gchar *member,
+						   gint access_id,
+						   gint status,
+						   gchar *subscription_id,
+						   Payload *results);
+
+static gboolean whiteboard_sib_handler_forward_write(DBusHandler *context,
+						     WhiteBoardSIBHandler *sib_handler,
+						     WhiteBoardPacket *packet,
+						     DBusConnection *sib_connection,
+						     const gchar *sibid,
+						     const gchar *member);
+
+static void whiteboard_sib_handler_write_reply_cb(DBusPendingCall *pending,
+						  void *user_data);
+
+static void whiteboard_sib_handler_pending_write_free(void *user_data);
 
 
 /*****************************************************************************
@@ -207,11 +491,57 @@ WhiteBoardSIBHandler *whiteboard_sib_handler_new(DBusHandler *dbus_handler)
 					whiteboard_sib_handler_node_disconnected_cb,
 					self);
 
+  dbushandler_set_callback_access_expired(dbus_handler,
+					  whiteboard_sib_handler_access_expired_cb,
+					  self);
+
+  dbushandler_set_callback_statistics(dbus_handler,
+				      whiteboard_sib_handler_statistics_cb,
+				      self);
+
+  dbushandler_set_callback_direct_channel(dbus_handler,
+					  whiteboard_sib_handler_direct_channel_cb,
+					  self);
+
+  g_static_rec_mutex_init(&self->lock);
+
   self->sib_list = NULL;
+  self->sib_map = g_hash_table_new_full(access_sib_uuid_hash,
+					access_sib_uuid_equal,
+					g_free, NULL);
 
   self->joined_nodes_map = g_hash_table_new_full(g_str_hash, g_str_equal,
 						 g_free, g_free);
   self->joindata_map = g_hash_table_new(g_direct_hash, g_direct_equal);
+  whiteboard_sib_handler_create_handler_map(self);
+
+  self->batch_window = 0;
+  self->batch_max = 1;
+  self->batch_map = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+					  NULL,
+					  whiteboard_sib_handler_batch_free);
+
+  g_static_mutex_init(&self->rate_lock);
+  self->node_buckets = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+					     NULL,
+					     whiteboard_sib_handler_bucket_free);
+  self->sib_buckets = g_hash_table_new_full(access_sib_uuid_hash,
+					    access_sib_uuid_equal,
+					    g_free,
+					    whiteboard_sib_handler_bucket_free);
+
+  g_static_mutex_init(&self->cache_lock);
+  self->query_cache_max = 0;
+  self->query_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+					    NULL,
+					    whiteboard_sib_handler_cache_entry_free);
+  self->query_cache_lru = g_queue_new();
+  self->pending_queries = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+						NULL,
+						whiteboard_sib_handler_cache_entry_free);
+  self->cache_generations = g_hash_table_new_full(access_sib_uuid_hash,
+						  access_sib_uuid_equal,
+						  g_free, NULL);
   if (NULL != self)
     instantiated = TRUE;
 
@@ -223,6 +553,7 @@ WhiteBoardSIBHandler *whiteboard_sib_handler_new(DBusHandler *dbus_handler)
 void whiteboard_sib_handler_destroy(WhiteBoardSIBHandler *self)
 {
   GList* link = NULL;
+  gint i = 0;
 
   whiteboard_log_debug_fb();
 
@@ -232,74 +563,1094 @@ void whiteboard_sib_handler_destroy(WhiteBoardSIBHandler *self)
     access_sib_unref((AccessSIB*)link->data);
 		
   g_list_free(self->sib_list);
+  g_hash_table_destroy(self->sib_map);
+  whiteboard_sib_handler_sibs_changed(self);
 
   g_hash_table_destroy(self->joined_nodes_map);
   
   g_hash_table_destroy(self->joindata_map);
+
+  g_hash_table_destroy(self->batch_map);
+
+  g_hash_table_destroy(self->node_buckets);
+  g_hash_table_destroy(self->sib_buckets);
+  g_static_mutex_free(&self->rate_lock);
+
+  g_queue_free(self->query_cache_lru);
+  g_hash_table_destroy(self->query_cache);
+  g_hash_table_destroy(self->pending_queries);
+  g_hash_table_destroy(self->cache_generations);
+  g_static_mutex_free(&self->cache_lock);
+
+  g_static_rec_mutex_free(&self->lock);
+
+  for (i = 0; i < DBUS_NUM_MESSAGE_TYPES; i++)
+    {
+      if (self->handler_map[i] != NULL)
+	g_hash_table_destroy(self->handler_map[i]);
+    }
   
-  whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
 			"Destroying sib_handler object.\n");
 
-  g_free(self);
+  g_free(self);
+
+  whiteboard_log_debug_fe();
+}
+
+void whiteboard_sib_handler_set_indication_batching(WhiteBoardSIBHandler *self,
+						    guint window,
+						    guint max_count)
+{
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail( NULL != self);
+
+#ifdef HAVE_DBUS_MESSAGE_MARSHAL
+  self->batch_window = window;
+  self->batch_max = MAX(max_count, 1);
+#else
+  if (window > 0)
+    whiteboard_log_warning("Indication batching needs dbus_message_marshal, "
+			   "not available in this build.\n");
+#endif
+
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+			       "Indication batching: window %u ms, max %u\n",
+			       self->batch_window, self->batch_max);
+
+  whiteboard_log_debug_fe();
+}
+
+void whiteboard_sib_handler_set_rate_limits(WhiteBoardSIBHandler *self,
+					    guint node_rate,
+					    guint node_burst,
+					    guint sib_rate,
+					    guint sib_burst)
+{
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail( NULL != self);
+
+  g_static_mutex_lock(&self->rate_lock);
+  self->node_rate = node_rate;
+  self->node_burst = MAX(node_burst, 1);
+  self->sib_rate = sib_rate;
+  self->sib_burst = MAX(sib_burst, 1);
+
+  /* Start over with full buckets */
+  g_hash_table_remove_all(self->node_buckets);
+  g_hash_table_remove_all(self->sib_buckets);
+  g_static_mutex_unlock(&self->rate_lock);
+
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+			       "Rate limits: node %u/s burst %u, "
+			       "SIB %u/s burst %u\n",
+			       self->node_rate, self->node_burst,
+			       self->sib_rate, self->sib_burst);
+
+  whiteboard_log_debug_fe();
+}
+
+void whiteboard_sib_handler_set_query_cache(WhiteBoardSIBHandler *self,
+					    guint max_entries)
+{
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail( NULL != self);
+
+  g_static_mutex_lock(&self->cache_lock);
+  self->query_cache_max = max_entries;
+  whiteboard_sib_handler_cache_trim(self);
+  if (max_entries == 0)
+    g_hash_table_remove_all(self->pending_queries);
+  g_static_mutex_unlock(&self->cache_lock);
+
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+			       "Query cache: %u entries\n", max_entries);
+
+  whiteboard_log_debug_fe();
+}
+
+/*****************************************************************************
+ * Private utilities
+ *****************************************************************************/
+
+static const MessageHandlerEntry whiteboard_sib_handler_handlers[] =
+  {
+    { DBUS_MESSAGE_TYPE_SIGNAL,
+      WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_SIB_REMOVED,
+      whiteboard_sib_handler_handle_signal_sib_removed },
+    { DBUS_MESSAGE_TYPE_SIGNAL,
+      WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_JOIN_COMPLETE,
+      whiteboard_sib_handler_handle_signal_join_complete },
+    { DBUS_MESSAGE_TYPE_SIGNAL,
+      WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_SUBSCRIPTION_IND,
+      whiteboard_sib_handler_handle_signal_subscription_ind },
+    { DBUS_MESSAGE_TYPE_SIGNAL,
+      WHITEBOARD_DBUS_NODE_SIGNAL_UNSUBSCRIBE,
+      whiteboard_sib_handler_handle_unsubscribe },
+    { DBUS_MESSAGE_TYPE_SIGNAL,
+      WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_UNSUBSCRIBE_COMPLETE,
+      whiteboard_sib_handler_handle_unsubscribe_complete },
+
+    { DBUS_MESSAGE_TYPE_METHOD_CALL,
+      WHITEBOARD_DBUS_NODE_METHOD_REFRESH_NODE,
+      whiteboard_sib_handler_handle_method_refresh_node },
+    { DBUS_MESSAGE_TYPE_METHOD_CALL,
+      WHITEBOARD_DBUS_NODE_METHOD_JOIN,
+      whiteboard_sib_handler_handle_join,
+      MESSAGE_LIMIT_ACCESS_ID },
+    { DBUS_MESSAGE_TYPE_METHOD_CALL,
+      WHITEBOARD_DBUS_NODE_METHOD_LEAVE,
+      whiteboard_sib_handler_handle_leave },
+    { DBUS_MESSAGE_TYPE_METHOD_CALL,
+      WHITEBOARD_DBUS_DISCOVERY_METHOD_GET_SIBS,
+      whiteboard_sib_handler_handle_method_get_sibs },
+    { DBUS_MESSAGE_TYPE_METHOD_CALL,
+      WHITEBOARD_DBUS_DISCOVERY_METHOD_GET_SIB_LIST,
+      whiteboard_sib_handler_handle_method_get_sib_list },
+    { DBUS_MESSAGE_TYPE_METHOD_CALL,
+      WHITEBOARD_DBUS_NODE_METHOD_GET_DESCRIPTION,
+      whiteboard_sib_handler_handle_method_get_description },
+    { DBUS_MESSAGE_TYPE_METHOD_CALL,
+      WHITEBOARD_DBUS_NODE_METHOD_INSERT,
+      whiteboard_sib_handler_handle_insert,
+      MESSAGE_LIMIT_STATUS },
+    { DBUS_MESSAGE_TYPE_METHOD_CALL,
+      WHITEBOARD_DBUS_NODE_METHOD_UPDATE,
+      whiteboard_sib_handler_handle_update,
+      MESSAGE_LIMIT_STATUS },
+    { DBUS_MESSAGE_TYPE_METHOD_CALL,
+      WHITEBOARD_DBUS_NODE_METHOD_REMOVE,
+      whiteboard_sib_handler_handle_remove,
+      MESSAGE_LIMIT_STATUS },
+    { DBUS_MESSAGE_TYPE_METHOD_CALL,
+      WHITEBOARD_DBUS_NODE_METHOD_SUBSCRIBE,
+      whiteboard_sib_handler_handle_subscribe_query,
+      MESSAGE_LIMIT_ACCESS_ID },
+    { DBUS_MESSAGE_TYPE_METHOD_CALL,
+      WHITEBOARD_DBUS_NODE_METHOD_QUERY,
+      whiteboard_sib_handler_handle_subscribe_query,
+      MESSAGE_LIMIT_ACCESS_ID },
+
+    { DBUS_MESSAGE_TYPE_METHOD_RETURN,
+      WHITEBOARD_DBUS_SIB_ACCESS_METHOD_SUBSCRIBE,
+      whiteboard_sib_handler_handle_subscribe_return },
+    { DBUS_MESSAGE_TYPE_METHOD_RETURN,
+      WHITEBOARD_DBUS_SIB_ACCESS_METHOD_QUERY,
+      whiteboard_sib_handler_handle_query_return },
+
+    { DBUS_MESSAGE_TYPE_INVALID, NULL, NULL }
+  };
+
+/**
+ * Build the per message type member -> handler tables from
+ * whiteboard_sib_handler_handlers. Called once at creation.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ */
+static void whiteboard_sib_handler_create_handler_map(WhiteBoardSIBHandler *self)
+{
+  const MessageHandlerEntry *entry = NULL;
+
+  for (entry = whiteboard_sib_handler_handlers; entry->member != NULL; entry++)
+    {
+      if (self->handler_map[entry->type] == NULL)
+	self->handler_map[entry->type] = g_hash_table_new(g_str_hash,
+							  g_str_equal);
+
+      g_hash_table_insert(self->handler_map[entry->type],
+			  (gpointer) entry->member,
+			  (gpointer) entry);
+    }
+}
+
+gint whiteboard_sib_handler_get_access_id()
+{
+  static volatile gint whiteboard_sib_handler_id = 0;
+  gint id = 0;
+  gint next = 0;
+
+  /* Access routes take positive ids only */
+  do
+    {
+      id = g_atomic_int_get(&whiteboard_sib_handler_id);
+      next = (id == G_MAXINT) ? 1 : id + 1;
+    }
+  while (!g_atomic_int_compare_and_exchange(&whiteboard_sib_handler_id,
+					    id, next));
+
+  return next;
+}
+
+/**
+ * Find a registered SIB by its UUID (case-insensitive). The returned
+ * instance is referenced, unref it when done.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param uuid UUID of the SIB
+ * @return AccessSIB instance or NULL if not registered
+ */
+static AccessSIB *whiteboard_sib_handler_lookup_sib(WhiteBoardSIBHandler *self,
+						   const gchar *uuid)
+{
+  AccessSIB *source = NULL;
+
+  g_return_val_if_fail(NULL != self, NULL);
+  g_return_val_if_fail(NULL != uuid, NULL);
+
+  g_static_rec_mutex_lock(&self->lock);
+  source = (AccessSIB*) g_hash_table_lookup(self->sib_map, uuid);
+  if (source != NULL)
+    access_sib_ref(source);
+  g_static_rec_mutex_unlock(&self->lock);
+
+  return source;
+}
+
+static void whiteboard_sib_handler_add_sib(WhiteBoardSIBHandler* sib_handler,
+					   DBusConnection* conn, gchar* uuid,
+					   gchar* name)
+{
+  ConnectionSnapshot* connections = NULL;
+  DBusMessage* signal = NULL;
+  AccessSIB* node = NULL;
+  
+  whiteboard_log_debug_fb();
+  
+  g_return_if_fail(NULL != sib_handler);
+  g_return_if_fail(NULL != uuid);
+  g_return_if_fail(NULL != name);
+
+  /* Check if we already have a sink with the given UUID */
+  g_static_rec_mutex_lock(&sib_handler->lock);
+  node = whiteboard_sib_handler_lookup_sib(sib_handler, uuid);
+  if (node == NULL)
+    {
+      /* Create a new node instance and add it to the list and registry */
+      node = access_sib_new(uuid, name);
+      access_sib_set_connection(node, conn);
+      sib_handler->sib_list = g_list_append(sib_handler->sib_list, node);
+      whiteboard_sib_handler_sibs_changed(sib_handler);
+      g_hash_table_insert(sib_handler->sib_map, g_strdup(uuid), node);
+      g_static_rec_mutex_unlock(&sib_handler->lock);
+
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
+			    "Added node: %s, %s\n", uuid, name);
+
+      /* Inform all nodes about a new node */
+      signal = dbus_message_new_signal(WHITEBOARD_DBUS_OBJECT,
+				       WHITEBOARD_DBUS_DISCOVERY_INTERFACE,
+				       WHITEBOARD_DBUS_DISCOVERY_SIGNAL_SIB_INSERTED);
+      if (signal != NULL &&
+	  dbus_message_append_args(signal,
+				   DBUS_TYPE_STRING, &uuid,
+				   DBUS_TYPE_STRING, &name,
+				   DBUS_TYPE_INVALID))
+	{
+	  connections = dbushandler_get_discovery_connections(sib_handler->dbus_handler);
+	  dbushandler_broadcast(sib_handler->dbus_handler, connections, signal);
+	  connection_snapshot_unref(connections);
+	}
+      else
+	{
+	  whiteboard_log_error("Out of memory\n");
+	}
+
+      if (signal != NULL)
+	dbus_message_unref(signal);
+
+    }
+  else
+    {
+      g_static_rec_mutex_unlock(&sib_handler->lock);
+      whiteboard_log_warning("Node %s with UUID[%s] already present.\n", 
+			     name, uuid);
+      /* The SIB access process re-registered, route to the new connection */
+      access_sib_set_connection(node, conn);
+      access_sib_unref(node);
+      whiteboard_sib_handler_cache_invalidate(sib_handler, uuid);
+    }
+  
+  whiteboard_log_debug_fe();
+}
+
+/*****************************************************************************
+ * Query result cache
+ *****************************************************************************/
+
+/**
+ * Build the query cache key of a query to a SIB.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param sibid UUID of the SIB
+ * @param type Query type
+ * @param request Query document
+ * @return Newly allocated key, or NULL if the cache is disabled or the
+ *         query is passed as a file descriptor
+ */
+static gchar *whiteboard_sib_handler_cache_key(WhiteBoardSIBHandler *self,
+					       const gchar *sibid,
+					       gint type,
+					       Payload *request)
+{
+  gchar *sib = NULL;
+  gchar *key = NULL;
+  guint max = 0;
+
+  g_static_mutex_lock(&self->cache_lock);
+  max = self->query_cache_max;
+  g_static_mutex_unlock(&self->cache_lock);
+
+  if (max == 0 || request->type != DBUS_TYPE_STRING)
+    return NULL;
+
+  /* SIB uuids are compared case-insensitively */
+  sib = g_ascii_strdown(sibid, -1);
+  key = g_strdup_printf("%s\n%d\n%s", sib, type, request->string);
+  g_free(sib);
+
+  return key;
+}
+
+/**
+ * Get the current generation of a SIB. Call with cache_lock held.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param sibid UUID of the SIB
+ * @return Generation, results cached in another generation are stale
+ */
+static guint whiteboard_sib_handler_cache_generation(WhiteBoardSIBHandler *self,
+						     const gchar *sibid)
+{
+  return GPOINTER_TO_UINT(g_hash_table_lookup(self->cache_generations, sibid));
+}
+
+/**
+ * Drop a cached result. Call with cache_lock held.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param entry QueryCacheEntry in query_cache
+ */
+static void whiteboard_sib_handler_cache_remove(WhiteBoardSIBHandler *self,
+						QueryCacheEntry *entry)
+{
+  g_queue_delete_link(self->query_cache_lru, entry->link);
+
+  /* Frees the entry */
+  g_hash_table_remove(self->query_cache, entry->key);
+}
+
+/**
+ * Look up the cached result of a query. A stale result is dropped.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param key Key from whiteboard_sib_handler_cache_key
+ * @param sibid UUID of the SIB
+ * @return Copy of the result document, free with g_free, or NULL
+ */
+static gchar *whiteboard_sib_handler_cache_lookup(WhiteBoardSIBHandler *self,
+						  const gchar *key,
+						  const gchar *sibid)
+{
+  QueryCacheEntry *entry = NULL;
+  gchar *results = NULL;
+
+  g_static_mutex_lock(&self->cache_lock);
+  entry = (QueryCacheEntry *) g_hash_table_lookup(self->query_cache, key);
+  if (entry != NULL &&
+      entry->generation != whiteboard_sib_handler_cache_generation(self, sibid))
+    {
+      whiteboard_sib_handler_cache_remove(self, entry);
+      entry = NULL;
+    }
+
+  if (entry != NULL)
+    {
+      g_queue_unlink(self->query_cache_lru, entry->link);
+      g_queue_push_head_link(self->query_cache_lru, entry->link);
+      results = g_strdup(entry->results);
+      self->query_cache_hits++;
+    }
+  else
+    {
+      self->query_cache_misses++;
+    }
+  g_static_mutex_unlock(&self->cache_lock);
+
+  return results;
+}
+
+/**
+ * Remember a query forwarded to a SIB, its result is cached by
+ * whiteboard_sib_handler_cache_store unless the SIB is invalidated first.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param access_id Access id of the query
+ * @param key Key from whiteboard_sib_handler_cache_key, taken over
+ * @param sibid UUID of the SIB
+ */
+static void whiteboard_sib_handler_cache_expect(WhiteBoardSIBHandler *self,
+						gint access_id,
+						gchar *key,
+						const gchar *sibid)
+{
+  QueryCacheEntry *entry = NULL;
+
+  entry = g_new0(QueryCacheEntry, 1);
+  entry->key = key;
+  entry->sib = g_strdup(sibid);
+
+  g_static_mutex_lock(&self->cache_lock);
+  entry->generation = whiteboard_sib_handler_cache_generation(self, sibid);
+  g_hash_table_replace(self->pending_queries, GINT_TO_POINTER(access_id),
+		       entry);
+  g_static_mutex_unlock(&self->cache_lock);
+}
+
+/**
+ * Forget a query that will get no result.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param access_id Access id of the query
+ */
+static void whiteboard_sib_handler_cache_forget(WhiteBoardSIBHandler *self,
+						gint access_id)
+{
+  g_static_mutex_lock(&self->cache_lock);
+  g_hash_table_remove(self->pending_queries, GINT_TO_POINTER(access_id));
+  g_static_mutex_unlock(&self->cache_lock);
+}
+
+/**
+ * Cache the result of a query remembered with
+ * whiteboard_sib_handler_cache_expect. Failed, large and file descriptor
+ * results are not cached, nor results the SIB was invalidated under.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param access_id Access id of the query
+ * @param status Status reported by the SIB
+ * @param results Result document
+ */
+static void whiteboard_sib_handler_cache_store(WhiteBoardSIBHandler *self,
+					       gint access_id,
+					       gint status,
+					       Payload *results)
+{
+  QueryCacheEntry *entry = NULL;
+  QueryCacheEntry *old = NULL;
+
+  g_static_mutex_lock(&self->cache_lock);
+  entry = (QueryCacheEntry *) g_hash_table_lookup(self->pending_queries,
+						   GINT_TO_POINTER(access_id));
+  if (entry != NULL)
+    g_hash_table_steal(self->pending_queries, GINT_TO_POINTER(access_id));
+
+  if (entry != NULL && status == 0 && self->query_cache_max > 0 &&
+      results->type == DBUS_TYPE_STRING &&
+      strlen(results->string) <= QUERY_CACHE_MAX_RESULT &&
+      entry->generation == whiteboard_sib_handler_cache_generation(self,
+								    entry->sib))
+    {
+      old = (QueryCacheEntry *) g_hash_table_lookup(self->query_cache,
+						    entry->key);
+      if (old != NULL)
+	whiteboard_sib_handler_cache_remove(self, old);
+
+      entry->results = g_strdup(results->string);
+      g_queue_push_head(self->query_cache_lru, entry);
+      entry->link = g_queue_peek_head_link(self->query_cache_lru);
+      g_hash_table_insert(self->query_cache, entry->key, entry);
+      whiteboard_sib_handler_cache_trim(self);
+      entry = NULL;
+    }
+  g_static_mutex_unlock(&self->cache_lock);
+
+  if (entry != NULL)
+    whiteboard_sib_handler_cache_entry_free(entry);
+}
+
+/**
+ * Evict the least recently used results over query_cache_max. Call with
+ * cache_lock held.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ */
+static void whiteboard_sib_handler_cache_trim(WhiteBoardSIBHandler *self)
+{
+  while (g_queue_get_length(self->query_cache_lru) > self->query_cache_max)
+    {
+      whiteboard_sib_handler_cache_remove(self,
+					  (QueryCacheEntry *)
+					  g_queue_peek_tail(self->query_cache_lru));
+      self->query_cache_evictions++;
+    }
+}
+
+/**
+ * Invalidate the cached results of a SIB, including the results of
+ * queries still on their way. Stale results are dropped when looked up
+ * or evicted.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param sibid UUID of the SIB
+ */
+static void whiteboard_sib_handler_cache_invalidate(WhiteBoardSIBHandler *self,
+						    const gchar *sibid)
+{
+  g_static_mutex_lock(&self->cache_lock);
+  if (self->query_cache_max > 0)
+    g_hash_table_replace(self->cache_generations, g_strdup(sibid),
+			 GUINT_TO_POINTER(++self->cache_generation));
+  g_static_mutex_unlock(&self->cache_lock);
+}
+
+/**
+ * Invalidate the cached results of the SIBs behind a SIB access
+ * connection.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param conn Connection of the SIB access process
+ */
+static void whiteboard_sib_handler_cache_invalidate_connection(WhiteBoardSIBHandler *self,
+							       DBusConnection *conn)
+{
+  GSList *uuids = NULL;
+  GSList *link = NULL;
+  gboolean is_sib = FALSE;
+  guint max = 0;
+
+  g_static_mutex_lock(&self->cache_lock);
+  max = self->query_cache_max;
+  g_static_mutex_unlock(&self->cache_lock);
+
+  if (max == 0)
+    return;
+
+  /* The connection also carries its unique name, only SIB uuids get
+     a generation */
+  uuids = dbushandler_get_connection_uuids(self->dbus_handler, conn);
+  for (link = uuids; link != NULL; link = link->next)
+    {
+      g_static_rec_mutex_lock(&self->lock);
+      is_sib = (g_hash_table_lookup(self->sib_map, link->data) != NULL);
+      g_static_rec_mutex_unlock(&self->lock);
+
+      if (is_sib)
+	whiteboard_sib_handler_cache_invalidate(self, (gchar *) link->data);
+      g_free(link->data);
+    }
+  g_slist_free(uuids);
+}
+
+static void whiteboard_sib_handler_cache_entry_free(gpointer data)
+{
+  QueryCacheEntry *entry = (QueryCacheEntry *) data;
+
+  g_free(entry->key);
+  g_free(entry->sib);
+  g_free(entry->results);
+  g_free(entry);
+}
+
+/**
+ * Read the routing fields leading every node write request: node id,
+ * SIB id and message number. The rest of the body (encoding and the
+ * triplets) is left untouched, it is forwarded as is.
+ *
+ * @param message The node request
+ * @param nodeid Pointer where the node id is stored, owned by the message
+ * @param sibid Pointer where the SIB id is stored, owned by the message
+ * @param msgnum Pointer where the message number is stored
+ * @return TRUE if the leading fields were present and well typed
+ */
+static gboolean whiteboard_sib_handler_parse_route(DBusMessage *message,
+						   gchar **nodeid,
+						   gchar **sibid,
+						   gint *msgnum)
+{
+  DBusMessageIter iter;
+
+  if(!dbus_message_iter_init(message, &iter) ||
+     dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+    return FALSE;
+  dbus_message_iter_get_basic(&iter, nodeid);
+
+  if(!dbus_message_iter_next(&iter) ||
+     dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+    return FALSE;
+  dbus_message_iter_get_basic(&iter, sibid);
+
+  if(!dbus_message_iter_next(&iter) ||
+     dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_INT32)
+    return FALSE;
+  dbus_message_iter_get_basic(&iter, msgnum);
+
+  return TRUE;
+}
+
+/**
+ * Read an RDF document argument. Documents are passed inline as strings
+ * or, in the large-payload mode, as a sealed memfd.
+ *
+ * @param iter Iterator pointing at the argument
+ * @param payload Payload to fill, clear it with
+ *        whiteboard_sib_handler_payload_clear
+ * @return TRUE if the argument was a string or a file descriptor
+ */
+static gboolean whiteboard_sib_handler_get_payload(DBusMessageIter *iter,
+						   Payload *payload)
+{
+  payload->type = dbus_message_iter_get_arg_type(iter);
+  switch (payload->type)
+    {
+    case DBUS_TYPE_STRING:
+      dbus_message_iter_get_basic(iter, &payload->string);
+      return TRUE;
+#ifdef HAVE_DBUS_UNIX_FD
+    case DBUS_TYPE_UNIX_FD:
+      /* libdbus hands out a duplicate, closed in payload_clear */
+      dbus_message_iter_get_basic(iter, &payload->fd);
+      return TRUE;
+#endif
+    default:
+      payload->type = DBUS_TYPE_INVALID;
+      return FALSE;
+    }
+}
+
+static void whiteboard_sib_handler_payload_clear(Payload *payload)
+{
+#ifdef HAVE_DBUS_UNIX_FD
+  if (payload->type == DBUS_TYPE_UNIX_FD && payload->fd >= 0)
+    close(payload->fd);
+#endif
+
+  payload->type = DBUS_TYPE_INVALID;
+  payload->string = NULL;
+  payload->fd = -1;
+}
+
+/**
+ * Read the whole document behind a payload file descriptor. Used only for
+ * peers that cannot receive file descriptors. The descriptor must be a
+ * memfd sealed with PAYLOAD_SEALS and at most PAYLOAD_MAX_INLINE bytes.
+ *
+ * @param fd File descriptor of the document
+ * @return newly allocated UTF-8 document or NULL on failure
+ */
+static gchar *whiteboard_sib_handler_payload_read_fd(gint fd)
+{
+  struct stat st;
+  gchar *buf = NULL;
+  gsize size = 0;
+  gsize done = 0;
+  ssize_t n = 0;
+  gint seals = 0;
+
+  /* Unsealed, the sender could resize the file between fstat and pread */
+  seals = fcntl(fd, F_GET_SEALS);
+  if (seals < 0 || (seals & PAYLOAD_SEALS) != PAYLOAD_SEALS)
+    {
+      whiteboard_log_warning("Payload file descriptor is not a sealed memfd\n");
+      return NULL;
+    }
+
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size < 0)
+    return NULL;
+
+  if (st.st_size > PAYLOAD_MAX_INLINE)
+    {
+      whiteboard_log_warning("Payload of %ld bytes too large to send inline\n",
+			     (glong) st.st_size);
+      return NULL;
+    }
+
+  size = (gsize) st.st_size;
+  buf = g_try_malloc(size + 1);
+  if (buf == NULL)
+    {
+      whiteboard_log_error("Out of memory\n");
+      return NULL;
+    }
+  while (done < size)
+    {
+      n = pread(fd, buf + done, size - done, done);
+      if (n < 0 && errno == EINTR)
+	continue;
+      if (n <= 0)
+	break;
+      done += n;
+    }
+  buf[done] = '\0';
+
+  if (done < size || !g_utf8_validate(buf, done, NULL))
+    {
+      g_free(buf);
+      return NULL;
+    }
+
+  return buf;
+}
+
+/**
+ * Append an RDF document argument for the given peer. A file descriptor
+ * is passed on as is; peers that cannot receive file descriptors get the
+ * document inline instead.
+ *
+ * @param iter Append iterator of the outgoing message
+ * @param target Connection the message is sent to
+ * @param payload Payload from whiteboard_sib_handler_get_payload
+ * @return TRUE if the argument was appended
+ */
+static gboolean whiteboard_sib_handler_append_payload(DBusMessageIter *iter,
+						      DBusConnection *target,
+						      Payload *payload)
+{
+  gboolean retval = FALSE;
+  gchar *document = NULL;
+
+#ifdef HAVE_DBUS_UNIX_FD
+  if (payload->type == DBUS_TYPE_UNIX_FD)
+    {
+      if (dbus_connection_can_send_type(target, DBUS_TYPE_UNIX_FD))
+	return dbus_message_iter_append_basic(iter, DBUS_TYPE_UNIX_FD,
+					      &payload->fd);
+
+      document = whiteboard_sib_handler_payload_read_fd(payload->fd);
+      if (document == NULL)
+	{
+	  whiteboard_log_warning("Could not read payload file descriptor\n");
+	  return FALSE;
+	}
+      retval = dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING,
+					      &document);
+      g_free(document);
+      return retval;
+    }
+#endif
+
+  return dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING,
+					&payload->string);
+}
+
+#ifdef HAVE_DBUS_UNIX_FD
+/**
+ * Copy a signal carrying payload file descriptors for a peer that cannot
+ * receive them, the documents are read and appended inline. Only signals
+ * with basic type arguments can be copied.
+ *
+ * @param message Signal to copy
+ * @param target Connection the copy is sent to
+ * @return The copy or NULL on failure
+ */
+static DBusMessage *whiteboard_sib_handler_inline_payloads(DBusMessage *message,
+							   DBusConnection *target)
+{
+  DBusMessage *copy = NULL;
+  DBusMessageIter in;
+  DBusMessageIter out;
+  Payload payload = PAYLOAD_INIT;
+  union
+  {
+    dbus_uint64_t u64;
+    double dbl;
+    const char *str;
+  } value;
+  gint type = DBUS_TYPE_INVALID;
+  gboolean retval = TRUE;
+
+  copy = dbus_message_new_signal(dbus_message_get_path(message),
+				 dbus_message_get_interface(message),
+				 dbus_message_get_member(message));
+  if (copy == NULL)
+    return NULL;
+
+  dbus_message_iter_init_append(copy, &out);
+  if (dbus_message_iter_init(message, &in))
+    {
+      do
+	{
+	  type = dbus_message_iter_get_arg_type(&in);
+	  if (type == DBUS_TYPE_UNIX_FD)
+	    {
+	      retval = (whiteboard_sib_handler_get_payload(&in, &payload) &&
+			whiteboard_sib_handler_append_payload(&out, target,
+							      &payload));
+	      whiteboard_sib_handler_payload_clear(&payload);
+	    }
+	  else if (dbus_type_is_basic(type))
+	    {
+	      dbus_message_iter_get_basic(&in, &value);
+	      retval = dbus_message_iter_append_basic(&out, type, &value);
+	    }
+	  else
+	    {
+	      retval = FALSE;
+	    }
+	}
+      while (retval && dbus_message_iter_next(&in));
+    }
+
+  if (!retval)
+    {
+      dbus_message_unref(copy);
+      return NULL;
+    }
+
+  return copy;
+}
+#endif
+
+/**
+ * Parse a query or subscribe request: the routing fields, the query type
+ * and the query document.
+ *
+ * @param message The node request
+ * @param nodeid Pointer where the node id is stored, owned by the message
+ * @param sibid Pointer where the SIB id is stored, owned by the message
+ * @param msgnum Pointer where the message number is stored
+ * @param type Pointer where the query type is stored
+ * @param request Payload to fill with the query document
+ * @return TRUE if the request was well formed
+ */
+static gboolean whiteboard_sib_handler_parse_request(DBusMessage *message,
+						     gchar **nodeid,
+						     gchar **sibid,
+						     gint *msgnum,
+						     gint *type,
+						     Payload *request)
+{
+  DBusMessageIter iter;
+  gint i = 0;
+
+  if(!whiteboard_sib_handler_parse_route(message, nodeid, sibid, msgnum))
+    return FALSE;
+
+  /* Skip the routing fields */
+  dbus_message_iter_init(message, &iter);
+  for(i = 0; i < 3; i++)
+    dbus_message_iter_next(&iter);
+
+  if(dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_INT32)
+    return FALSE;
+  dbus_message_iter_get_basic(&iter, type);
+
+  if(!dbus_message_iter_next(&iter))
+    return FALSE;
+
+  return whiteboard_sib_handler_get_payload(&iter, request);
+}
+
+/**
+ * Forward a write request (insert/update/remove) to a SIB access process
+ * without blocking the main loop. The SIB methods take the same arguments
+ * as the node methods, so the node request is copied and only its header
+ * is rewritten; the payload is never unmarshalled. The node request is
+ * answered from whiteboard_sib_handler_write_reply_cb when the SIB replies.
+ * The access id associated here routes the reply back to the requesting
+ * node.
+ *
+ * @param context DBusHandler instance
+ * @param sib_handler WhiteBoardSIBHandler instance
+ * @param packet The node request
+ * @param sib_connection Connection of the SIB access process
+ * @param sibid UUID of the SIB, its cached query results are invalidated
+ * @param member Method name used towards the SIB access process
+ * @return TRUE if the request is pending or was refused with
+ *         WHITEBOARD_STATUS_OVERLOADED, FALSE if it could not be sent
+ */
+static gboolean whiteboard_sib_handler_forward_write(DBusHandler *context,
+						     WhiteBoardSIBHandler *sib_handler,
+						     WhiteBoardPacket *packet,
+						     DBusConnection *sib_connection,
+						     const gchar *sibid,
+						     const gchar *member)
+{
+  DBusMessage *msg = NULL;
+  DBusPendingCall *pending_call = NULL;
+  PendingWrite *pw = NULL;
+  gboolean retval = FALSE;
+  guint timeout = 0;
+  gint status = WHITEBOARD_STATUS_OVERLOADED;
+  const gchar *response = "Overloaded";
+
+  whiteboard_log_debug_fb();
+
+#ifdef HAVE_DBUS_UNIX_FD
+  /* The payload is forwarded untouched, the SIB access process must
+     accept it as sent */
+  if(dbus_message_contains_unix_fds(packet->message) &&
+     !dbus_connection_can_send_type(sib_connection, DBUS_TYPE_UNIX_FD))
+    {
+      whiteboard_log_warning("SIB access does not accept file descriptors, "
+			     "cannot forward %s\n", member);
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+#endif
+
+  if(!dbushandler_sib_can_send(context, sib_connection))
+    {
+      whiteboard_log_warning("SIB access overloaded, refusing %s\n", member);
+      whiteboard_util_send_method_return(packet->connection, packet->message,
+					 DBUS_TYPE_INT32, &status,
+					 DBUS_TYPE_STRING, &response,
+					 WHITEBOARD_UTIL_LIST_END);
+      whiteboard_log_debug_fe();
+      return TRUE;
+    }
+
+  /* The copy shares no state with the request and gets a fresh serial
+     when sent, the body is duplicated as a single block */
+  msg = dbus_message_copy(packet->message);
+  if(NULL == msg)
+    {
+      whiteboard_log_error("Out of memory\n");
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+
+  retval = (dbus_message_set_destination(msg, WHITEBOARD_DBUS_SERVICE) &&
+	    dbus_message_set_path(msg, WHITEBOARD_DBUS_OBJECT) &&
+	    dbus_message_set_interface(msg, WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE) &&
+	    dbus_message_set_member(msg, member) &&
+	    dbus_message_set_sender(msg, NULL));
+  dbus_message_set_no_reply(msg, FALSE);
+
+  if(retval)
+    {
+      pw = g_new0(PendingWrite, 1);
+      pw->dbus_handler = context;
+      pw->sib_handler = sib_handler;
+      pw->sibid = g_strdup(sibid);
+      pw->access_id = dbushandler_new_access_id(context);
+      pw->node_connection = dbus_connection_ref(packet->connection);
+      pw->request = dbus_message_ref(packet->message);
+
+      /* Associate before sending so that the reply always finds the node */
+      dbushandler_associate_access_id(context, pw->access_id,
+				      packet->connection, sib_connection,
+				      ACCESS_ROUTE_OP_WRITE);
+
+      /* Queries answered from now on may or may not see the write, the
+	 reply invalidates again */
+      whiteboard_sib_handler_cache_invalidate(sib_handler, sibid);
+
+      /* libdbus fails the call on timeout or when the SIB access
+	 process disconnects */
+      timeout = dbushandler_get_access_timeout(context);
+      retval = dbus_connection_send_with_reply(sib_connection, msg,
+					       &pending_call,
+					       (timeout > 0) ? (gint) timeout : -1);
+    }
+
+  if(retval && NULL != pending_call)
+    {
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+			    "%s forwarded with access_id: %d\n",
+			    member, pw->access_id);
+
+      dbus_pending_call_set_notify(pending_call,
+				   whiteboard_sib_handler_write_reply_cb,
+				   pw,
+				   whiteboard_sib_handler_pending_write_free);
+
+      /* A worker thread dispatching the SIB connection may have
+	 completed the call before the notify was set, libdbus does not
+	 call it then. Our reference keeps pw alive until the unref. */
+      if(dbus_pending_call_get_completed(pending_call))
+	whiteboard_sib_handler_write_reply_cb(pending_call, pw);
+      dbus_pending_call_unref(pending_call);
+    }
+  else
+    {
+      whiteboard_log_warning("Could not send %s to SIB access\n", member);
+      if(NULL != pw)
+	{
+	  dbushandler_invalidate_access_id(context, pw->access_id);
+	  whiteboard_sib_handler_pending_write_free(pw);
+	}
+      retval = FALSE;
+    }
+
+  dbus_message_unref(msg);
 
   whiteboard_log_debug_fe();
-}
-
-/*****************************************************************************
- * Private utilities
- *****************************************************************************/
 
-gint whiteboard_sib_handler_get_access_id()
-{
-  static gint whiteboard_sib_handler_id = 0;
-  
-  return ++whiteboard_sib_handler_id;
+  return retval;
 }
 
-static void whiteboard_sib_handler_add_sib(WhiteBoardSIBHandler* sib_handler, gchar* uuid,
-					    gchar* name)
+static void whiteboard_sib_handler_write_reply_cb(DBusPendingCall *pending_call,
+						  void *user_data)
 {
-  GList* list = NULL;
-  AccessSIB* node = NULL;
-  
+  PendingWrite *pw = (PendingWrite *) user_data;
+  DBusMessage *reply = NULL;
+  DBusConnection *node_connection = NULL;
+  gint response_success = -1;
+  gchar *response = NULL;
+
   whiteboard_log_debug_fb();
-  
-  g_return_if_fail(NULL != sib_handler);
-  g_return_if_fail(NULL != uuid);
-  g_return_if_fail(NULL != name);
 
-  /* Check if we already have a sink with the given UUID */
-  list = g_list_find_custom(sib_handler->sib_list, uuid, 
-			    access_sib_compare_id);
-  if (list == NULL)
+  if(!g_atomic_int_compare_and_exchange(&pw->replied, 0, 1))
     {
-      /* Create a new node instance and add it to the list */
-      node = access_sib_new(uuid, name);
-      sib_handler->sib_list = g_list_append(sib_handler->sib_list, node);
+      whiteboard_log_debug_fe();
+      return;
+    }
 
-      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
-			    "Added node: %s, %s\n", uuid, name);
+  reply = dbus_pending_call_steal_reply(pending_call);
 
-      /* Inform all nodes about a new node */
-      list = dbushandler_get_discovery_connections(sib_handler->dbus_handler);
-      whiteboard_util_send_signal_to_list(WHITEBOARD_DBUS_OBJECT,
-					  WHITEBOARD_DBUS_DISCOVERY_INTERFACE,
-					  WHITEBOARD_DBUS_DISCOVERY_SIGNAL_SIB_INSERTED,
-					  list,
-					  DBUS_TYPE_STRING, &uuid,
-					  DBUS_TYPE_STRING, &name,
-					  WHITEBOARD_UTIL_LIST_END);
+  if( (NULL == reply) ||
+      (dbus_message_get_type(reply) != DBUS_MESSAGE_TYPE_METHOD_RETURN) ||
+      !whiteboard_util_parse_message(reply,
+				     DBUS_TYPE_INT32, &response_success,
+				     DBUS_TYPE_STRING, &response,
+				     WHITEBOARD_UTIL_LIST_END) )
+    {
+      whiteboard_log_warning("No reply or could not parse reply, access_id: %d\n",
+			     pw->access_id);
+      response_success = -1;
+      response = "Fail";
+    }
 
+  /* Also after a failure, the SIB may have applied part of the write */
+  whiteboard_sib_handler_cache_invalidate(pw->sib_handler, pw->sibid);
+
+  /* The access id may have been reclaimed with the SIB access connection,
+     the node still gets its reply */
+  node_connection = pw->node_connection;
+  if(dbus_connection_get_is_connected(node_connection))
+    {
+      whiteboard_util_send_method_return(node_connection, pw->request,
+					 DBUS_TYPE_INT32, &response_success,
+					 DBUS_TYPE_STRING, &response,
+					 WHITEBOARD_UTIL_LIST_END);
     }
   else
     {
-      whiteboard_log_warning("Node %s with UUID[%s] already present.\n", 
-			     name, uuid);
+      whiteboard_log_debug("Node for access_id %d gone, dropping reply\n",
+			   pw->access_id);
     }
-  
+
+  dbushandler_invalidate_access_id(pw->dbus_handler, pw->access_id);
+
+  if(reply)
+    dbus_message_unref(reply);
+
   whiteboard_log_debug_fe();
 }
 
+static void whiteboard_sib_handler_pending_write_free(void *user_data)
+{
+  PendingWrite *pw = (PendingWrite *) user_data;
+
+  dbus_connection_unref(pw->node_connection);
+  dbus_message_unref(pw->request);
+  g_free(pw->sibid);
+  g_free(pw);
+}
+
 /*****************************************************************************
  * DBus message handlers
  *****************************************************************************/
@@ -345,7 +1696,7 @@ static gint whiteboard_sib_handler_handle_method_refresh_node(DBusHandler *conte
 							      WhiteBoardPacket *packet,
 							      gpointer user_data)
 {	
- GList* connections = NULL;
+ ConnectionSnapshot* connections = NULL;
   
   whiteboard_log_debug_fb();
   
@@ -353,7 +1704,8 @@ static gint whiteboard_sib_handler_handle_method_refresh_node(DBusHandler *conte
   
   connections = dbushandler_get_control_connections(context);
   
-  whiteboard_util_send_message_to_list(connections, packet->message);
+  dbushandler_broadcast(context, connections, packet->message);
+  connection_snapshot_unref(connections);
   
   whiteboard_log_debug_fe();
   
@@ -367,6 +1719,7 @@ static gint whiteboard_sib_handler_handle_method_get_sibs(DBusHandler *context,
   WhiteBoardSIBHandler *sib_handler = NULL;
   gchar* uuid = NULL;
   gchar* name = NULL;
+  GList* sibs = NULL;
   GList* link = NULL;
   AccessSIB* source = NULL;
   
@@ -376,27 +1729,32 @@ static gint whiteboard_sib_handler_handle_method_get_sibs(DBusHandler *context,
   g_return_val_if_fail( user_data != NULL, -1);
   
   sib_handler = (WhiteBoardSIBHandler*) user_data;
+
+  /* Take a referenced snapshot so the registry is not locked while
+     signals are sent */
+  g_static_rec_mutex_lock(&sib_handler->lock);
+  sibs = g_list_copy(sib_handler->sib_list);
+  g_list_foreach(sibs, (GFunc) access_sib_ref, NULL);
+  g_static_rec_mutex_unlock(&sib_handler->lock);
   
-  for (link = g_list_first(sib_handler->sib_list); 
+  for (link = g_list_first(sibs); 
        link != NULL; link = link->next)
     {
       source = (AccessSIB*) link->data;
-      access_sib_ref(source);
 		
       if (access_sib_get_name(source, &name) == FALSE)
 	{
 	  whiteboard_log_error("Source name is NULL\n");
-	  return -1;
+	  continue;
 	}
       if (access_sib_get_uuid(source, &uuid) == FALSE)
 	{
 	  whiteboard_log_error("Source uuid is NULL\n");
 	  g_free(name);
-	  return -1;
+	  continue;
 	}
-      access_sib_unref(source);
 
-      whiteboard_log_debugc(WHITEBOARD_DEBUG_NODE,
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_NODE,
 			    "Signaling sib %s\n", name);
 	  
       /* Send SIB as a signal to the requesting NODE */
@@ -411,6 +1769,9 @@ static gint whiteboard_sib_handler_handle_method_get_sibs(DBusHandler *context,
       g_free(uuid);
 	  
     } 
+  g_list_foreach(sibs, (GFunc) access_sib_unref, NULL);
+  g_list_free(sibs);
+
   /* Send SIB as a signal to the requesting NODE */
   whiteboard_util_send_signal(WHITEBOARD_DBUS_OBJECT,
 			      WHITEBOARD_DBUS_DISCOVERY_INTERFACE,
@@ -422,14 +1783,139 @@ static gint whiteboard_sib_handler_handle_method_get_sibs(DBusHandler *context,
   return 1;
 }
 
+static gint whiteboard_sib_handler_handle_method_get_sib_list(DBusHandler *context,
+							      WhiteBoardPacket *packet,
+							      gpointer user_data)
+{
+  WhiteBoardSIBHandler *sib_handler = NULL;
+  DBusMessage *reply = NULL;
+  const gchar *sender = NULL;
+
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail( context != NULL, -1);
+  g_return_val_if_fail( user_data != NULL, -1);
+
+  sib_handler = (WhiteBoardSIBHandler*) user_data;
+
+  g_static_rec_mutex_lock(&sib_handler->lock);
+  if (sib_handler->sib_list_reply == NULL)
+    sib_handler->sib_list_reply =
+      whiteboard_sib_handler_build_sib_list(sib_handler);
+
+  /* Copying the cached reply copies the marshalled body as is, only the
+     header fields of this call are filled in */
+  if (sib_handler->sib_list_reply != NULL)
+    reply = dbus_message_copy(sib_handler->sib_list_reply);
+  g_static_rec_mutex_unlock(&sib_handler->lock);
+
+  if (reply == NULL ||
+      !dbus_message_set_reply_serial(reply,
+				     dbus_message_get_serial(packet->message)))
+    {
+      whiteboard_log_error("Out of memory\n");
+      if (reply != NULL)
+	dbus_message_unref(reply);
+      whiteboard_log_debug_fe();
+      return -1;
+    }
+
+  sender = dbus_message_get_sender(packet->message);
+  if (sender != NULL)
+    dbus_message_set_destination(reply, sender);
+
+  dbus_connection_send(packet->connection, reply, NULL);
+  dbus_message_unref(reply);
+
+  whiteboard_log_debug_fe();
+
+  return 1;
+}
+
+/**
+ * Build the get_sib_list reply for the registered SIBs. The reply has no
+ * reply serial or destination, it is copied for each call. Call with the
+ * lock held.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @return new method return message or NULL if out of memory
+ */
+static DBusMessage *whiteboard_sib_handler_build_sib_list(WhiteBoardSIBHandler *self)
+{
+  DBusMessage *reply = NULL;
+  DBusMessageIter iter;
+  DBusMessageIter array;
+  DBusMessageIter entry;
+  AccessSIB *source = NULL;
+  GList *link = NULL;
+  gchar *uuid = NULL;
+  gchar *name = NULL;
+
+  reply = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+  if (reply == NULL)
+    return NULL;
+  dbus_message_set_no_reply(reply, TRUE);
+
+  dbus_message_iter_init_append(reply, &iter);
+  dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+				   DBUS_STRUCT_BEGIN_CHAR_AS_STRING
+				   DBUS_TYPE_STRING_AS_STRING
+				   DBUS_TYPE_STRING_AS_STRING
+				   DBUS_STRUCT_END_CHAR_AS_STRING,
+				   &array);
+  for (link = self->sib_list; link != NULL; link = link->next)
+    {
+      source = (AccessSIB *) link->data;
+
+      if (!access_sib_get_uuid(source, &uuid))
+	continue;
+      if (!access_sib_get_name(source, &name))
+	{
+	  g_free(uuid);
+	  continue;
+	}
+
+      dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT,
+				       NULL, &entry);
+      dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &uuid);
+      dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &name);
+      dbus_message_iter_close_container(&array, &entry);
+
+      g_free(uuid);
+      g_free(name);
+    }
+  dbus_message_iter_close_container(&iter, &array);
+
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+			       "Built sib list of %u SIBs\n",
+			       g_list_length(self->sib_list));
+
+  return reply;
+}
+
+/**
+ * Drop the cached get_sib_list reply after the registry changed. Call
+ * with the lock held.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ */
+static void whiteboard_sib_handler_sibs_changed(WhiteBoardSIBHandler *self)
+{
+  if (self->sib_list_reply != NULL)
+    {
+      dbus_message_unref(self->sib_list_reply);
+      self->sib_list_reply = NULL;
+    }
+}
+
 static gint whiteboard_sib_handler_handle_signal_sib_removed(DBusHandler *context,
 							      WhiteBoardPacket *packet,
 							      gpointer user_data)
 {
   gchar* uuid = NULL;
-  GList* list = NULL;
+  AccessSIB *source = NULL;
   WhiteBoardSIBHandler* sib_handler = NULL;
-  GList* connections = NULL;
+  ConnectionSnapshot* connections = NULL;
   GList* joined_nodes = NULL;
   GList* link = NULL;
   whiteboard_log_debug_fb();
@@ -445,12 +1931,12 @@ static gint whiteboard_sib_handler_handle_signal_sib_removed(DBusHandler *contex
 				WHITEBOARD_UTIL_LIST_END);
   
   /* Remove the source from internal data structures */
-  list = g_list_find_custom(sib_handler->sib_list, uuid,
-			    access_sib_compare_id);
+  g_static_rec_mutex_lock(&sib_handler->lock);
+  source = whiteboard_sib_handler_lookup_sib(sib_handler, uuid);
   
   dbushandler_remove_connection_by_uuid(context, uuid);
   
-  if (list == NULL)
+  if (source == NULL)
     {
       whiteboard_log_warning("Node %s not found. Cannot remove, probably it's a control connection\n",
 			     uuid);
@@ -458,28 +1944,42 @@ static gint whiteboard_sib_handler_handle_signal_sib_removed(DBusHandler *contex
   else
     {
       // Remove associations between removed SIB and joined nodes.
-      joined_nodes = access_sib_get_joined_nodes((AccessSIB*)list->data);
+      joined_nodes = access_sib_get_joined_nodes(source);
       
       for( link=g_list_first(joined_nodes); link != NULL; link = link->next)
 	{
 	  whiteboard_sib_handler_remove_sib_by_joined_nodeid(sib_handler, (gchar *)link->data);
+	  dbushandler_close_direct_channel(context, (gchar *)link->data, uuid);
 	}
+      g_list_foreach(joined_nodes, (GFunc) g_free, NULL);
+      g_list_free(joined_nodes);
       
-      sib_handler->sib_list = g_list_remove_link(sib_handler->sib_list,
-						  list);
+      access_sib_set_connection(source, NULL);
+      g_hash_table_remove(sib_handler->sib_map, uuid);
+      sib_handler->sib_list = g_list_remove(sib_handler->sib_list,
+					     source);
+      whiteboard_sib_handler_sibs_changed(sib_handler);
+
+      g_static_mutex_lock(&sib_handler->rate_lock);
+      g_hash_table_remove(sib_handler->sib_buckets, uuid);
+      g_static_mutex_unlock(&sib_handler->rate_lock);
+
+      whiteboard_sib_handler_cache_invalidate(sib_handler, uuid);
       
-      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
 			    "Removing node %s\n", uuid);
       
       
-      access_sib_unref((AccessSIB*)list->data);
-      
-      g_list_free(list);
+      /* Registry reference and lookup reference */
+      access_sib_unref(source);
+      access_sib_unref(source);
     }
+  g_static_rec_mutex_unlock(&sib_handler->lock);
   
   /* Then send signal to all NODEs */
   connections = dbushandler_get_discovery_connections(context);
-  whiteboard_util_send_message_to_list(connections, packet->message);
+  dbushandler_broadcast(context, connections, packet->message);
+  connection_snapshot_unref(connections);
 
   return 1;
 }
@@ -492,8 +1992,6 @@ static gint whiteboard_sib_handler_handle_join(DBusHandler *context,
   gchar* udn = NULL;
   gchar* nodeid = NULL;
   //apr09obsolete gchar *username = NULL;
-  gchar *uuid=NULL;
-  GList* list = NULL;
   gint join_id = -1;
   gint msgnum=0;
   AccessSIB *source = NULL;
@@ -521,11 +2019,10 @@ static gint whiteboard_sib_handler_handle_join(DBusHandler *context,
   whiteboard_log_debug("msgnum: %d\n", msgnum);
   
   /* find the source from internal data structures */
-  list = g_list_find_custom(sib_handler->sib_list, udn,
-			    access_sib_compare_id);
+  source = whiteboard_sib_handler_lookup_sib(sib_handler, udn);
   
   
-  if (list == NULL)
+  if (source == NULL)
     {
       whiteboard_log_warning("SIB %s not found. Cannot join.\n",
 			     udn);
@@ -533,86 +2030,80 @@ static gint whiteboard_sib_handler_handle_join(DBusHandler *context,
     }
   else
     {
-      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
 			    "Node %s joining SIB %s\n", nodeid,udn);
-      source = (AccessSIB*) list->data;
-      access_sib_ref(source);
 
-      if (!access_sib_get_uuid(source, &uuid) )
-	{
-	  whiteboard_log_error("Could not get uuid\n");
-	  access_sib_unref(source);
-	  retval=FALSE;
-	  //return -1;
-	}
-      else
+      conn = access_sib_get_connection(source);
+
+      if( NULL != conn)
 	{
-	  conn = dbushandler_get_connection_by_uuid(context,
-						    uuid);
-	  if(uuid)
+	  // check that the SIB keeps up and the node is not already
+	  // joined, the lock keeps a concurrent join of the same node out
+	  // until the node is registered
+	  g_static_rec_mutex_lock(&sib_handler->lock);
+	  if( FALSE == dbushandler_sib_can_send(context, conn) )
 	    {
-	      g_free(uuid);
-	      uuid=NULL;
+	      g_static_rec_mutex_unlock(&sib_handler->lock);
+	      whiteboard_log_warning("SIB %s overloaded, refusing join\n", udn);
+	      access_sib_unref(source);
+	      join_id = WHITEBOARD_STATUS_OVERLOADED;
+	      retval = FALSE;
 	    }
-	  
-	  if( NULL != conn)
+	  else if( ( FALSE == access_sib_is_node_joined(source, nodeid) ) &&
+		   ( NULL == g_hash_table_lookup(sib_handler->joined_nodes_map, nodeid) ) )
 	    {
-	      // check that not already joined
-	      if( ( FALSE == access_sib_is_node_joined(source, nodeid) ) &&
-		  ( NULL == whiteboard_sib_handler_get_sib_by_joined_nodeid(sib_handler, nodeid) ) )
-		{
-		  join_id = whiteboard_sib_handler_get_access_id();
-		  
-		  dbushandler_set_node_connection_with_access_id( context,
-								join_id,
-								packet->connection);
-		  dbushandler_set_sib_connection_with_access_id( context,
-								  join_id,
-								  conn);
-		  
-		  
-		  whiteboard_util_send_signal(WHITEBOARD_DBUS_OBJECT,
-					      WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
-					      WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_JOIN,
-					      conn,
-					      DBUS_TYPE_INT32, &join_id,
-					      //apr09obsolete DBUS_TYPE_STRING, &username,
-					      DBUS_TYPE_STRING, &nodeid,
-					      DBUS_TYPE_STRING, &udn,
-					      DBUS_TYPE_INT32, &msgnum,
-					      WHITEBOARD_UTIL_LIST_END);
-		  access_sib_add_to_joined_nodes(source, nodeid);
-		  access_sib_unref(source);
-		  
-		  whiteboard_sib_handler_add_sib_by_joined_nodeid(sib_handler, nodeid, udn);
-
-		  JoinData *jd = g_new0(JoinData,1);
-		  jd->sib = g_strdup(udn);
-		  jd->node = g_strdup(nodeid);
-		  whiteboard_sib_handler_add_joindata_by_accessid(sib_handler, join_id, jd);
-		  retval = TRUE;
-		}
-	      else
-		{
-		  whiteboard_log_warning("Node (%s) already joined\n", nodeid);
-		  access_sib_unref(source);	  
-		  retval = FALSE;
-		}
+	      join_id = dbushandler_new_access_id(context);
+
+	      dbushandler_associate_access_id(context, join_id,
+					      packet->connection, conn,
+					      ACCESS_ROUTE_OP_JOIN);
+
+
+	      whiteboard_util_send_signal(WHITEBOARD_DBUS_OBJECT,
+					  WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+					  WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_JOIN,
+					  conn,
+					  DBUS_TYPE_INT32, &join_id,
+					  //apr09obsolete DBUS_TYPE_STRING, &username,
+					  DBUS_TYPE_STRING, &nodeid,
+					  DBUS_TYPE_STRING, &udn,
+					  DBUS_TYPE_INT32, &msgnum,
+					  WHITEBOARD_UTIL_LIST_END);
+	      access_sib_add_to_joined_nodes(source, nodeid);
+	      access_sib_unref(source);
+
+	      whiteboard_sib_handler_add_sib_by_joined_nodeid(sib_handler, nodeid, udn);
+
+	      JoinData *jd = g_new0(JoinData,1);
+	      jd->sib = g_strdup(udn);
+	      jd->node = g_strdup(nodeid);
+	      whiteboard_sib_handler_add_joindata_by_accessid(sib_handler, join_id, jd);
+	      g_static_rec_mutex_unlock(&sib_handler->lock);
+	      retval = TRUE;
 	    }
 	  else
 	    {
-	      whiteboard_log_error("Could not get dbus connection\n");
+	      g_static_rec_mutex_unlock(&sib_handler->lock);
+	      whiteboard_log_warning("Node (%s) already joined\n", nodeid);
 	      access_sib_unref(source);
-	      //return -1;
 	      retval = FALSE;
 	    }
 	}
+      else
+	{
+	  whiteboard_log_error("Could not get dbus connection\n");
+	  access_sib_unref(source);
+	  //return -1;
+	  retval = FALSE;
+	}
     }
   whiteboard_log_debug("Sending join method return with value: %d\n", retval);
   
   whiteboard_util_send_method_return(packet->connection, packet->message,
 				     DBUS_TYPE_INT32, &join_id,
 				     WHITEBOARD_UTIL_LIST_END);
+  if (conn != NULL)
+    dbus_connection_unref(conn);
   whiteboard_log_debug_fb();
   return retval;
 }
@@ -622,11 +2113,9 @@ static gint whiteboard_sib_handler_handle_leave(DBusHandler *context,
 						gpointer user_data)
 {
   gint retval = -1;
-  const gchar* udn = NULL;
+  gchar* udn = NULL;
   gchar* nodeid = NULL;
-  gchar *uuid=NULL;
   gint msgnum=0;
-  GList* list = NULL;
   AccessSIB *source = NULL;
   WhiteBoardSIBHandler* sib_handler = NULL;
   DBusConnection *conn = NULL;
@@ -654,11 +2143,10 @@ static gint whiteboard_sib_handler_handle_leave(DBusHandler *context,
   else
     {
       /* find the source from internal data structures */
-      list = g_list_find_custom(sib_handler->sib_list, udn,
-				access_sib_compare_id);
+      source = whiteboard_sib_handler_lookup_sib(sib_handler, udn);
       
       
-      if (list == NULL)
+      if (source == NULL)
 	{
 	  whiteboard_log_warning("Node %s not found. Cannot leave.\n",
 				 udn);
@@ -666,64 +2154,48 @@ static gint whiteboard_sib_handler_handle_leave(DBusHandler *context,
 	}
       else
 	{
-	  whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+	  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
 				"Node (%s) leaving sib (%s) \n", nodeid, udn);
-	  source = (AccessSIB*) list->data;
-	  access_sib_ref(source);
 	  
-	  if (!access_sib_get_uuid(source, &uuid) )
-	    {
-	      whiteboard_log_error("Could not get uuid\n");
-	      access_sib_unref(source);
-	      retval=-1;
-	      //return -1;
-	    }
-	  else
+	  conn = access_sib_get_connection(source);
+
+	  if( NULL != conn)
 	    {
-	      conn = dbushandler_get_connection_by_uuid(context,
-							uuid);
-	      if(uuid)
-		{
-		  g_free(uuid);
-		  uuid=NULL;
-		}
-	      
-	      if( NULL != conn)
+	      // check that not already joined
+	      if( TRUE == access_sib_is_node_joined(source, nodeid) )
 		{
-		  // check that not already joined
-		  if( TRUE == access_sib_is_node_joined(source, nodeid) )
-		    {
-		      whiteboard_util_send_signal(WHITEBOARD_DBUS_OBJECT,
-						  WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
-						  WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_LEAVE,
-						  conn,
-						  DBUS_TYPE_STRING, &nodeid,
-						  DBUS_TYPE_STRING, &udn,
-						  DBUS_TYPE_INT32, &msgnum,
-						  WHITEBOARD_UTIL_LIST_END);
-		      access_sib_remove_from_joined_nodes(source, nodeid);
-		      access_sib_unref(source);
-		      
-		      // remove association between nodeid and sib
-		      whiteboard_sib_handler_remove_sib_by_joined_nodeid(sib_handler, nodeid);
-		      
-		      retval = 0;
-		    }
-		  else
-		    {
-		      whiteboard_log_warning("Node (%s) not joined\n", nodeid);
-		      access_sib_unref(source);	  
-		      retval = -1;
-		    }
+		  /* The node loses its shortcut before the SIB hears of it */
+		  dbushandler_close_direct_channel(context, nodeid, udn);
+		  whiteboard_util_send_signal(WHITEBOARD_DBUS_OBJECT,
+					      WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+					      WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_LEAVE,
+					      conn,
+					      DBUS_TYPE_STRING, &nodeid,
+					      DBUS_TYPE_STRING, &udn,
+					      DBUS_TYPE_INT32, &msgnum,
+					      WHITEBOARD_UTIL_LIST_END);
+		  access_sib_remove_from_joined_nodes(source, nodeid);
+		  access_sib_unref(source);
+
+		  // remove association between nodeid and sib
+		  whiteboard_sib_handler_remove_sib_by_joined_nodeid(sib_handler, nodeid);
+
+		  retval = 0;
 		}
 	      else
 		{
-		  whiteboard_log_error("Could not get dbus connection\n");
-		  access_sib_unref(source);
-		  //return -1;
+		  whiteboard_log_warning("Node (%s) not joined\n", nodeid);
+		  access_sib_unref(source);   
 		  retval = -1;
 		}
 	    }
+	  else
+	    {
+	      whiteboard_log_error("Could not get dbus connection\n");
+	      access_sib_unref(source);
+	      //return -1;
+	      retval = -1;
+	    }
 	}
     }
   whiteboard_log_debug("Sending leave method return with value: %d\n", retval);
@@ -731,6 +2203,9 @@ static gint whiteboard_sib_handler_handle_leave(DBusHandler *context,
   whiteboard_util_send_method_return(packet->connection, packet->message,
 				     DBUS_TYPE_INT32, &retval,
 				     WHITEBOARD_UTIL_LIST_END);
+  g_free(udn);
+  if (conn != NULL)
+    dbus_connection_unref(conn);
   whiteboard_log_debug_fb();
   return (retval == 0);
   
@@ -741,20 +2216,16 @@ static gint whiteboard_sib_handler_handle_insert(DBusHandler *context,
 						  gpointer user_data)
 {
   gint retval = -1;
-  gchar *uuid = NULL;
   gchar* nodeid = NULL;
   gchar* sibid=NULL;
-  gchar* insert_request = NULL;
   gchar *insert_response = NULL;
   gint response_success = -1;
   gboolean free_response = FALSE;
   DBusConnection* conn = NULL;
-  GList *list = NULL;
   WhiteBoardSIBHandler* sib_handler=NULL;
   AccessSIB *source = NULL;
-  DBusMessage *reply = NULL;
+  gboolean pending = FALSE;
   gint msgnum=0;
-  gint encoding =0;
   whiteboard_log_debug_fb();
   
   g_return_val_if_fail( NULL != context, -1 );
@@ -763,13 +2234,8 @@ static gint whiteboard_sib_handler_handle_insert(DBusHandler *context,
 
   sib_handler = (WhiteBoardSIBHandler*) user_data;
 
-  if( whiteboard_util_parse_message(packet->message,
-				    DBUS_TYPE_STRING, &nodeid,
-				    DBUS_TYPE_STRING, &sibid,
-				    DBUS_TYPE_INT32, &msgnum,
-				    DBUS_TYPE_INT32, &encoding,
-				    DBUS_TYPE_STRING, &insert_request,
-				    WHITEBOARD_UTIL_LIST_END) )
+  if( whiteboard_sib_handler_parse_route(packet->message,
+					 &nodeid, &sibid, &msgnum) )
     {
       if(NULL == sibid)
 	{
@@ -783,11 +2249,10 @@ static gint whiteboard_sib_handler_handle_insert(DBusHandler *context,
       else
 	{
 	  /* find the source from internal data structures */
-	  list = g_list_find_custom(sib_handler->sib_list, sibid,
-				    access_sib_compare_id);
+	  source = whiteboard_sib_handler_lookup_sib(sib_handler, sibid);
 	  
 	  
-	  if (list == NULL)
+	  if (source == NULL)
 	    {
 	      whiteboard_log_warning("SIB (%s) not found. Cannot insert triplets.\n",
 				     sibid);
@@ -797,69 +2262,30 @@ static gint whiteboard_sib_handler_handle_insert(DBusHandler *context,
 	    }
 	  else
 	    {
-	      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+	      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
 				    "Insert request from Node (%s), SIB (%s) \n", nodeid, sibid);
-	      source = (AccessSIB*) list->data;
-	      access_sib_ref(source);
 	      
-	      if (!access_sib_get_uuid(source, &uuid) )
-		{
-		  whiteboard_log_error("Could not get uuid\n");
-		  retval=FALSE;
-		  insert_response = g_strdup("Fail");
-		  response_success = -1;
-		  free_response = TRUE;
-		  //return -1;
-		}
-	      else
+	      conn = access_sib_get_connection(source);
+
+	      if( NULL != conn)
 		{
-		  conn = dbushandler_get_connection_by_uuid(context,
-							    uuid);
-		  if(uuid)
-		    {
-		      g_free(uuid);
-		      uuid=NULL;
-		    }
-		  
-		  if( NULL != conn)
+		  // check that not already joined
+		  if( TRUE == access_sib_is_node_joined(source, nodeid) )
 		    {
-		      // check that not already joined
-		      if( TRUE == access_sib_is_node_joined(source, nodeid) )
+		      pending = whiteboard_sib_handler_forward_write(context,
+								     sib_handler,
+								     packet,
+								     conn,
+								     sibid,
+								     WHITEBOARD_DBUS_SIB_ACCESS_METHOD_INSERT);
+
+		      if(pending)
 			{
-			  whiteboard_util_send_method_with_reply(WHITEBOARD_DBUS_SERVICE,
-								 WHITEBOARD_DBUS_OBJECT,
-								 WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
-								 WHITEBOARD_DBUS_SIB_ACCESS_METHOD_INSERT,
-								 conn,
-								 &reply,
-								 DBUS_TYPE_STRING, &nodeid,
-								 DBUS_TYPE_STRING, &sibid,
-								 DBUS_TYPE_INT32, &msgnum,
-								 DBUS_TYPE_INT32, &encoding,
-								 DBUS_TYPE_STRING, &insert_request,
-								 WHITEBOARD_UTIL_LIST_END);
-			  
-			  if(reply)
-			    {
-			      whiteboard_util_parse_message(reply,
-							    DBUS_TYPE_INT32, &response_success,
-							    DBUS_TYPE_STRING, &insert_response,
-							    WHITEBOARD_UTIL_LIST_END);
-			      
-			      retval = TRUE;
-			    }
-			  else
-			    {
-			      whiteboard_log_warning("No insert reply, node %s\n", nodeid);
-			      response_success = -1;
-			      insert_response = g_strdup("Fail");
-			      free_response = TRUE;
-			      retval = FALSE;
-			    }
+			  retval = TRUE;
 			}
 		      else
 			{
-			  whiteboard_log_warning("Node (%s) not joined\n", nodeid);
+			  whiteboard_log_warning("Could not forward insert, node %s\n", nodeid);
 			  response_success = -1;
 			  insert_response = g_strdup("Fail");
 			  free_response = TRUE;
@@ -868,14 +2294,22 @@ static gint whiteboard_sib_handler_handle_insert(DBusHandler *context,
 		    }
 		  else
 		    {
-		      whiteboard_log_error("Could not get dbus connection\n");
-		      //return -1;
-		      response_success = -1;		  
+		      whiteboard_log_warning("Node (%s) not joined\n", nodeid);
+		      response_success = -1;
 		      insert_response = g_strdup("Fail");
-		      free_response = TRUE;	      
+		      free_response = TRUE;
 		      retval = FALSE;
 		    }
 		}
+	      else
+		{
+		  whiteboard_log_error("Could not get dbus connection\n");
+		  //return -1;
+		  response_success = -1;              
+		  insert_response = g_strdup("Fail");
+		  free_response = TRUE;           
+		  retval = FALSE;
+		}
 	      
 	      access_sib_unref(source);
 	    }
@@ -888,17 +2322,18 @@ static gint whiteboard_sib_handler_handle_insert(DBusHandler *context,
       free_response = TRUE;	      
       retval = FALSE;  
     }
-  whiteboard_util_send_method_return(packet->connection, packet->message,
-				     DBUS_TYPE_INT32, &response_success,
-				     DBUS_TYPE_STRING, &insert_response,
-				     WHITEBOARD_UTIL_LIST_END);
-  if(reply)
-    dbus_message_unref(reply);
-  
+  /* Forwarded requests are answered from the SIB reply callback */
+  if(!pending)
+    whiteboard_util_send_method_return(packet->connection, packet->message,
+				       DBUS_TYPE_INT32, &response_success,
+				       DBUS_TYPE_STRING, &insert_response,
+				       WHITEBOARD_UTIL_LIST_END);
   if( free_response)
     {
       g_free(insert_response);
     }
+  if (conn != NULL)
+    dbus_connection_unref(conn);
   whiteboard_log_debug_fe();
   return retval;
 }
@@ -908,20 +2343,15 @@ static gint whiteboard_sib_handler_handle_update(DBusHandler *context,
 						  gpointer user_data)
 {
   gint retval = -1;
-  gchar *uuid = NULL;
   gchar* nodeid = NULL;
   gchar* sibid=NULL;
-  gchar* insert_request = NULL;
-  gchar* remove_request = NULL;
   gchar *update_response = NULL;
   gint response_success = -1;
-  EncodingType encoding;
   gboolean free_response = FALSE;
   DBusConnection* conn = NULL;
-  GList *list = NULL;
   WhiteBoardSIBHandler* sib_handler=NULL;
   AccessSIB *source = NULL;
-  DBusMessage *reply = NULL;
+  gboolean pending = FALSE;
   gint msgnum=0;
   whiteboard_log_debug_fb();
   
@@ -931,14 +2361,8 @@ static gint whiteboard_sib_handler_handle_update(DBusHandler *context,
 
   sib_handler = (WhiteBoardSIBHandler*) user_data;
   
-  if(whiteboard_util_parse_message(packet->message,
-				   DBUS_TYPE_STRING, &nodeid,
-				   DBUS_TYPE_STRING, &sibid,
-				   DBUS_TYPE_INT32, &msgnum,
-				   DBUS_TYPE_INT32, &encoding,
-				   DBUS_TYPE_STRING, &insert_request,
-				   DBUS_TYPE_STRING, &remove_request,				
-				   WHITEBOARD_UTIL_LIST_END))
+  if(whiteboard_sib_handler_parse_route(packet->message,
+					&nodeid, &sibid, &msgnum))
     {
       
       if(NULL == sibid)
@@ -952,11 +2376,10 @@ static gint whiteboard_sib_handler_handle_update(DBusHandler *context,
       else
 	{
 	  /* find the source from internal data structures */
-	  list = g_list_find_custom(sib_handler->sib_list, sibid,
-				    access_sib_compare_id);
+	  source = whiteboard_sib_handler_lookup_sib(sib_handler, sibid);
 	  
 	  
-	  if (list == NULL)
+	  if (source == NULL)
 	    {
 	      whiteboard_log_warning("SIB (%s) not found. Cannot update triplets.\n",
 				     sibid);
@@ -966,83 +2389,52 @@ static gint whiteboard_sib_handler_handle_update(DBusHandler *context,
 	    }
 	  else
 	    {
-	      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+	      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
 				    "Update request from Node (%s), SIB (%s) \n", nodeid, sibid);
-	      source = (AccessSIB*) list->data;
-	      access_sib_ref(source);
 	      
-	      if (!access_sib_get_uuid(source, &uuid) )
-		{
-		  whiteboard_log_error("Could not get uuid\n");
-		  update_response = g_strdup("Fail");
-		  response_success = -1;
-		  free_response = TRUE;
-		  //return -1;
-		}
-	      else
+	      conn = access_sib_get_connection(source);
+
+	      if( NULL != conn)
 		{
-		  conn = dbushandler_get_connection_by_uuid(context,
-							    uuid);
-		  if(uuid)
-		    {
-		      g_free(uuid);
-		      uuid=NULL;
-		    }
-		  
-		  if( NULL != conn)
+		  // check that not already joined
+		  if( TRUE == access_sib_is_node_joined(source, nodeid) )
 		    {
-		      // check that not already joined
-		      if( TRUE == access_sib_is_node_joined(source, nodeid) )
+		      pending = whiteboard_sib_handler_forward_write(context,
+								     sib_handler,
+								     packet,
+								     conn,
+								     sibid,
+								     WHITEBOARD_DBUS_SIB_ACCESS_METHOD_UPDATE);
+
+		      if(pending)
 			{
-			  whiteboard_util_send_method_with_reply(WHITEBOARD_DBUS_SERVICE,
-								 WHITEBOARD_DBUS_OBJECT,
-								 WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
-								 WHITEBOARD_DBUS_SIB_ACCESS_METHOD_UPDATE,
-								 conn,
-								 &reply,
-								 DBUS_TYPE_STRING, &nodeid,
-								 DBUS_TYPE_STRING, &sibid,
-								 DBUS_TYPE_INT32, &msgnum,
-								 DBUS_TYPE_INT32, &encoding,
-								 DBUS_TYPE_STRING, &insert_request,
-								 DBUS_TYPE_STRING, &remove_request,
-								 WHITEBOARD_UTIL_LIST_END);
-			  
-			  if(reply)
-			    {
-			      whiteboard_util_parse_message(reply,
-							    DBUS_TYPE_INT32, &response_success,
-							    DBUS_TYPE_STRING, &update_response,
-							    WHITEBOARD_UTIL_LIST_END);
-			      
-			      retval = 1;
-			    }
-			  else
-			    {
-			      whiteboard_log_warning("No reply update request\n");
-			      response_success = -1;
-			      update_response = g_strdup("Fail");
-			      free_response = TRUE;
-			      retval = FALSE;
-			    }
+			  retval = 1;
 			}
 		      else
 			{
-			  whiteboard_log_warning("Node (%s) not joined\n", nodeid);
+			  whiteboard_log_warning("Could not forward update request\n");
 			  response_success = -1;
 			  update_response = g_strdup("Fail");
 			  free_response = TRUE;
+			  retval = FALSE;
 			}
 		    }
 		  else
 		    {
-		      whiteboard_log_error("Could not get dbus connection\n");
-		      //return -1;
-		      response_success = -1;		  
+		      whiteboard_log_warning("Node (%s) not joined\n", nodeid);
+		      response_success = -1;
 		      update_response = g_strdup("Fail");
-		      free_response = TRUE;	      
+		      free_response = TRUE;
 		    }
 		}
+	      else
+		{
+		  whiteboard_log_error("Could not get dbus connection\n");
+		  //return -1;
+		  response_success = -1;              
+		  update_response = g_strdup("Fail");
+		  free_response = TRUE;           
+		}
 	      access_sib_unref(source);
 	    }
 	}
@@ -1054,18 +2446,19 @@ static gint whiteboard_sib_handler_handle_update(DBusHandler *context,
       response_success = -1;		  
       update_response = g_strdup("Fail");
       free_response = TRUE;	      
-    }
-  whiteboard_util_send_method_return(packet->connection, packet->message,
-				     DBUS_TYPE_INT32, &response_success,
-				     DBUS_TYPE_STRING, &update_response,
-				     WHITEBOARD_UTIL_LIST_END);
-  if(reply)
-     dbus_message_unref(reply);
-  
+    }
+  /* Forwarded requests are answered from the SIB reply callback */
+  if(!pending)
+    whiteboard_util_send_method_return(packet->connection, packet->message,
+				       DBUS_TYPE_INT32, &response_success,
+				       DBUS_TYPE_STRING, &update_response,
+				       WHITEBOARD_UTIL_LIST_END);
   if( free_response)
     {
       g_free(update_response);
     }
+  if (conn != NULL)
+    dbus_connection_unref(conn);
   whiteboard_log_debug_fe();
   return retval;
 }
@@ -1077,20 +2470,16 @@ static gint whiteboard_sib_handler_handle_remove(DBusHandler *context,
   const gchar* member = NULL;
 
   gint retval = -1;
-  gchar *uuid = NULL;
   gchar* nodeid = NULL;
   gchar* sibid=NULL;
-  gchar* insert_request = NULL;
   gchar*  response = NULL;
   gboolean free_response = FALSE;
   gint response_success = -1;
 
-  EncodingType encoding;
   DBusConnection* conn = NULL;
-  GList *list = NULL;
   WhiteBoardSIBHandler* sib_handler=NULL;
   AccessSIB *source = NULL;
-  DBusMessage *reply = NULL;
+  gboolean pending = FALSE;
   gint msgnum=0;
   whiteboard_log_debug_fb();
   
@@ -1102,15 +2491,10 @@ static gint whiteboard_sib_handler_handle_remove(DBusHandler *context,
   
   sib_handler = (WhiteBoardSIBHandler*) user_data;
   
-  if(whiteboard_util_parse_message(packet->message,
-				   DBUS_TYPE_STRING, &nodeid,
-				   DBUS_TYPE_STRING, &sibid,
-				   DBUS_TYPE_INT32, &msgnum,
-				   DBUS_TYPE_INT32, &encoding,
-				   DBUS_TYPE_STRING, &insert_request,
-				   WHITEBOARD_UTIL_LIST_END) )
+  if(whiteboard_sib_handler_parse_route(packet->message,
+					&nodeid, &sibid, &msgnum))
     {
-      whiteboard_log_debug("Remove: nodeid:%s, sibid :%s, msgnum: %d, encoding: %d, request :%s\n", nodeid, sibid, msgnum, encoding, insert_request);
+      whiteboard_log_debug("Remove: nodeid:%s, sibid :%s, msgnum: %d\n", nodeid, sibid, msgnum);
       if(NULL == sibid)
 	{
 	  whiteboard_log_warning("Found no joined SIBs for node %s. Cannot remove.\n",
@@ -1123,11 +2507,10 @@ static gint whiteboard_sib_handler_handle_remove(DBusHandler *context,
       else
 	{
 	  /* find the source from internal data structures */
-	  list = g_list_find_custom(sib_handler->sib_list, sibid,
-				    access_sib_compare_id);
+	  source = whiteboard_sib_handler_lookup_sib(sib_handler, sibid);
 	  
 	  
-	  if (list == NULL)
+	  if (source == NULL)
 	    {
 	      whiteboard_log_warning("SIB (%s) not found. Cannot %s triplets.\n",member,
 				     sibid);
@@ -1138,65 +2521,30 @@ static gint whiteboard_sib_handler_handle_remove(DBusHandler *context,
 	    }
 	  else
 	    {
-	      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+	      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
 				    "%s request from Node (%s), SIB (%s) \n",member, nodeid, sibid);
-	      source = (AccessSIB*) list->data;
-	      access_sib_ref(source);
 	      
-	      if (!access_sib_get_uuid(source, &uuid) )
-		{
-		  whiteboard_log_error("Could not get uuid\n");
-		  response = g_strdup("Fail");
-		  response_success = -1;
-		  free_response = TRUE;
-		  //return -1;
-		}
-	      else
+	      conn = access_sib_get_connection(source);
+
+	      if( NULL != conn)
 		{
-		  conn = dbushandler_get_connection_by_uuid(context,
-							    uuid);
-		  if(uuid)
-		    {
-		      g_free(uuid);
-		      uuid=NULL;
-		    }
-		  
-		  if( NULL != conn)
+		  // check that not already joined
+		  if( TRUE == access_sib_is_node_joined(source, nodeid) )
 		    {
-		      // check that not already joined
-		      if( TRUE == access_sib_is_node_joined(source, nodeid) )
+		      pending = whiteboard_sib_handler_forward_write(context,
+								     sib_handler,
+								     packet,
+								     conn,
+								     sibid,
+								     member);
+
+		      if(pending)
 			{
-			  whiteboard_util_send_method_with_reply(WHITEBOARD_DBUS_SERVICE,
-								 WHITEBOARD_DBUS_OBJECT,
-								 WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
-								 member,
-								 conn,
-								 &reply,
-								 DBUS_TYPE_STRING, &nodeid,
-								 DBUS_TYPE_STRING, &sibid,
-								 DBUS_TYPE_INT32, &msgnum,
-								 DBUS_TYPE_INT32, &encoding,
-								 DBUS_TYPE_STRING, &insert_request,
-								 WHITEBOARD_UTIL_LIST_END);
-			  
-			  if(reply &&  whiteboard_util_parse_message(reply,
-								     DBUS_TYPE_INT32, &response_success,
-								     DBUS_TYPE_STRING, &response,
-								     WHITEBOARD_UTIL_LIST_END) )
-			    {
-			      retval = 1;
-			    }
-			  else
-			    {
-			      whiteboard_log_warning("No reply of could not parse message\n");
-			      response = g_strdup("Fail");
-			      response_success = -1;
-			      free_response = TRUE;
-			    }
+			  retval = 1;
 			}
 		      else
 			{
-			  whiteboard_log_warning("Node (%s) not joined\n", nodeid);
+			  whiteboard_log_warning("Could not forward %s request\n", member);
 			  response = g_strdup("Fail");
 			  response_success = -1;
 			  free_response = TRUE;
@@ -1204,13 +2552,20 @@ static gint whiteboard_sib_handler_handle_remove(DBusHandler *context,
 		    }
 		  else
 		    {
-		      whiteboard_log_error("Could not get dbus connection\n");
+		      whiteboard_log_warning("Node (%s) not joined\n", nodeid);
 		      response = g_strdup("Fail");
 		      response_success = -1;
 		      free_response = TRUE;
-		      //return -1;
 		    }
 		}
+	      else
+		{
+		  whiteboard_log_error("Could not get dbus connection\n");
+		  response = g_strdup("Fail");
+		  response_success = -1;
+		  free_response = TRUE;
+		  //return -1;
+		}
 	      access_sib_unref(source);
 	    }
 	}
@@ -1220,17 +2575,18 @@ static gint whiteboard_sib_handler_handle_remove(DBusHandler *context,
       response = g_strdup("Fail");
       free_response = TRUE;
     }
-  whiteboard_util_send_method_return(packet->connection, packet->message,
-				     DBUS_TYPE_INT32, &response_success,
-				     DBUS_TYPE_STRING, &response,
-				     WHITEBOARD_UTIL_LIST_END);
-  
-  if(reply)
-    dbus_message_unref(reply);
+  /* Forwarded requests are answered from the SIB reply callback */
+  if(!pending)
+    whiteboard_util_send_method_return(packet->connection, packet->message,
+				       DBUS_TYPE_INT32, &response_success,
+				       DBUS_TYPE_STRING, &response,
+				       WHITEBOARD_UTIL_LIST_END);
   
   if(free_response)
     g_free(response);
   
+  if (conn != NULL)
+    dbus_connection_unref(conn);
   whiteboard_log_debug_fe();
   return retval;
 }
@@ -1241,16 +2597,20 @@ static gint whiteboard_sib_handler_handle_subscribe_query(DBusHandler *context,
 {
   gint retval = -1;
   gint access_id = -1;
-  gchar *uuid = NULL;
   gchar* nodeid = NULL;
   gchar* sibid=NULL;
   gint type = -1;
-  gchar *request = NULL;
+  Payload request = PAYLOAD_INIT;
+  Payload cached_results = PAYLOAD_INIT;
+  gchar *cache_key = NULL;
+  gchar *cached = NULL;
+  DBusMessage *msg = NULL;
+  DBusMessageIter iter;
   DBusConnection* conn = NULL;
-  GList *list = NULL;
   WhiteBoardSIBHandler* sib_handler=NULL;
   AccessSIB *source = NULL;
   const gchar *member = NULL;
+  AccessRouteOp op = ACCESS_ROUTE_OP_SUBSCRIBE;
   gint msgnum=0;
   whiteboard_log_debug_fb();
   
@@ -1260,13 +2620,11 @@ static gint whiteboard_sib_handler_handle_subscribe_query(DBusHandler *context,
 
   sib_handler = (WhiteBoardSIBHandler*) user_data;
   member = dbus_message_get_member(packet->message);
-  if( whiteboard_util_parse_message(packet->message,
-				    DBUS_TYPE_STRING, &nodeid,
-				    DBUS_TYPE_STRING, &sibid,
-				    DBUS_TYPE_INT32, &msgnum,
-				    DBUS_TYPE_INT32, &type,
-				    DBUS_TYPE_STRING, &request,
-				    WHITEBOARD_UTIL_LIST_END) )
+  if (0 == strcmp(member, WHITEBOARD_DBUS_NODE_METHOD_QUERY))
+    op = ACCESS_ROUTE_OP_QUERY;
+  if( whiteboard_sib_handler_parse_request(packet->message,
+					   &nodeid, &sibid, &msgnum,
+					   &type, &request) )
     {
   
       if(NULL == sibid)
@@ -1278,11 +2636,10 @@ static gint whiteboard_sib_handler_handle_subscribe_query(DBusHandler *context,
       else
 	{
 	  /* find the source from internal data structures */
-	  list = g_list_find_custom(sib_handler->sib_list, sibid,
-				    access_sib_compare_id);
+	  source = whiteboard_sib_handler_lookup_sib(sib_handler, sibid);
 	  
 	  
-	  if (list == NULL)
+	  if (source == NULL)
 	    {
 	      whiteboard_log_warning("SIB (%s) not found. Cannot subscribe.\n",
 				     sibid);
@@ -1290,73 +2647,118 @@ static gint whiteboard_sib_handler_handle_subscribe_query(DBusHandler *context,
 	    }
 	  else
 	    {
-	      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+	      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
 				    "%s request from Node (%s), SIB (%s) \n", member,nodeid, sibid);
-	      source = (AccessSIB*) list->data;
-	      access_sib_ref(source);
 	      
-	      if (!access_sib_get_uuid(source, &uuid) )
-		{
-		  whiteboard_log_error("Could not get uuid\n");
-		  retval=FALSE;
-		  //return -1;
-		}
-	      else
+	      conn = access_sib_get_connection(source);
+
+	      /* Nodes with a direct channel write without the daemon
+		 seeing it, so their SIB is not cached */
+	      if( NULL != conn && op == ACCESS_ROUTE_OP_QUERY &&
+		  !dbushandler_sib_has_direct_channels(context, conn) )
+		cache_key = whiteboard_sib_handler_cache_key(sib_handler, sibid,
+							     type, &request);
+
+	      if( NULL != conn)
 		{
-		  conn = dbushandler_get_connection_by_uuid(context,
-							    uuid);
-		  if(uuid)
+		  // check that joined
+		  if( FALSE == access_sib_is_node_joined(source, nodeid) )
 		    {
-		      g_free(uuid);
-		      uuid=NULL;
+		      whiteboard_log_warning("Node (%s) not joined\n", nodeid);
+		      retval = FALSE;
 		    }
-	      
-		  if( NULL != conn)
+		  else if( NULL != cache_key &&
+			   NULL != (cached = whiteboard_sib_handler_cache_lookup(sib_handler,
+										 cache_key,
+										 sibid)) )
+		    {
+		      /* Answered below, the access id only tags the result */
+		      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+						   "%s answered from cache\n", member);
+		      access_id = dbushandler_new_access_id(context);
+		      retval = TRUE;
+		    }
+		  else if( FALSE == dbushandler_sib_can_send(context, conn) )
+		    {
+		      whiteboard_log_warning("SIB (%s) overloaded, refusing %s\n",
+					     sibid, member);
+		      access_id = WHITEBOARD_STATUS_OVERLOADED;
+		      retval = FALSE;
+		    }
+		  else
 		    {
-		      // check that joined
-		      if( TRUE == access_sib_is_node_joined(source, nodeid) )
+		      access_id = dbushandler_new_access_id(context);
+		      dbushandler_associate_access_id(context, access_id,
+						      packet->connection, conn, op);
+		      if( NULL != cache_key )
+			{
+			  whiteboard_sib_handler_cache_expect(sib_handler, access_id,
+							      cache_key, sibid);
+			  cache_key = NULL;
+			}
+
+		      msg = dbus_message_new_method_call(WHITEBOARD_DBUS_SERVICE,
+							 WHITEBOARD_DBUS_OBJECT,
+							 WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+							 member);
+		      if( NULL != msg )
+			dbus_message_iter_init_append(msg, &iter);
+
+		      if( NULL != msg &&
+			  dbus_message_iter_append_basic(&iter, DBUS_TYPE_INT32, &access_id) &&
+			  dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &nodeid) &&
+			  dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &sibid) &&
+			  dbus_message_iter_append_basic(&iter, DBUS_TYPE_INT32, &msgnum) &&
+			  dbus_message_iter_append_basic(&iter, DBUS_TYPE_INT32, &type) &&
+			  whiteboard_sib_handler_append_payload(&iter, conn, &request) &&
+			  dbus_connection_send(conn, msg, NULL) )
 			{
-			  access_id = whiteboard_sib_handler_get_access_id();
-			  dbushandler_set_node_connection_with_access_id( context,
-									  access_id,
-									  packet->connection);
-			  dbushandler_set_sib_connection_with_access_id( context,
-									 access_id,
-									 conn);
-		      
-			  whiteboard_util_send_method(WHITEBOARD_DBUS_SERVICE,
-						      WHITEBOARD_DBUS_OBJECT,
-						      WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
-						      member,
-						      conn,
-						      DBUS_TYPE_INT32, &access_id,
-						      DBUS_TYPE_STRING, &nodeid,
-						      DBUS_TYPE_STRING, &sibid,
-						      DBUS_TYPE_INT32, &msgnum,
-						      DBUS_TYPE_INT32, &type,
-						      DBUS_TYPE_STRING, &request,
-						      WHITEBOARD_UTIL_LIST_END);
+			  retval = TRUE;
 			}
 		      else
 			{
-			  whiteboard_log_warning("Node (%s) not joined\n", nodeid);
+			  whiteboard_log_warning("Could not forward %s request\n", member);
+			  dbushandler_invalidate_access_id(context, access_id);
+			  whiteboard_sib_handler_cache_forget(sib_handler, access_id);
+			  access_id = -1;
 			  retval = FALSE;
 			}
+
+		      if( NULL != msg )
+			dbus_message_unref(msg);
 		    }
-		  else
-		    {
-		      whiteboard_log_error("Could not get dbus connection\n");
-		      //return -1;
-		      retval = FALSE;
-		    }
+		}
+	      else
+		{
+		  whiteboard_log_error("Could not get dbus connection\n");
+		  //return -1;
+		  retval = FALSE;
 		}
 	      access_sib_unref(source);
 	    }
 	}
     }
+  whiteboard_sib_handler_payload_clear(&request);
   whiteboard_util_send_method_return(packet->connection, packet->message,
 				     DBUS_TYPE_INT32, &access_id,
 				     WHITEBOARD_UTIL_LIST_END);
+
+  /* The result follows the access id like one from the SIB */
+  if( NULL != cached )
+    {
+      cached_results.type = DBUS_TYPE_STRING;
+      cached_results.string = cached;
+      if( !whiteboard_sib_handler_send_result(packet->connection,
+					      WHITEBOARD_DBUS_NODE_METHOD_QUERY,
+					      access_id, 0, NULL,
+					      &cached_results) )
+	whiteboard_log_warning("Could not send cached query result (access id %d)\n",
+			       access_id);
+      g_free(cached);
+    }
+  g_free(cache_key);
+  if (conn != NULL)
+    dbus_connection_unref(conn);
   whiteboard_log_debug_fe();
   return retval;
 }
@@ -1368,13 +2770,11 @@ static gint whiteboard_sib_handler_handle_unsubscribe(DBusHandler *context,
 {
   
   gint retval = -1;
-  gchar *uuid = NULL;
   gchar* nodeid = NULL;
   gchar* sibid=NULL;
   gchar *subscription_id = NULL;
   gint access_id = -1;
   DBusConnection* conn = NULL;
-  GList *list = NULL;
   WhiteBoardSIBHandler* sib_handler=NULL;
   AccessSIB *source = NULL;
   gint msgnum=0;
@@ -1403,11 +2803,10 @@ static gint whiteboard_sib_handler_handle_unsubscribe(DBusHandler *context,
   else
     {
       /* find the source from internal data structures */
-      list = g_list_find_custom(sib_handler->sib_list, sibid,
-				access_sib_compare_id);
+      source = whiteboard_sib_handler_lookup_sib(sib_handler, sibid);
       
       
-      if (list == NULL)
+      if (source == NULL)
 	{
 	  whiteboard_log_warning("SIB (%s) not found. Cannot unscubscribe.\n",
 				 sibid);
@@ -1415,55 +2814,38 @@ static gint whiteboard_sib_handler_handle_unsubscribe(DBusHandler *context,
 	}
       else
 	{
-	  whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+	  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
 				"Unsubsribe request from Node (%s), SIB (%s) \n", nodeid, sibid);
-	  source = (AccessSIB*) list->data;
-	  access_sib_ref(source);
 	  
-	  if (!access_sib_get_uuid(source, &uuid) )
-	    {
-	      whiteboard_log_error("Could not get uuid\n");
-	      retval=-1;
-	      //return -1;
-	    }
-	  else
+	  conn = access_sib_get_connection(source);
+
+	  if( NULL != conn)
 	    {
-	      conn = dbushandler_get_connection_by_uuid(context,
-							uuid);
-	      if(uuid)
-		{
-		  g_free(uuid);
-		  uuid=NULL;
-		}
-	      
-	      if( NULL != conn)
+	      // check that joined
+	      if( TRUE == access_sib_is_node_joined(source, nodeid) )
 		{
-		  // check that joined
-		  if( TRUE == access_sib_is_node_joined(source, nodeid) )
-		    {
-		      whiteboard_util_send_signal(WHITEBOARD_DBUS_OBJECT,
-						  WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
-						  WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_UNSUBSCRIBE,
-						  conn,
-						  DBUS_TYPE_INT32, &access_id,
-						  DBUS_TYPE_STRING, &nodeid,
-						  DBUS_TYPE_STRING, &sibid,
-						  DBUS_TYPE_INT32, &msgnum,
-						  DBUS_TYPE_STRING, &subscription_id,
-						  WHITEBOARD_UTIL_LIST_END);
-		      retval = 1;
-		    }
-		  else
-		    {
-		      retval = -1;
-		    }
+		  whiteboard_util_send_signal(WHITEBOARD_DBUS_OBJECT,
+					      WHITEBOARD_DBUS_SIB_ACCESS_INTERFACE,
+					      WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_UNSUBSCRIBE,
+					      conn,
+					      DBUS_TYPE_INT32, &access_id,
+					      DBUS_TYPE_STRING, &nodeid,
+					      DBUS_TYPE_STRING, &sibid,
+					      DBUS_TYPE_INT32, &msgnum,
+					      DBUS_TYPE_STRING, &subscription_id,
+					      WHITEBOARD_UTIL_LIST_END);
+		  retval = 1;
 		}
 	      else
 		{
-		  whiteboard_log_error("Could not get dbus connection\n");
 		  retval = -1;
 		}
 	    }
+	  else
+	    {
+	      whiteboard_log_error("Could not get dbus connection\n");
+	      retval = -1;
+	    }
 	  access_sib_unref(source);
 	}
     }
@@ -1480,6 +2862,8 @@ static gint whiteboard_sib_handler_handle_unsubscribe(DBusHandler *context,
 				  DBUS_TYPE_STRING, &subscription_id,
 				  WHITEBOARD_UTIL_LIST_END);
     }
+  if (conn != NULL)
+    dbus_connection_unref(conn);
   whiteboard_log_debug_fe();
   return retval;
 }
@@ -1507,7 +2891,7 @@ static gint whiteboard_sib_handler_handle_signal_join_complete(DBusHandler *cont
 
 	
 
-  whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
 			"Got signal (join complete) with access id: %d,status %d\n", 
 			join_id, status);
 
@@ -1526,30 +2910,26 @@ static gint whiteboard_sib_handler_handle_signal_join_complete(DBusHandler *cont
      from data structures */
   dbushandler_invalidate_access_id(context,join_id);
 
-  JoinData *jd=whiteboard_sib_handler_get_joindata_by_accessid(self,join_id);
-  if(jd)
-    {
-	    
-      whiteboard_sib_handler_remove_joindata_by_accessid( self, join_id);
-    }
-  else
+  JoinData *jd=whiteboard_sib_handler_steal_joindata_by_accessid(self,join_id);
+  if(jd == NULL)
     {
       whiteboard_log_debug("Could not find JoinData w/ accessid:%d\n", join_id);
     }
 	
+  /* Data operations of the joined node may bypass the daemon */
+  if(!status && jd && node_connection != NULL)
+    dbushandler_open_direct_channel(context, node_connection,
+				    packet->connection, jd->node, jd->sib);
+
   if(status && jd)
     {
       whiteboard_sib_handler_remove_sib_by_joined_nodeid( self, jd->node);
 
-            /* find the source from internal data structures */
-      GList *list = g_list_find_custom(self->sib_list, jd->sib,
-				       access_sib_compare_id);
-      
+      /* find the source from internal data structures */
+      AccessSIB *source = whiteboard_sib_handler_lookup_sib(self, jd->sib);
       
-      if (list != NULL)
+      if (source != NULL)
 	{
-	  AccessSIB *source = (AccessSIB*) list->data;
-	  access_sib_ref(source);
 	  
 	  access_sib_remove_from_joined_nodes(source, jd->node);
 	  access_sib_unref(source);
@@ -1559,7 +2939,6 @@ static gint whiteboard_sib_handler_handle_signal_join_complete(DBusHandler *cont
 	  whiteboard_log_debug("Can not find sib: %s, from sib_list\n", jd->sib); 
 	}
     }
-  whiteboard_sib_handler_remove_joindata_by_accessid(self,join_id);
   if(jd)
     {
       g_free(jd->node);
@@ -1576,67 +2955,402 @@ static gint whiteboard_sib_handler_handle_unsubscribe_complete(DBusHandler *cont
 							       gpointer user_data)
 {
 
-  dbus_int32_t access_id = -1;
-  DBusConnection *node_connection;
-  
-  whiteboard_log_debug_fb();
-  
-  g_return_val_if_fail( NULL != context, -1 );
-  g_return_val_if_fail( NULL != packet, -1 );
+  dbus_int32_t access_id = -1;
+  DBusConnection *node_connection;
+  
+  whiteboard_log_debug_fb();
+  
+  g_return_val_if_fail( NULL != context, -1 );
+  g_return_val_if_fail( NULL != packet, -1 );
+
+  whiteboard_util_parse_message(packet->message,
+				DBUS_TYPE_INT32, &access_id,
+				WHITEBOARD_UTIL_LIST_END);
+  
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
+			"Got signal (unsubscribe complete) with access_id:%d. \n", access_id);
+  
+  /* Find the connection associated to this access id */
+  node_connection = dbushandler_get_node_connection_by_access_id(context, 
+								access_id);
+
+  /* Deliver pending indications before the subscription is closed */
+  if (node_connection != NULL)
+    whiteboard_sib_handler_flush_indications((WhiteBoardSIBHandler *) user_data,
+					     node_connection);
+  
+  whiteboard_util_forward_packet(node_connection, packet->message,
+				 NULL,
+				 NULL,
+				 WHITEBOARD_DBUS_NODE_INTERFACE,
+				 NULL);
+  
+  dbushandler_invalidate_access_id(context, access_id);
+  
+  whiteboard_log_debug_fe();
+  return 0;
+}
+
+/**
+ * Forward a subscription indication to the subscribing node. This is the
+ * highest volume message, so only the leading access id is read and the
+ * received message itself is sent on with its interface rewritten, without
+ * parsing or copying the indication payload. Only a node that cannot
+ * receive the payload file descriptors gets a copy with inline documents.
+ */
+static gint whiteboard_sib_handler_handle_signal_subscription_ind(DBusHandler *context,
+								  WhiteBoardPacket *packet,
+								  gpointer user_data)
+{
+  DBusMessageIter iter;
+  dbus_int32_t access_id = 0;
+  DBusConnection *node_connection;
+  DBusMessage *message = NULL;
+  gint retval = 0;
+	
+  whiteboard_log_debug_fb();
+	
+  g_return_val_if_fail( NULL != context, -1 );
+  g_return_val_if_fail( NULL != packet, -1 );
+
+  if (!dbus_message_iter_init(packet->message, &iter) ||
+      dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_INT32)
+    {
+      whiteboard_log_warning("Malformed subscription indication, no access id\n");
+      whiteboard_log_debug_fe();
+      return -1;
+    }
+  dbus_message_iter_get_basic(&iter, &access_id);
+
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
+			"Got signal (subscription_ind) with access_id: %d\n", 
+			access_id);
+
+  /* The subscribed data changed */
+  whiteboard_sib_handler_cache_invalidate_connection((WhiteBoardSIBHandler *) user_data,
+						     packet->connection);
+
+  /* Find the connection associated to this access id */
+  node_connection = dbushandler_get_node_connection_by_access_id(context, access_id);
+  if (node_connection == NULL)
+    {
+      whiteboard_log_warning("No node connection for subscription access id %d\n",
+			     access_id);
+      whiteboard_log_debug_fe();
+      return -1;
+    }
+
+  if (!dbus_message_set_interface(packet->message, WHITEBOARD_DBUS_NODE_INTERFACE))
+    {
+      whiteboard_log_warning("Could not forward subscription indication (access id %d)\n",
+			     access_id);
+      whiteboard_log_debug_fe();
+      return -1;
+    }
+
+  message = dbus_message_ref(packet->message);
+#ifdef HAVE_DBUS_UNIX_FD
+  /* libdbus would refuse to send the descriptors to such a node */
+  if (dbus_message_contains_unix_fds(message) &&
+      !dbus_connection_can_send_type(node_connection, DBUS_TYPE_UNIX_FD))
+    {
+      dbus_message_unref(message);
+      message = whiteboard_sib_handler_inline_payloads(packet->message,
+						       node_connection);
+      if (message == NULL)
+	{
+	  whiteboard_log_warning("Could not inline subscription indication (access id %d)\n",
+				 access_id);
+	  whiteboard_log_debug_fe();
+	  return -1;
+	}
+    }
+#endif
+
+  if (!whiteboard_sib_handler_queue_indication((WhiteBoardSIBHandler *) user_data,
+					       node_connection,
+					       message) &&
+      !dbus_connection_send(node_connection, message, NULL))
+    {
+      whiteboard_log_warning("Could not forward subscription indication (access id %d)\n",
+			     access_id);
+      retval = -1;
+    }
+
+  dbus_message_unref(message);
+
+  whiteboard_log_debug_fe();
+  return retval;
+}
+
+/**
+ * Queue a subscription indication for a node that accepts batched
+ * indications. The batch is flushed when it reaches batch_max messages
+ * or batch_window milliseconds after its first message.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param conn Node connection
+ * @param msg Subscription indication, already addressed to the node interface
+ * @return TRUE if the message was queued, FALSE if it should be sent now
+ */
+static gboolean whiteboard_sib_handler_queue_indication(WhiteBoardSIBHandler *self,
+							DBusConnection *conn,
+							DBusMessage *msg)
+{
+  IndicationBatch *batch = NULL;
+
+  if (self->batch_window == 0 ||
+      !(dbushandler_get_node_capabilities(self->dbus_handler, conn) &
+	WHITEBOARD_NODE_CAPABILITY_BATCHED_IND))
+    return FALSE;
+
+#ifdef HAVE_DBUS_UNIX_FD
+  /* File descriptors do not survive dbus_message_marshal, the queued
+     indications go out first so that the node sees them in order */
+  if (dbus_message_contains_unix_fds(msg))
+    {
+      whiteboard_sib_handler_flush_indications(self, conn);
+      return FALSE;
+    }
+#endif
+
+  g_static_rec_mutex_lock(&self->lock);
+  batch = (IndicationBatch *) g_hash_table_lookup(self->batch_map, conn);
+  if (batch == NULL)
+    {
+      batch = g_new0(IndicationBatch, 1);
+      batch->sib_handler = self;
+      batch->connection = dbus_connection_ref(conn);
+      batch->ref_count = 2;
+      batch->timeout_id = g_timeout_add_full(G_PRIORITY_DEFAULT,
+					     self->batch_window,
+					     whiteboard_sib_handler_batch_timeout_cb,
+					     batch,
+					     whiteboard_sib_handler_batch_unref);
+      g_hash_table_insert(self->batch_map, conn, batch);
+    }
+
+  batch->messages = g_slist_prepend(batch->messages, dbus_message_ref(msg));
+  batch->count++;
+
+  if (batch->count >= self->batch_max)
+    whiteboard_sib_handler_flush_indications(self, conn);
+  g_static_rec_mutex_unlock(&self->lock);
+
+  return TRUE;
+}
+
+/**
+ * Send the pending indications of a node connection, a single indication
+ * as is and several as one WHITEBOARD_DBUS_NODE_SIGNAL_SUBSCRIPTION_IND_BATCH
+ * signal.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param conn Node connection
+ */
+static void whiteboard_sib_handler_flush_indications(WhiteBoardSIBHandler *self,
+						     DBusConnection *conn)
+{
+  IndicationBatch *batch = NULL;
+#ifdef HAVE_DBUS_MESSAGE_MARSHAL
+  DBusMessage *signal = NULL;
+  DBusMessageIter iter;
+  DBusMessageIter array;
+  DBusMessageIter bytes;
+  GSList *link = NULL;
+  gchar *buf = NULL;
+  gint len = 0;
+#endif
+
+  g_static_rec_mutex_lock(&self->lock);
+  batch = (IndicationBatch *) g_hash_table_lookup(self->batch_map, conn);
+  if (batch == NULL)
+    {
+      g_static_rec_mutex_unlock(&self->lock);
+      return;
+    }
+
+  batch->messages = g_slist_reverse(batch->messages);
+
+  if (batch->count == 1)
+    {
+      dbus_connection_send(conn, (DBusMessage *) batch->messages->data, NULL);
+    }
+  else
+    {
+#ifdef HAVE_DBUS_MESSAGE_MARSHAL
+      signal = dbus_message_new_signal(WHITEBOARD_DBUS_OBJECT,
+				       WHITEBOARD_DBUS_NODE_INTERFACE,
+				       WHITEBOARD_DBUS_NODE_SIGNAL_SUBSCRIPTION_IND_BATCH);
+      dbus_message_iter_init_append(signal, &iter);
+      dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+				       DBUS_TYPE_ARRAY_AS_STRING
+				       DBUS_TYPE_BYTE_AS_STRING,
+				       &array);
+      for (link = batch->messages; link != NULL; link = link->next)
+	{
+	  if (!dbus_message_marshal((DBusMessage *) link->data, &buf, &len))
+	    {
+	      whiteboard_log_warning("Could not marshal subscription indication\n");
+	      continue;
+	    }
+
+	  dbus_message_iter_open_container(&array, DBUS_TYPE_ARRAY,
+					   DBUS_TYPE_BYTE_AS_STRING, &bytes);
+	  dbus_message_iter_append_fixed_array(&bytes, DBUS_TYPE_BYTE,
+					       &buf, len);
+	  dbus_message_iter_close_container(&array, &bytes);
+	  dbus_free(buf);
+	}
+      dbus_message_iter_close_container(&iter, &array);
+
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+				   "Sending %u batched indications\n",
+				   batch->count);
+
+      dbus_connection_send(conn, signal, NULL);
+      dbus_message_unref(signal);
+#endif
+    }
+
+  /* Frees the batch and cancels its timeout */
+  g_hash_table_remove(self->batch_map, conn);
+  g_static_rec_mutex_unlock(&self->lock);
+}
+
+static gboolean whiteboard_sib_handler_batch_timeout_cb(gpointer user_data)
+{
+  IndicationBatch *batch = (IndicationBatch *) user_data;
+  WhiteBoardSIBHandler *self = batch->sib_handler;
+
+  /* A dispatch thread may flush the batch after this timeout was
+     dispatched, the source is then destroyed under the lock */
+  g_static_rec_mutex_lock(&self->lock);
+  if (!g_source_is_destroyed(g_main_current_source()))
+    {
+      /* The source is destroyed by returning FALSE */
+      batch->timeout_id = 0;
+      whiteboard_sib_handler_flush_indications(self, batch->connection);
+    }
+  g_static_rec_mutex_unlock(&self->lock);
+
+  return FALSE;
+}
+
+static void whiteboard_sib_handler_batch_unref(gpointer data)
+{
+  IndicationBatch *batch = (IndicationBatch *) data;
+
+  if (!g_atomic_int_dec_and_test(&batch->ref_count))
+    return;
+
+  g_slist_foreach(batch->messages, (GFunc) dbus_message_unref, NULL);
+  g_slist_free(batch->messages);
+  dbus_connection_unref(batch->connection);
+  g_free(batch);
+}
+
+static void whiteboard_sib_handler_batch_free(gpointer data)
+{
+  IndicationBatch *batch = (IndicationBatch *) data;
+
+  if (batch->timeout_id != 0)
+    g_source_remove(batch->timeout_id);
+
+  whiteboard_sib_handler_batch_unref(batch);
+}
+
+static gboolean whiteboard_sib_handler_batch_orphaned(gpointer key,
+						      gpointer value,
+						      gpointer user_data)
+{
+  IndicationBatch *batch = (IndicationBatch *) value;
+
+  return !dbus_connection_get_is_connected(batch->connection);
+}
+
+/**
+ * Parse a subscribe or query result from a SIB access process.
+ *
+ * @param message The SIB access reply
+ * @param access_id Pointer where the access id is stored
+ * @param status Pointer where the status is stored
+ * @param subscription_id Pointer where the subscription id is stored, owned
+ *        by the message, or NULL for query results
+ * @param results Payload to fill with the result document
+ * @return TRUE if the result was well formed
+ */
+static gboolean whiteboard_sib_handler_parse_result(DBusMessage *message,
+						    gint *access_id,
+						    gint *status,
+						    gchar **subscription_id,
+						    Payload *results)
+{
+  DBusMessageIter iter;
+
+  if(!dbus_message_iter_init(message, &iter) ||
+     dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_INT32)
+    return FALSE;
+  dbus_message_iter_get_basic(&iter, access_id);
+
+  if(!dbus_message_iter_next(&iter) ||
+     dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_INT32)
+    return FALSE;
+  dbus_message_iter_get_basic(&iter, status);
+
+  if(NULL != subscription_id)
+    {
+      if(!dbus_message_iter_next(&iter) ||
+	 dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+	return FALSE;
+      dbus_message_iter_get_basic(&iter, subscription_id);
+    }
+
+  if(!dbus_message_iter_next(&iter))
+    return FALSE;
 
-  whiteboard_util_parse_message(packet->message,
-				DBUS_TYPE_INT32, &access_id,
-				WHITEBOARD_UTIL_LIST_END);
-  
-  whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
-			"Got signal (unsubscribe complete) with access_id:%d. \n", access_id);
-  
-  /* Find the connection associated to this access id */
-  node_connection = dbushandler_get_node_connection_by_access_id(context, 
-								access_id);
-  
-  whiteboard_util_forward_packet(node_connection, packet->message,
-				 NULL,
-				 NULL,
-				 WHITEBOARD_DBUS_NODE_INTERFACE,
-				 NULL);
-  
-  dbushandler_invalidate_access_id(context, access_id);
-  
-  whiteboard_log_debug_fe();
-  return 0;
+  return whiteboard_sib_handler_get_payload(&iter, results);
 }
 
-static gint whiteboard_sib_handler_handle_signal_subscription_ind(DBusHandler *context,
-								  WhiteBoardPacket *packet,
-								  gpointer user_data)
+/**
+ * Send a subscribe or query result to the requesting node.
+ *
+ * @param node_connection Connection of the requesting node
+ * @param member WHITEBOARD_DBUS_NODE_METHOD_SUBSCRIBE or _QUERY
+ * @param access_id Access id of the request
+ * @param status Status reported by the SIB
+ * @param subscription_id Subscription id or NULL for query results
+ * @param results Result document
+ * @return TRUE if the result was sent
+ */
+static gboolean whiteboard_sib_handler_send_result(DBusConnection *node_connection,
+						   const gchar *member,
+						   gint access_id,
+						   gint status,
+						   gchar *subscription_id,
+						   Payload *results)
 {
-  gint access_id;
-  DBusConnection *node_connection;
-	
-  whiteboard_log_debug_fb();
-	
-  g_return_val_if_fail( NULL != context, -1 );
-  g_return_val_if_fail( NULL != packet, -1 );
+  DBusMessage *signal = NULL;
+  DBusMessageIter iter;
+  gboolean retval = FALSE;
 
-  whiteboard_util_parse_message(packet->message,
-				DBUS_TYPE_INT32, &access_id,
-				WHITEBOARD_UTIL_LIST_END);
+  signal = dbus_message_new_signal(WHITEBOARD_DBUS_OBJECT,
+				   WHITEBOARD_DBUS_NODE_INTERFACE,
+				   member);
+  if(NULL == signal)
+    return FALSE;
 
-  whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
-			"Got signal (subscription_ind) with access_id: %d\n", 
-			access_id);
+  dbus_message_iter_init_append(signal, &iter);
+  retval = (dbus_message_iter_append_basic(&iter, DBUS_TYPE_INT32, &access_id) &&
+	    dbus_message_iter_append_basic(&iter, DBUS_TYPE_INT32, &status) &&
+	    (NULL == subscription_id ||
+	     dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &subscription_id)) &&
+	    whiteboard_sib_handler_append_payload(&iter, node_connection, results) &&
+	    dbus_connection_send(node_connection, signal, NULL));
 
-  /* Find the connection associated to this access id */
-  node_connection = dbushandler_get_node_connection_by_access_id(context, access_id);
+  dbus_message_unref(signal);
 
-  whiteboard_util_forward_packet(node_connection, packet->message,
-				 NULL,
-				 NULL,
-				 WHITEBOARD_DBUS_NODE_INTERFACE,
-				 NULL);
-  whiteboard_log_debug_fe();
-  return 0;
+  return retval;
 }
 
 static gint whiteboard_sib_handler_handle_subscribe_return(DBusHandler *context,
@@ -1644,7 +3358,7 @@ static gint whiteboard_sib_handler_handle_subscribe_return(DBusHandler *context,
 							   gpointer user_data)
 {
   gchar *subscription_id=NULL;;
-  gchar *results = NULL;
+  Payload results = PAYLOAD_INIT;
   gint access_id = -1;
   gint status = -1;
   DBusConnection *node_connection;
@@ -1654,33 +3368,35 @@ static gint whiteboard_sib_handler_handle_subscribe_return(DBusHandler *context,
   g_return_val_if_fail( NULL != context, -1 );
   g_return_val_if_fail( NULL != packet, -1 );
 
-  if(whiteboard_util_parse_message(packet->message,
-				   DBUS_TYPE_INT32, &access_id,
-				   DBUS_TYPE_INT32, &status,
-				   DBUS_TYPE_STRING, &subscription_id,
-				   DBUS_TYPE_STRING, &results,
-				   WHITEBOARD_UTIL_LIST_END))
+  if(whiteboard_sib_handler_parse_result(packet->message,
+					 &access_id, &status,
+					 &subscription_id, &results))
     {
 
-      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
-			    "Got subscribe return with access_id: %d, status:%d, subscription_id: %s, results: %s\n",
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
+			    "Got subscribe return with access_id: %d, status:%d, subscription_id: %s\n",
 			    access_id,
 			    status,
-			    subscription_id,
-			    results);
+			    subscription_id);
       
       /* Find the connection associated to this access id */
       node_connection = dbushandler_get_node_connection_by_access_id(context, access_id);
-      whiteboard_util_send_signal(WHITEBOARD_DBUS_OBJECT,
-				  WHITEBOARD_DBUS_NODE_INTERFACE,
-				  WHITEBOARD_DBUS_NODE_METHOD_SUBSCRIBE,
-				  node_connection,
-				  DBUS_TYPE_INT32, &access_id,
-				  DBUS_TYPE_INT32, &status,
-				  DBUS_TYPE_STRING, &subscription_id,
-				  DBUS_TYPE_STRING, &results,
-				  WHITEBOARD_UTIL_LIST_END);
+      if (node_connection == NULL ||
+	  !whiteboard_sib_handler_send_result(node_connection,
+					      WHITEBOARD_DBUS_NODE_METHOD_SUBSCRIBE,
+					      access_id, status,
+					      subscription_id, &results))
+	whiteboard_log_warning("Could not forward subscribe result (access id %d)\n",
+			       access_id);
+
+      /* An established subscription routes indications until
+	 unsubscribe completes, a failed one is done */
+      if (status == 0)
+	dbushandler_keep_access_id(context, access_id);
+      else
+	dbushandler_invalidate_access_id(context, access_id);
     }
+  whiteboard_sib_handler_payload_clear(&results);
   whiteboard_log_debug_fe();
   return 0;
 }
@@ -1689,7 +3405,7 @@ static gint whiteboard_sib_handler_handle_query_return(DBusHandler *context,
 							   WhiteBoardPacket *packet,
 							   gpointer user_data)
 {
-  gchar *results = NULL;
+  Payload results = PAYLOAD_INIT;
   gint access_id = -1;
   gint status = -1;
   DBusConnection *node_connection;
@@ -1699,33 +3415,31 @@ static gint whiteboard_sib_handler_handle_query_return(DBusHandler *context,
   g_return_val_if_fail( NULL != context, -1 );
   g_return_val_if_fail( NULL != packet, -1 );
 
-  if( whiteboard_util_parse_message(packet->message,
-				DBUS_TYPE_INT32, &access_id,
-				DBUS_TYPE_INT32, &status,
-				DBUS_TYPE_STRING, &results,
-				    WHITEBOARD_UTIL_LIST_END))
+  if( whiteboard_sib_handler_parse_result(packet->message,
+					  &access_id, &status,
+					  NULL, &results))
     {
 
-      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
-			    "Got query return with access_id: %d, status:%d, results: %s\n",
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER, 
+			    "Got query return with access_id: %d, status:%d\n",
 			    access_id,
-			    status,
-			    results);
+			    status);
       
       /* Find the connection associated to this access id */
       node_connection = dbushandler_get_node_connection_by_access_id(context, access_id);
-      
-      whiteboard_util_send_signal(WHITEBOARD_DBUS_OBJECT,
-				  WHITEBOARD_DBUS_NODE_INTERFACE,
-				  WHITEBOARD_DBUS_NODE_METHOD_QUERY,
-				  node_connection,
-				  DBUS_TYPE_INT32, &access_id,
-				  DBUS_TYPE_INT32, &status,
-				  DBUS_TYPE_STRING, &results,
-				  WHITEBOARD_UTIL_LIST_END);
-
+      if (node_connection == NULL ||
+	  !whiteboard_sib_handler_send_result(node_connection,
+					      WHITEBOARD_DBUS_NODE_METHOD_QUERY,
+					      access_id, status,
+					      NULL, &results))
+	whiteboard_log_warning("Could not forward query result (access id %d)\n",
+			       access_id);
+
+      whiteboard_sib_handler_cache_store((WhiteBoardSIBHandler *) user_data,
+					 access_id, status, &results);
       dbushandler_invalidate_access_id(context, access_id);
     }
+  whiteboard_sib_handler_payload_clear(&results);
   whiteboard_log_debug_fe();
   
   return 0;
@@ -1762,188 +3476,293 @@ static gint whiteboard_sib_handler_handle_insert_response(DBusHandler *context,
   return 0;
 }
 #endif
+/**
+ * Take a token from the node connection and the SIB of a request. The
+ * node's token is given back if the SIB has none left. Buckets are only
+ * made for registered SIBs, so made up uuids cannot grow the table.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param conn Connection the request came from
+ * @param msg Request whose arguments start with the node id and SIB uuid
+ * @return 0 if admitted, WHITEBOARD_STATUS_RATE_LIMITED otherwise
+ */
+static gint whiteboard_sib_handler_admit(WhiteBoardSIBHandler *self,
+					 DBusConnection *conn,
+					 DBusMessage *msg)
+{
+  DBusMessageIter iter;
+  const gchar *sibid = NULL;
+  AccessSIB *source = NULL;
+  RateBucket *node_bucket = NULL;
+  RateBucket *sib_bucket = NULL;
+  GTimeVal tv;
+  gint64 now = 0;
+  gint retval = 0;
+  guint node_rate = 0;
+  guint sib_rate = 0;
+
+  g_static_mutex_lock(&self->rate_lock);
+  node_rate = self->node_rate;
+  sib_rate = self->sib_rate;
+  g_static_mutex_unlock(&self->rate_lock);
+
+  if (node_rate == 0 && sib_rate == 0)
+    return 0;
+
+  if (sib_rate > 0 &&
+      dbus_message_iter_init(msg, &iter) &&
+      dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_STRING &&
+      dbus_message_iter_next(&iter) &&
+      dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_STRING)
+    {
+      dbus_message_iter_get_basic(&iter, &sibid);
+      source = whiteboard_sib_handler_lookup_sib(self, sibid);
+      if (source == NULL)
+	sibid = NULL;
+      else
+	access_sib_unref(source);
+    }
+
+  g_get_current_time(&tv);
+  now = (gint64) tv.tv_sec * G_GINT64_CONSTANT(1000000) + tv.tv_usec;
+
+  g_static_mutex_lock(&self->rate_lock);
+  whiteboard_sib_handler_sweep_buckets(self, now);
+
+  if (self->node_rate > 0)
+    {
+      node_bucket = (RateBucket *) g_hash_table_lookup(self->node_buckets,
+						       conn);
+      if (node_bucket == NULL)
+	{
+	  node_bucket = whiteboard_sib_handler_bucket_new(self->node_burst, now);
+	  node_bucket->connection = dbus_connection_ref(conn);
+	  g_hash_table_insert(self->node_buckets, conn, node_bucket);
+	}
+    }
+
+  if (sibid != NULL && self->sib_rate > 0)
+    {
+      sib_bucket = (RateBucket *) g_hash_table_lookup(self->sib_buckets,
+						      sibid);
+      if (sib_bucket == NULL)
+	{
+	  sib_bucket = whiteboard_sib_handler_bucket_new(self->sib_burst, now);
+	  g_hash_table_insert(self->sib_buckets, g_strdup(sibid), sib_bucket);
+	}
+    }
+
+  if (node_bucket != NULL &&
+      !whiteboard_sib_handler_take_token(node_bucket, self->node_rate,
+					 self->node_burst, now))
+    {
+      self->node_rate_limited++;
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+				   "Node connection %p over its rate\n", conn);
+      retval = WHITEBOARD_STATUS_RATE_LIMITED;
+    }
+  else if (sib_bucket != NULL &&
+	   !whiteboard_sib_handler_take_token(sib_bucket, self->sib_rate,
+					      self->sib_burst, now))
+    {
+      if (node_bucket != NULL)
+	node_bucket->tokens += 1.0;
+      self->sib_rate_limited++;
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_SIB_HANDLER,
+				   "SIB %s over its rate\n", sibid);
+      retval = WHITEBOARD_STATUS_RATE_LIMITED;
+    }
+  g_static_mutex_unlock(&self->rate_lock);
+
+  return retval;
+}
+
+static RateBucket *whiteboard_sib_handler_bucket_new(guint burst, gint64 now)
+{
+  RateBucket *bucket = NULL;
+
+  bucket = g_new0(RateBucket, 1);
+  bucket->tokens = burst;
+  bucket->updated = now;
+
+  return bucket;
+}
+
+static void whiteboard_sib_handler_bucket_free(gpointer data)
+{
+  RateBucket *bucket = (RateBucket *) data;
+
+  if (bucket->connection != NULL)
+    dbus_connection_unref(bucket->connection);
+  g_free(bucket);
+}
+
+static gboolean whiteboard_sib_handler_take_token(RateBucket *bucket,
+						  guint rate,
+						  guint burst,
+						  gint64 now)
+{
+  if (now > bucket->updated)
+    {
+      bucket->tokens = MIN((gdouble) burst,
+			   bucket->tokens +
+			   (now - bucket->updated) * rate / 1000000.0);
+      bucket->updated = now;
+    }
+
+  if (bucket->tokens < 1.0)
+    return FALSE;
+
+  bucket->tokens -= 1.0;
+  return TRUE;
+}
+
+static gboolean whiteboard_sib_handler_bucket_full(gpointer key,
+						   gpointer value,
+						   gpointer user_data)
+{
+  RateBucket *bucket = (RateBucket *) value;
+  BucketSweep *sweep = (BucketSweep *) user_data;
+
+  return (bucket->tokens +
+	  (sweep->now - bucket->updated) * sweep->rate / 1000000.0 >=
+	  sweep->burst);
+}
+
+/**
+ * Drop the buckets that refilled, every RATE_BUCKET_SWEEP_INTERVAL. A
+ * new bucket starts full, so nothing is lost, and buckets of gone
+ * connections and idle SIBs do not pile up. Call with rate_lock held.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param now Current time in microseconds since the epoch
+ */
+static void whiteboard_sib_handler_sweep_buckets(WhiteBoardSIBHandler *self,
+						 gint64 now)
+{
+  BucketSweep sweep;
+
+  if (now - self->buckets_swept < RATE_BUCKET_SWEEP_INTERVAL)
+    return;
+  self->buckets_swept = now;
+
+  sweep.now = now;
+  sweep.rate = self->node_rate;
+  sweep.burst = self->node_burst;
+  g_hash_table_foreach_remove(self->node_buckets,
+			      whiteboard_sib_handler_bucket_full, &sweep);
+
+  sweep.rate = self->sib_rate;
+  sweep.burst = self->sib_burst;
+  g_hash_table_foreach_remove(self->sib_buckets,
+			      whiteboard_sib_handler_bucket_full, &sweep);
+}
+
+static void whiteboard_sib_handler_statistics_cb(DBusHandler *context,
+						 DBusMessageIter *dict,
+						 gpointer user_data)
+{
+  WhiteBoardSIBHandler *self = (WhiteBoardSIBHandler *) user_data;
+  guint node_limited = 0;
+  guint sib_limited = 0;
+  guint cache_hits = 0;
+  guint cache_misses = 0;
+  guint cache_evictions = 0;
+  guint cache_entries = 0;
+
+  g_static_mutex_lock(&self->rate_lock);
+  node_limited = self->node_rate_limited;
+  sib_limited = self->sib_rate_limited;
+  g_static_mutex_unlock(&self->rate_lock);
+
+  dbushandler_append_statistic(dict, "node_rate_limited", node_limited);
+  dbushandler_append_statistic(dict, "sib_rate_limited", sib_limited);
+
+  g_static_mutex_lock(&self->cache_lock);
+  cache_hits = self->query_cache_hits;
+  cache_misses = self->query_cache_misses;
+  cache_evictions = self->query_cache_evictions;
+  cache_entries = g_hash_table_size(self->query_cache);
+  g_static_mutex_unlock(&self->cache_lock);
+
+  dbushandler_append_statistic(dict, "query_cache_hits", cache_hits);
+  dbushandler_append_statistic(dict, "query_cache_misses", cache_misses);
+  dbushandler_append_statistic(dict, "query_cache_evictions", cache_evictions);
+  dbushandler_append_statistic(dict, "query_cache_entries", cache_entries);
+}
+
+static void whiteboard_sib_handler_direct_channel_cb(DBusHandler *context,
+						     const gchar *sibid,
+						     gpointer user_data)
+{
+  /* Queries bypass the cache while the channel is open, writes over it
+     go unnoticed, so neither older nor newer results may be served */
+  whiteboard_sib_handler_cache_invalidate((WhiteBoardSIBHandler *) user_data,
+					  sibid);
+}
+
 static void whiteboard_sib_handler_dbus_cb(DBusHandler *context, WhiteBoardPacket *packet,
 					   gpointer user_data)
 {
+  WhiteBoardSIBHandler* sib_handler = NULL;
+  const MessageHandlerEntry* entry = NULL;
   const gchar* interface = NULL;
   const gchar* member = NULL;
+  const gchar* response = "Rate limited";
   gint type = 0;
+  gint status = 0;
   
   whiteboard_log_debug_fb();
   
   g_return_if_fail( NULL != context );
   g_return_if_fail( NULL != packet );
+  g_return_if_fail( NULL != user_data );
+
+  sib_handler = (WhiteBoardSIBHandler*) user_data;
   
   interface = dbus_message_get_interface(packet->message);
   member = dbus_message_get_member(packet->message);
   type = dbus_message_get_type(packet->message);
-  
-  switch (type)
-    {
-    case DBUS_MESSAGE_TYPE_SIGNAL:
-      
-      if (!strcmp(member, WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_SIB_REMOVED))
-	{
-	  whiteboard_log_debug("Got node removed\n");
-	  
-	  whiteboard_sib_handler_handle_signal_sib_removed(context, 
-							    packet,
-							    user_data);
-	}
-      else if(!strcmp(member, WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_JOIN_COMPLETE))
-	{
-	  whiteboard_log_debug("Got join complete\n");
-	  
-	  whiteboard_sib_handler_handle_signal_join_complete(context, 
-							     packet,
-							     user_data);
-	}
-      else if(!strcmp(member, WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_SUBSCRIPTION_IND))
-	{
-	  whiteboard_log_debug("Got subscription ind\n");
-	  
-	  whiteboard_sib_handler_handle_signal_subscription_ind(context, 
-								packet,
-								user_data);
-	}
-      else if(!strcmp(member, WHITEBOARD_DBUS_NODE_SIGNAL_UNSUBSCRIBE))
-	{
-	  whiteboard_log_debug("Got unsubscribe req\n");
-	   
-	  whiteboard_sib_handler_handle_unsubscribe(context, 
-						    packet,
-						    user_data);
-	}
-      else if(!strcmp(member, WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_UNSUBSCRIBE_COMPLETE))
-	{
-	  whiteboard_log_debug("Got unsubscribe complete\n");
-	   
-	  whiteboard_sib_handler_handle_unsubscribe_complete(context, 
-							     packet,
-							     user_data);
-	}
-      else
-	{
-	  whiteboard_log_warning("Unknown sib_handler signal: %s %s\n",
-				 interface, member);
-	}
-      
-      break;
-      
-    case DBUS_MESSAGE_TYPE_METHOD_CALL:
 
-      if(!strcmp(member, WHITEBOARD_DBUS_NODE_METHOD_REFRESH_NODE))
-	{
-	  whiteboard_log_debug("Got refresh node call\n");
-		    
-	  whiteboard_sib_handler_handle_method_refresh_node(context,
-							    packet,
-							    user_data);
-	}
-      else if (!strcmp(member, WHITEBOARD_DBUS_NODE_METHOD_JOIN))
-	{
-	  whiteboard_log_debug("Got join method\n");
-	  
-	  whiteboard_sib_handler_handle_join(context, 
-					     packet,
-					     user_data);
-	}
-      else if (!strcmp(member, WHITEBOARD_DBUS_NODE_METHOD_LEAVE))
-	{
-	  whiteboard_log_debug("Got leave method\n");
-	  
-	  whiteboard_sib_handler_handle_leave(context, 
-					      packet,
-					      user_data);
-	}
-      else if (!strcmp(member, WHITEBOARD_DBUS_DISCOVERY_METHOD_GET_SIBS))
-	{
-	  whiteboard_log_debug("Got get sibs call\n");
-		    
-	  whiteboard_sib_handler_handle_method_get_sibs(context,
-							packet,
-							user_data);
-	}
-      else if (!strcmp(member, WHITEBOARD_DBUS_NODE_METHOD_GET_DESCRIPTION))
-	{	
-	  whiteboard_log_debug("Got get description call\n");
-		    
-	  whiteboard_sib_handler_handle_method_get_description(context,
-							       packet,
-							       user_data);
-	}
-      else if( !strcmp(member, WHITEBOARD_DBUS_NODE_METHOD_INSERT))
-	{	
-	  whiteboard_log_debug("Got INSERT method call\n");
-	  whiteboard_sib_handler_handle_insert(context,
-						packet,
-						user_data);
-	}
-      else if( !strcmp(member, WHITEBOARD_DBUS_NODE_METHOD_UPDATE))
-	{	
-	  whiteboard_log_debug("Got UPDATE method call\n");
-	  whiteboard_sib_handler_handle_update(context,
-						packet,
-						user_data);
-	}
-      else if( !strcmp(member, WHITEBOARD_DBUS_NODE_METHOD_SUBSCRIBE) ||
-	       !strcmp(member, WHITEBOARD_DBUS_NODE_METHOD_QUERY) )
-	
-	{	
-	  whiteboard_log_debug("Got subscribe/query method call\n");
-	  whiteboard_sib_handler_handle_subscribe_query(context,
-						  packet,
-						  user_data);
-	}
-      else if(!strcmp(member, WHITEBOARD_DBUS_NODE_METHOD_REMOVE))
-	{	
-	  whiteboard_log_debug("Got remove method call\n");
-	  whiteboard_sib_handler_handle_remove(context,
-					       packet,
-					       user_data);
-	}
-      else
-	{
-	  whiteboard_log_warning("Unknown method call: %s %s\n",
-				 interface, member);
-	}
-		
-      break;
-		
-    case DBUS_MESSAGE_TYPE_METHOD_RETURN:
-      if(!strcmp(member, WHITEBOARD_DBUS_SIB_ACCESS_METHOD_SUBSCRIBE))
-	{	
-	  whiteboard_log_debug("Got subscribe method return\n");
-	  whiteboard_sib_handler_handle_subscribe_return(context,
-							 packet,
-							 user_data);
-	}
-      else if(!strcmp(member, WHITEBOARD_DBUS_SIB_ACCESS_METHOD_QUERY))
-	{	
-	  whiteboard_log_debug("Got query method return\n");
-	  whiteboard_sib_handler_handle_query_return(context,
-							 packet,
-							 user_data);
-	}
-      else
-	{
-	  whiteboard_log_warning("Unknown method return: %s %s\n",
-				 interface, member);
-	}
-      
-      break;
-      
-    default:
+  if (type <= DBUS_MESSAGE_TYPE_INVALID || type >= DBUS_NUM_MESSAGE_TYPES ||
+      sib_handler->handler_map[type] == NULL)
+    {
       whiteboard_log_warning("Unknown message type: %d for %s %s\n",
 			     type, interface, member);
-      break;
-      
+    }
+  else if (member == NULL ||
+	   (entry = (const MessageHandlerEntry *)
+	    g_hash_table_lookup(sib_handler->handler_map[type], member)) == NULL)
+    {
+      whiteboard_log_warning("Unknown sib_handler message (type %d): %s %s\n",
+			     type, interface, member);
+    }
+  else if (entry->limit != MESSAGE_LIMIT_NONE &&
+	   (status = whiteboard_sib_handler_admit(sib_handler,
+						  packet->connection,
+						  packet->message)) != 0)
+    {
+      if (entry->limit == MESSAGE_LIMIT_ACCESS_ID)
+	whiteboard_util_send_method_return(packet->connection, packet->message,
+					   DBUS_TYPE_INT32, &status,
+					   WHITEBOARD_UTIL_LIST_END);
+      else
+	whiteboard_util_send_method_return(packet->connection, packet->message,
+					   DBUS_TYPE_INT32, &status,
+					   DBUS_TYPE_STRING, &response,
+					   WHITEBOARD_UTIL_LIST_END);
+    }
+  else
+    {
+      whiteboard_log_debug("Got %s (type %d)\n", member, type);
+      entry->handler(context, packet, user_data);
     }
   
   whiteboard_log_debug_fe();
 }
 
 void whiteboard_sib_handler_sib_registered_cb(DBusHandler* context,
+					      DBusConnection* conn,
 					      gchar* uuid,
 					      gchar* name,
 					      gpointer user_data)
@@ -1958,7 +3777,7 @@ void whiteboard_sib_handler_sib_registered_cb(DBusHandler* context,
   g_return_if_fail(NULL != uuid);
   g_return_if_fail(NULL != name);
 
-  whiteboard_sib_handler_add_sib(sib_handler, uuid, name);
+  whiteboard_sib_handler_add_sib(sib_handler, conn, uuid, name);
 
   whiteboard_log_debug_fe();
 }
@@ -1968,8 +3787,7 @@ static void whiteboard_sib_handler_node_disconnected_cb(DBusHandler* context,
 							gpointer user_data)
 {
   WhiteBoardSIBHandler* sib_handler = NULL;
-  GList *link = NULL;
-  const gchar *sib = NULL;
+  gchar *sib = NULL;
   AccessSIB *sibdata;
   whiteboard_log_debug_fb();
   
@@ -1978,19 +3796,26 @@ static void whiteboard_sib_handler_node_disconnected_cb(DBusHandler* context,
   
   g_return_if_fail(NULL != uuid);
 
+  /* A SIB access process went away, stop routing to its connection */
+  sibdata = whiteboard_sib_handler_lookup_sib(sib_handler, uuid);
+  if(sibdata)
+    {
+      whiteboard_log_debug("SIB access for %s disconnected\n", uuid);
+      access_sib_set_connection(sibdata, NULL);
+      access_sib_unref(sibdata);
+    }
+
   sib = whiteboard_sib_handler_get_sib_by_joined_nodeid( sib_handler, uuid);
   if(sib)
     {
       
-      link = g_list_find_custom(sib_handler->sib_list, sib, 
-				access_sib_compare_id);
-      if(link)
+      sibdata = whiteboard_sib_handler_lookup_sib(sib_handler, sib);
+      if(sibdata)
 	{
-	  sibdata = (AccessSIB*) link->data;
-	  access_sib_ref(sibdata);
 	  access_sib_remove_from_joined_nodes(sibdata, uuid);
 	  access_sib_unref(sibdata);
 	}
+      g_free(sib);
     }
   
   if( whiteboard_sib_handler_remove_sib_by_joined_nodeid(sib_handler,
@@ -1998,6 +3823,94 @@ static void whiteboard_sib_handler_node_disconnected_cb(DBusHandler* context,
     {
       whiteboard_log_debug("Removed %s from joined nodes\n", uuid);
     }
+
+  /* Nobody to deliver to if the node's connection went away, drop its
+     pending indications and cancel their timeout */
+  g_static_rec_mutex_lock(&sib_handler->lock);
+  g_hash_table_foreach_remove(sib_handler->batch_map,
+			      whiteboard_sib_handler_batch_orphaned, NULL);
+  g_static_rec_mutex_unlock(&sib_handler->lock);
+  whiteboard_log_debug_fe();
+}
+
+static void whiteboard_sib_handler_access_expired_cb(DBusHandler *context,
+						     gint access_id,
+						     AccessRoute *route,
+						     gpointer user_data)
+{
+  WhiteBoardSIBHandler *self = (WhiteBoardSIBHandler *) user_data;
+  AccessSIB *source = NULL;
+  JoinData *jd = NULL;
+  gint status = -1;
+  const gchar *empty = "";
+
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail(NULL != self);
+
+  switch (route->op)
+    {
+    case ACCESS_ROUTE_OP_JOIN:
+      /* Undo the registration made when the join was forwarded */
+      jd = whiteboard_sib_handler_steal_joindata_by_accessid(self, access_id);
+
+      if (jd != NULL)
+	{
+	  whiteboard_sib_handler_remove_sib_by_joined_nodeid(self, jd->node);
+	  source = whiteboard_sib_handler_lookup_sib(self, jd->sib);
+	  if (source != NULL)
+	    {
+	      access_sib_remove_from_joined_nodes(source, jd->node);
+	      access_sib_unref(source);
+	    }
+	  g_free(jd->node);
+	  g_free(jd->sib);
+	  g_free(jd);
+	}
+
+      if (route->node_connection != NULL)
+	whiteboard_util_send_signal(WHITEBOARD_DBUS_OBJECT,
+				    WHITEBOARD_DBUS_NODE_INTERFACE,
+				    WHITEBOARD_DBUS_SIB_ACCESS_SIGNAL_JOIN_COMPLETE,
+				    route->node_connection,
+				    DBUS_TYPE_INT32, &access_id,
+				    DBUS_TYPE_INT32, &status,
+				    WHITEBOARD_UTIL_LIST_END);
+      break;
+
+    case ACCESS_ROUTE_OP_QUERY:
+      whiteboard_sib_handler_cache_forget(self, access_id);
+      if (route->node_connection != NULL)
+	whiteboard_util_send_signal(WHITEBOARD_DBUS_OBJECT,
+				    WHITEBOARD_DBUS_NODE_INTERFACE,
+				    WHITEBOARD_DBUS_NODE_METHOD_QUERY,
+				    route->node_connection,
+				    DBUS_TYPE_INT32, &access_id,
+				    DBUS_TYPE_INT32, &status,
+				    DBUS_TYPE_STRING, &empty,
+				    WHITEBOARD_UTIL_LIST_END);
+      break;
+
+    case ACCESS_ROUTE_OP_SUBSCRIBE:
+      /* Only a subscribe still waiting for its return has a deadline,
+	 established subscriptions end with the SIB */
+      if (route->node_connection != NULL && route->deadline != 0)
+	whiteboard_util_send_signal(WHITEBOARD_DBUS_OBJECT,
+				    WHITEBOARD_DBUS_NODE_INTERFACE,
+				    WHITEBOARD_DBUS_NODE_METHOD_SUBSCRIBE,
+				    route->node_connection,
+				    DBUS_TYPE_INT32, &access_id,
+				    DBUS_TYPE_INT32, &status,
+				    DBUS_TYPE_STRING, &empty,
+				    DBUS_TYPE_STRING, &empty,
+				    WHITEBOARD_UTIL_LIST_END);
+      break;
+
+    default:
+      /* Writes are failed by their pending call */
+      break;
+    }
+
   whiteboard_log_debug_fe();
 }
 
@@ -2005,15 +3918,25 @@ static void whiteboard_sib_handler_node_disconnected_cb(DBusHandler* context,
  * Connection lists by access ID
  *****************************************************************************/
 
-static const gchar *whiteboard_sib_handler_get_sib_by_joined_nodeid(WhiteBoardSIBHandler *self,
-								    const gchar *nodeid)
+/**
+ * Get the SIB a node is joined to. Note, this takes a copy. Remember to
+ * free it.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param nodeid Node id
+ * @return SIB UUID or NULL if the node is not joined
+ */
+static gchar *whiteboard_sib_handler_get_sib_by_joined_nodeid(WhiteBoardSIBHandler *self,
+							      const gchar *nodeid)
 {
-  const gchar *sib_uri = NULL;
+  gchar *sib_uri = NULL;
   
   whiteboard_log_debug_fb();
   
-  sib_uri = ( const gchar *) g_hash_table_lookup(self->joined_nodes_map,
-						 nodeid);
+  g_static_rec_mutex_lock(&self->lock);
+  sib_uri = g_strdup((const gchar *) g_hash_table_lookup(self->joined_nodes_map,
+							  nodeid));
+  g_static_rec_mutex_unlock(&self->lock);
   
   whiteboard_log_debug_fe();
   
@@ -2026,8 +3949,10 @@ static void whiteboard_sib_handler_add_sib_by_joined_nodeid(WhiteBoardSIBHandler
 {
   whiteboard_log_debug_fb();
   whiteboard_log_debug("Adding node (%s) as joined for SIB (%s)%d\n", node, sib);
+  g_static_rec_mutex_lock(&self->lock);
   g_hash_table_insert(self->joined_nodes_map,
 		      g_strdup(node), g_strdup(sib));
+  g_static_rec_mutex_unlock(&self->lock);
   whiteboard_log_debug_fe();
 }
 
@@ -2043,7 +3968,8 @@ static gboolean whiteboard_sib_handler_remove_sib_by_joined_nodeid(WhiteBoardSIB
   g_return_val_if_fail(NULL != self, FALSE);
   g_return_val_if_fail(NULL != nodeid, FALSE);
 
-  sib_uri = whiteboard_sib_handler_get_sib_by_joined_nodeid(self, nodeid);
+  g_static_rec_mutex_lock(&self->lock);
+  sib_uri = (const gchar *) g_hash_table_lookup(self->joined_nodes_map, nodeid);
   if (sib_uri != NULL)
     {
       /* Remove the sib from the hash map */
@@ -2057,6 +3983,7 @@ static gboolean whiteboard_sib_handler_remove_sib_by_joined_nodeid(WhiteBoardSIB
       
       // dbus_connection_unref(conn);
     }
+  g_static_rec_mutex_unlock(&self->lock);
 
   whiteboard_log_debug_fe();
   return retval;
@@ -2073,58 +4000,49 @@ static void whiteboard_sib_handler_add_joindata_by_accessid(WhiteBoardSIBHandler
   g_return_if_fail(NULL != self);
   g_return_if_fail(NULL != jd);
 
+  g_static_rec_mutex_lock(&self->lock);
   g_hash_table_insert(self->joindata_map, GINT_TO_POINTER(accessid), (gpointer)jd);
+  g_static_rec_mutex_unlock(&self->lock);
 
-  whiteboard_log_debugc(WHITEBOARD_DEBUG_DBUS,
+  whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
 			"Insert joindata: %d, data %p. Map size: %d\n",
 			accessid, jd, g_hash_table_size(self->joindata_map));
 
   whiteboard_log_debug_fe();
 }
 
-static JoinData *whiteboard_sib_handler_get_joindata_by_accessid(WhiteBoardSIBHandler *self,
-								 gint accessid)
-
-{
-  JoinData *jd=NULL;
-  whiteboard_log_debug_fb();
-
-  g_return_val_if_fail(NULL != self, NULL);
-  whiteboard_log_debugc(WHITEBOARD_DEBUG_DBUS,
-			"Trying to get joindata w/ accessid: %d, Map size: %d\n", 
-			accessid, g_hash_table_size(self->joindata_map));
-	
-  jd= (JoinData*) g_hash_table_lookup(self->joindata_map, GINT_TO_POINTER(accessid));
-  whiteboard_log_debug_fe();
-  return jd;
-}
-
-static gboolean whiteboard_sib_handler_remove_joindata_by_accessid(WhiteBoardSIBHandler* self, gint accessid)
+/**
+ * Take the JoinData of a join access id out of joindata_map. Only the
+ * caller that gets it back may free it.
+ *
+ * @param self WhiteBoardSIBHandler instance
+ * @param accessid Access id of the join
+ * @return JoinData or NULL if already taken
+ */
+static JoinData *whiteboard_sib_handler_steal_joindata_by_accessid(WhiteBoardSIBHandler *self,
+								   gint accessid)
 {
-  JoinData * jd = NULL;
-  gboolean retval = FALSE;
+  JoinData *jd = NULL;
 
   whiteboard_log_debug_fb();
 
-  g_return_val_if_fail(NULL != self, FALSE);
+  g_return_val_if_fail(NULL != self, NULL);
 
-  jd = whiteboard_sib_handler_get_joindata_by_accessid(self, accessid);
+  g_static_rec_mutex_lock(&self->lock);
+  jd = (JoinData*) g_hash_table_lookup(self->joindata_map, GINT_TO_POINTER(accessid));
   if (jd != NULL)
     {
-      /* Remove the connection from the hash map */
-      retval = g_hash_table_remove(self->joindata_map, GINT_TO_POINTER(accessid));
+      g_hash_table_steal(self->joindata_map, GINT_TO_POINTER(accessid));
 
-      whiteboard_log_debugc(WHITEBOARD_DEBUG_DBUS,
-			    "Removed:%d, conn:%p, ok:%s. Map size:%d\n",
-			    accessid, jd, (retval) ? "TRUE" : "FALSE",
-			    g_hash_table_size(self->joindata_map));
-		
-      // dbus_connection_unref(conn);
+      whiteboard_daemon_log_debugc(WHITEBOARD_DEBUG_DBUS,
+			    "Removed:%d, data:%p. Map size:%d\n",
+			    accessid, jd, g_hash_table_size(self->joindata_map));
     }
+  g_static_rec_mutex_unlock(&self->lock);
 
   whiteboard_log_debug_fe();
 
-  return retval;
+  return jd;
 }
 
 